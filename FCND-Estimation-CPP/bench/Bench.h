@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Common.h"
+#include "Utility/Timer.h"
+
+// Benchmarks of the simulator's hot paths (see BenchMain.cpp). Each one prints its
+// table and returns 0, or 1 if a check it makes against a reference failed
+
+// heap allocations (malloc, calloc and realloc, which operator new and Eigen go through)
+// made by the process so far, -1 where they can't be counted
+int64_t NumAllocs();
+
+// best time per call of f(i), i = 0..n-1, over reps runs after a warm-up, in ns.
+// allocsPerCall, if set, gets the allocations per call
+template <typename F> double NsPerCall(int n, F f, double* allocsPerCall = NULL, int reps = 5)
+{
+  for (int i = 0; i < n / 10; i++)
+  {
+    f(i);
+  }
+
+  double best = numeric_limits<double>::infinity();
+  int64_t allocs = NumAllocs();
+  for (int rep = 0; rep < reps; rep++)
+  {
+    Timer t;
+    for (int i = 0; i < n; i++)
+    {
+      f(i);
+    }
+    best = MIN(best, t.ElapsedSeconds());
+  }
+  if (allocsPerCall)
+  {
+    *allocsPerCall = allocs < 0 ? -1 : (double)(NumAllocs() - allocs) / ((double)n * reps);
+  }
+  return best / n * 1e9;
+}
+
+// keeps the compiler from optimizing away what's benchmarked
+extern volatile float g_benchSink;
+
+int BenchEKF(int argc, char** argv);
+int BenchTrajectory(int argc, char** argv);
+int BenchDynamics(int argc, char** argv);
+int BenchIntegrators(int argc, char** argv);
@@ -0,0 +1,38 @@
+#include "Common.h"
+#include "Bench.h"
+#include "Simulation/Simulator.h"
+
+// QuadDynamics::Dynamics steps per second on one core, with the first vehicle of a
+// scenario (03_PositionControl by default) under constant motor commands, and the
+// heap allocations per step
+int BenchDynamics(int argc, char** argv)
+{
+  string scenario = argc > 0 ? argv[0] : "../config/03_PositionControl.txt";
+  shared_ptr<Simulator> sim(new Simulator());
+  sim->LoadScenario(scenario);
+  sim->Reset();
+  if (sim->_vehicles.empty())
+  {
+    SLR_ERROR1("Scenario %s defines no vehicles", scenario.c_str());
+    return 1;
+  }
+
+  QuadcopterHandle quad = sim->_vehicles[0];
+  for (int i = 0; i < 4; i++)
+  {
+    quad->curCmd.desiredThrustsN[i] = 1.3f;
+  }
+  quad->ResetState(V3F(0, 0, -1), V3F(), Quaternion<float>(), V3F(0.1f, -0.2f, 0.05f));
+
+  const float dt = 0.001f;
+  double allocs;
+  double ns = NsPerCall(2000000, [&](int i)
+  {
+    quad->Dynamics(dt, i * dt, V3F(), V3F());
+  }, &allocs);
+  g_benchSink += quad->Position().z;
+
+  printf("%s, %s: %.1f ns/step, %.2fM steps/s, %.2f allocs/step\n",
+    scenario.c_str(), quad->GetName().c_str(), ns, 1e3 / ns, allocs);
+  return 0;
+}
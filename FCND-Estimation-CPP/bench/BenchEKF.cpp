@@ -0,0 +1,131 @@
+#include "Common.h"
+#include "Bench.h"
+#include "QuadEstimatorEKF.h"
+#include "Utility/SimpleConfig.h"
+
+using namespace SLR;
+
+namespace
+{
+  const char* UPDATE_MODE_NAMES[3] = { "Batch", "Sequential", "SequentialJoseph" };
+
+  // GPS and mag update cost in mode, with a predict before every update so the
+  // covariance stays realistic, and the predict's own cost taken out
+  void TimeUpdates(const QuadEstimatorEKF& start, QuadEstimatorEKF::UpdateMode mode, double& gpsNs, double& magNs)
+  {
+    QuadEstimatorEKF est(start);
+    est.gpsUpdateMode = est.magUpdateMode = mode;
+    V3F accel(0.1f, -0.2f, -9.7f), gyro(0, 0, 0.03f);
+    double predictNs = NsPerCall(300000, [&](int i)
+    {
+      est.Predict(0.002f, accel, gyro);
+      g_benchSink += est.ekfState(0);
+    });
+    gpsNs = NsPerCall(300000, [&](int i)
+    {
+      est.Predict(0.002f, accel, gyro);
+      est.UpdateFromGPS(V3F(1, 2, -3 + 1e-3f * (i & 7)), V3F(0.1f, 0, 0));
+      g_benchSink += est.ekfState(0);
+    }) - predictNs;
+    magNs = NsPerCall(300000, [&](int i)
+    {
+      est.Predict(0.002f, accel, gyro);
+      est.UpdateFromMag(0.1f + 1e-3f * (i & 7));
+      g_benchSink += est.ekfState(6);
+    }) - predictNs;
+  }
+
+  // runs est in mode and a copy in Batch mode through 20s of 500Hz predicts with GPS
+  // updates at 50Hz and mag updates at 100Hz, and returns the largest difference in state,
+  // in covariance (relative to its largest entry), and the largest asymmetry of est's covariance
+  void CompareWithBatch(const QuadEstimatorEKF& start, QuadEstimatorEKF::UpdateMode mode, float& maxDx, float& maxDP, float& maxAsym)
+  {
+    QuadEstimatorEKF est(start), batch(start);
+    est.gpsUpdateMode = est.magUpdateMode = mode;
+    batch.gpsUpdateMode = batch.magUpdateMode = QuadEstimatorEKF::UPDATE_BATCH;
+    maxDx = maxDP = maxAsym = 0;
+    for (int k = 0; k < 10000; k++)
+    {
+      V3F accel(0.3f * sinf(k * 0.01f), 0.2f * cosf(k * 0.013f), -9.81f), gyro(0, 0, 0.1f);
+      est.Predict(0.002f, accel, gyro);
+      batch.Predict(0.002f, accel, gyro);
+      if (k % 10 == 0)
+      {
+        V3F pos(sinf(k * 1e-3f), cosf(k * 1e-3f), -1), vel(0.5f, 0.1f, 0);
+        est.UpdateFromGPS(pos, vel);
+        batch.UpdateFromGPS(pos, vel);
+      }
+      if (k % 5 == 0)
+      {
+        est.UpdateFromMag(0.3f);
+        batch.UpdateFromMag(0.3f);
+      }
+      maxDx = MAX(maxDx, (est.ekfState - batch.ekfState).cwiseAbs().maxCoeff());
+      maxDP = MAX(maxDP, (est.ekfCov - batch.ekfCov).cwiseAbs().maxCoeff() / batch.ekfCov.cwiseAbs().maxCoeff());
+      maxAsym = MAX(maxAsym, (est.ekfCov - est.ekfCov.transpose()).cwiseAbs().maxCoeff());
+    }
+  }
+}
+
+// latency of QuadEstimatorEKF's predict and update steps, and the heap allocations
+// they make, with the estimator of vehicle Quad in a scenario (11_GPSUpdate by default).
+// then the cost of the GPS and mag updates in each UpdateMode, and how far the
+// sequential modes get from Batch, which fails the benchmark beyond rounding
+int BenchEKF(int argc, char** argv)
+{
+  string scenario = argc > 0 ? argv[0] : "../config/11_GPSUpdate.txt";
+  ParamsHandle config = SimpleConfig::GetInstance();
+  config->Reset(scenario);
+  QuadEstimatorEKF est(config->Get("Quad.Estimator", "QuadEstimatorEKF"), "Quad");
+
+  // the inputs vary a little, so nothing can be hoisted out of the loops
+  V3F accel(0.1f, -0.2f, -9.7f), gyro(0.01f, 0.02f, 0.03f);
+  double allocs[4], ns[4];
+  ns[0] = NsPerCall(1000000, [&](int i)
+  {
+    est.Predict(0.002f, accel + V3F(0, 0, 1e-6f * (i & 7)), gyro);
+    g_benchSink += est.ekfState(0);
+  }, &allocs[0]);
+  ns[1] = NsPerCall(1000000, [&](int i)
+  {
+    est.UpdateFromIMU(accel + V3F(0, 0, 1e-6f * (i & 7)), gyro);
+    g_benchSink += est.rollEst;
+  }, &allocs[1]);
+  ns[2] = NsPerCall(500000, [&](int i)
+  {
+    est.UpdateFromGPS(V3F(1, 2, -3 + 1e-3f * (i & 7)), V3F(0.1f, 0, 0));
+    g_benchSink += est.ekfState(0);
+  }, &allocs[2]);
+  ns[3] = NsPerCall(1000000, [&](int i)
+  {
+    est.UpdateFromMag(0.1f + 1e-3f * (i & 7));
+    g_benchSink += est.ekfState(6);
+  }, &allocs[3]);
+
+  const char* names[4] = { "Predict", "UpdateFromIMU", "UpdateFromGPS", "UpdateFromMag" };
+  printf("%-16s %10s %12s\n", "", "ns/call", "allocs/call");
+  for (int i = 0; i < 4; i++)
+  {
+    printf("%-16s %10.1f %12.2f\n", names[i], ns[i], allocs[i]);
+  }
+
+  // from the start again, not from where the loops above left the filter
+  QuadEstimatorEKF start(config->Get("Quad.Estimator", "QuadEstimatorEKF"), "Quad");
+  int ret = 0;
+  printf("\n%-18s %10s %10s %14s %14s %14s\n", "update mode", "GPS ns", "mag ns", "max |dx|", "max rel |dP|", "max P asym");
+  for (int m = 0; m < 3; m++)
+  {
+    QuadEstimatorEKF::UpdateMode mode = (QuadEstimatorEKF::UpdateMode)m;
+    double gpsNs, magNs;
+    float maxDx, maxDP, maxAsym;
+    TimeUpdates(start, mode, gpsNs, magNs);
+    CompareWithBatch(start, mode, maxDx, maxDP, maxAsym);
+    printf("%-18s %10.1f %10.1f %14.2e %14.2e %14.2e\n", UPDATE_MODE_NAMES[m], gpsNs, magNs, maxDx, maxDP, maxAsym);
+    if (maxDx > 1e-4f || maxDP > 1e-4f)
+    {
+      printf("FAIL: %s is further from Batch than rounding\n", UPDATE_MODE_NAMES[m]);
+      ret = 1;
+    }
+  }
+  return ret;
+}
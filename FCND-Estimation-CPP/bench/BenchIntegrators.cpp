@@ -0,0 +1,175 @@
+#include "Common.h"
+#include "Bench.h"
+#include "Simulation/Simulator.h"
+#include "Utility/SimpleConfig.h"
+
+using namespace SLR;
+
+namespace
+{
+  // the Sim.Integrator and Sim.AttitudeIntegrator combinations compared
+  struct Method
+  {
+    const char* name;
+    const char* integrator;
+    const char* attitudeIntegrator;
+  };
+
+  const Method METHODS[] =
+  {
+    { "Euler", "Euler", "Fast" },
+    { "Euler+ExpMap", "Euler", "ExpMap" },
+    { "SemiImplicit", "SemiImplicitEuler", "Fast" },
+    { "SemiImpl+ExpMap", "SemiImplicitEuler", "ExpMap" },
+    { "RK4", "RK4", "Fast" },
+  };
+  const int NUM_METHODS = sizeof(METHODS) / sizeof(METHODS[0]);
+  const Method& REFERENCE = METHODS[NUM_METHODS - 1];
+
+  struct Sample
+  {
+    V3F pos;
+    Quaternion<float> att;
+  };
+
+  // the scenario reset with method at timestep dt, and the vehicles' disturbances and
+  // motor noise off, so the runs differ only in how they're integrated
+  shared_ptr<Simulator> CreateSimulator(const string& scenario, const Method& method, float dt)
+  {
+    ParamsHandle config = SimpleConfig::GetInstance();
+    config->Reset(scenario);
+    config->Set("Sim.Integrator", method.integrator);
+    config->Set("Sim.AttitudeIntegrator", method.attitudeIntegrator);
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%g", dt);
+    config->Set("Sim.Timestep", buf);
+    vector<string> names = Simulator::ScenarioVehicleNames();
+    for (unsigned int i = 0; i < names.size(); i++)
+    {
+      config->Set(names[i] + ".randomMotorForceMag", "0");
+    }
+
+    shared_ptr<Simulator> sim(new Simulator());
+    sim->LoadScenario(scenario);
+    sim->Reset();
+    for (unsigned int i = 0; i < sim->_vehicles.size(); i++)
+    {
+      sim->_vehicles[i]->TurnOffNonidealities();
+    }
+    return sim;
+  }
+
+  // every vehicle of the scenario, every 10ms until its end time, controllers in the loop
+  vector<Sample> ClosedLoop(const string& scenario, const Method& method, float dt)
+  {
+    shared_ptr<Simulator> sim = CreateSimulator(scenario, method, dt);
+    int stepsPerSample = (int)lround(0.01 / dt);
+    vector<Sample> ret;
+    while (!sim->EndTimeReached())
+    {
+      sim->RunSteps(stepsPerSample);
+      for (unsigned int i = 0; i < sim->_vehicles.size(); i++)
+      {
+        Sample s = { sim->_vehicles[i]->Position(), sim->_vehicles[i]->Attitude() };
+        ret.push_back(s);
+      }
+    }
+    return ret;
+  }
+
+  // the first vehicle tumbling for 1s under fixed uneven thrusts, every 10ms
+  vector<Sample> OpenLoop(const string& scenario, const Method& method, float dt)
+  {
+    shared_ptr<Simulator> sim = CreateSimulator(scenario, method, dt);
+    QuadcopterHandle quad = sim->_vehicles[0];
+    float thrusts[4] = { 1.5f, 1.3f, 1.4f, 1.2f };
+    for (int i = 0; i < 4; i++)
+    {
+      quad->curCmd.desiredThrustsN[i] = thrusts[i];
+    }
+    quad->ResetState(V3F(0, 0, -20), V3F(1, 0, 0), Quaternion<float>(), V3F(3, -2, 1));
+    int stepsPerSample = (int)lround(0.01 / dt);
+    vector<Sample> ret;
+    for (int s = 0; s < 100; s++)
+    {
+      for (int i = 0; i < stepsPerSample; i++)
+      {
+        quad->Dynamics(dt, 0, V3F(), V3F());
+      }
+      Sample sample = { quad->Position(), quad->Attitude() };
+      ret.push_back(sample);
+    }
+    return ret;
+  }
+
+  // angle of the rotation between a and b, from its vector part in double:
+  // acos of the dot product can't resolve less than ~1e-3 rad in float
+  double AttitudeError(const Quaternion<float>& a, const Quaternion<float>& b)
+  {
+    Quaternion<double> da(a[0], a[1], a[2], a[3]), db(b[0], b[1], b[2], b[3]);
+    Quaternion<double> r = da.Inverse() * db;
+    return 2 * asin(MIN(1.0, sqrt(r[1] * r[1] + r[2] * r[2] + r[3] * r[3])));
+  }
+
+  void PrintErrors(const Method& method, float dt, const vector<Sample>& ref, const vector<Sample>& x)
+  {
+    double maxPos = 0, maxAtt = 0;
+    for (size_t i = 0; i < MIN(ref.size(), x.size()); i++)
+    {
+      maxPos = MAX(maxPos, (double)ref[i].pos.dist(x[i].pos));
+      maxAtt = MAX(maxAtt, AttitudeError(ref[i].att, x[i].att));
+    }
+    printf("%-16s %6.1f %14.2e %14.2e\n", method.name, dt * 1e3f, maxPos, maxAtt);
+  }
+}
+
+// how far each integrator gets from RK4 at a fine timestep: a scenario's vehicles in
+// closed loop (05_TrajectoryFollow by default), and one tumbling open loop, both with
+// disturbances and motor noise off. then each integrator's cost per Dynamics() step
+int BenchIntegrators(int argc, char** argv)
+{
+  string scenario = argc > 0 ? argv[0] : "../config/05_TrajectoryFollow.txt";
+
+  printf("closed loop, against RK4 at 0.2ms\n");
+  printf("%-16s %6s %14s %14s\n", "integrator", "dt ms", "max pos err m", "max att err");
+  vector<Sample> ref = ClosedLoop(scenario, REFERENCE, 0.0002f);
+  const float closedDts[] = { 0.0005f, 0.001f, 0.002f };
+  for (int m = 0; m < NUM_METHODS; m++)
+  {
+    for (float dt : closedDts)
+    {
+      PrintErrors(METHODS[m], dt, ref, ClosedLoop(scenario, METHODS[m], dt));
+    }
+  }
+
+  printf("\nopen loop tumble, against RK4 at 0.2ms\n");
+  printf("%-16s %6s %14s %14s\n", "integrator", "dt ms", "max pos err m", "max att err");
+  ref = OpenLoop(scenario, REFERENCE, 0.0002f);
+  const float openDts[] = { 0.0005f, 0.001f, 0.002f, 0.005f };
+  for (int m = 0; m < NUM_METHODS; m++)
+  {
+    for (float dt : openDts)
+    {
+      PrintErrors(METHODS[m], dt, ref, OpenLoop(scenario, METHODS[m], dt));
+    }
+  }
+
+  printf("\n%-16s %10s\n", "integrator", "ns/step");
+  for (int m = 0; m < NUM_METHODS; m++)
+  {
+    shared_ptr<Simulator> sim = CreateSimulator(scenario, METHODS[m], 0.001f);
+    QuadcopterHandle quad = sim->_vehicles[0];
+    for (int i = 0; i < 4; i++)
+    {
+      quad->curCmd.desiredThrustsN[i] = 1.3f;
+    }
+    quad->ResetState(V3F(0, 0, -1), V3F(), Quaternion<float>(), V3F(0.1f, -0.2f, 0.05f));
+    double ns = NsPerCall(1000000, [&](int i)
+    {
+      quad->Dynamics(0.001f, i * 0.001f, V3F(), V3F());
+    }, NULL, 3);
+    g_benchSink += quad->Position().z;
+    printf("%-16s %10.1f\n", METHODS[m].name, ns);
+  }
+  return 0;
+}
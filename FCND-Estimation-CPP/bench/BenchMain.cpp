@@ -0,0 +1,102 @@
+// Benchmarks of the simulator's hot paths, to measure a change to one of them before
+// and after, and to check it against what it replaced.
+//
+// usage: CPPEstSimBench [<bench> [args]]
+// without a bench, runs all of them with their default arguments.
+// run from the build directory, so that ../config/ resolves like the simulator
+
+#include "Common.h"
+#include "Bench.h"
+#include <atomic>
+#include <string.h>
+
+volatile float g_benchSink = 0;
+
+#ifdef __GLIBC__
+extern "C" void* __libc_malloc(size_t n);
+extern "C" void* __libc_calloc(size_t n, size_t size);
+extern "C" void* __libc_realloc(void* p, size_t n);
+
+static std::atomic<int64_t> s_numAllocs(0);
+
+extern "C" void* malloc(size_t n)
+{
+  s_numAllocs++;
+  return __libc_malloc(n);
+}
+
+extern "C" void* calloc(size_t n, size_t size)
+{
+  s_numAllocs++;
+  return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* p, size_t n)
+{
+  s_numAllocs++;
+  return __libc_realloc(p, n);
+}
+
+int64_t NumAllocs()
+{
+  return s_numAllocs;
+}
+#else
+int64_t NumAllocs()
+{
+  return -1;
+}
+#endif
+
+struct Bench
+{
+  const char* name;
+  const char* description;
+  int (*run)(int argc, char** argv);
+};
+
+static const Bench BENCHES[] =
+{
+  { "ekf", "EKF predict and update latency and heap allocations, update modes compared [scenario.txt]", BenchEKF },
+  { "traj", "trajectory point lookup on 10 to 1M points, checked against the old scan", BenchTrajectory },
+  { "dynamics", "QuadDynamics::Dynamics steps per second [scenario.txt]", BenchDynamics },
+  { "integrators", "accuracy of the dynamics integrators against RK4, and their cost [scenario.txt]", BenchIntegrators },
+};
+static const int NUM_BENCHES = sizeof(BENCHES) / sizeof(BENCHES[0]);
+
+void PrintUsage()
+{
+  printf("usage: CPPEstSimBench [<bench> [args]]\n");
+  printf("Runs one benchmark, or all of them with their default arguments:\n");
+  for (int i = 0; i < NUM_BENCHES; i++)
+  {
+    printf("  %-12s %s\n", BENCHES[i].name, BENCHES[i].description);
+  }
+  printf("Run from the build directory so that ../config/ resolves like the simulator.\n");
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    int ret = 0;
+    for (int i = 0; i < NUM_BENCHES; i++)
+    {
+      printf("== %s: %s\n", BENCHES[i].name, BENCHES[i].description);
+      int benchRet = BENCHES[i].run(0, argv + argc);
+      ret = MAX(ret, benchRet);
+      printf("\n");
+    }
+    return ret;
+  }
+
+  for (int i = 0; i < NUM_BENCHES; i++)
+  {
+    if (!strcmp(argv[1], BENCHES[i].name))
+    {
+      return BENCHES[i].run(argc - 2, argv + 2);
+    }
+  }
+  PrintUsage();
+  return 2;
+}
@@ -0,0 +1,108 @@
+#include "Common.h"
+#include "Bench.h"
+#include "Trajectory.h"
+#include <random>
+
+namespace
+{
+  // how NextTrajectoryPoint found the point before the cursor: the last point with an
+  // earlier time, scanning from the end, -1 if none
+  int ScanPointBefore(const TrajectoryPoints& traj, float time)
+  {
+    for (int i = (int)traj.size() - 1; i >= 0; i--)
+    {
+      if (traj[i].time < time) return i;
+    }
+    return -1;
+  }
+
+  // NextTrajectoryPoint as it was, with the scan
+  TrajectoryPoint ScanNextTrajectoryPoint(const TrajectoryPoints& traj, float time)
+  {
+    int i = ScanPointBefore(traj, time);
+    if (i < 0) return traj[0];
+    if (i == (int)traj.size() - 1) return traj[i];
+
+    float dt = traj[i + 1].time - traj[i].time;
+    float alpha = (time - traj[i].time) / dt;
+    float beta = 1.f - alpha;
+    TrajectoryPoint ret;
+    ret.position = traj[i].position*beta + traj[i + 1].position*alpha;
+    ret.velocity = traj[i].velocity*beta + traj[i + 1].velocity*alpha;
+    ret.accel = traj[i].accel*beta + traj[i + 1].accel*alpha;
+    ret.omega = traj[i].omega*beta + traj[i + 1].omega*alpha;
+    Quaternion<float> att = traj[i].attitude;
+    ret.attitude = att.Interpolate_SLERP(traj[i + 1].attitude, alpha);
+    ret.time = time;
+    return ret;
+  }
+}
+
+// NextTrajectoryPoint on trajectories of 10 to 1M points at 50Hz, against the scan it
+// replaced: a 500Hz controller clock (seq) and uniformly random times (seek), per call
+// including the interpolation. fails if the cursor finds another point than the scan would
+int BenchTrajectory(int argc, char** argv)
+{
+  int ret = 0;
+  printf("%9s %12s %12s %12s %12s\n", "points", "scan seq", "cursor seq", "scan seek", "cursor seek");
+  for (int n = 10; n <= 1000000; n *= 10)
+  {
+    Trajectory traj;
+    for (int i = 0; i < n; i++)
+    {
+      TrajectoryPoint pt;
+      pt.time = i * .02f;
+      pt.position = V3F((float)i, 0, 0);
+      traj.AddTrajectoryPoint(pt);
+    }
+    const TrajectoryPoints& points = traj.Points();
+    float duration = (n - 1) * .02f;
+
+    // up to 20s from the middle, or up to 10s in
+    const int numCalls = 10000;
+    float start = MIN(duration * .5f, 10.f);
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(0, duration);
+    vector<float> seekTimes(numCalls);
+    for (int i = 0; i < numCalls; i++)
+    {
+      seekTimes[i] = uniform(rng);
+    }
+
+    // the scan takes milliseconds per call on the long ones
+    int numScanCalls = n >= 100000 ? 200 : numCalls;
+    double scanSeq = NsPerCall(numScanCalls, [&](int i)
+    {
+      g_benchSink += ScanNextTrajectoryPoint(points, start + i * .002f).position.x;
+    }, NULL, 3);
+    double cursorSeq = NsPerCall(numCalls, [&](int i)
+    {
+      g_benchSink += traj.NextTrajectoryPoint(start + i * .002f).position.x;
+    }, NULL, 3);
+    double scanSeek = NsPerCall(numScanCalls, [&](int i)
+    {
+      g_benchSink += ScanNextTrajectoryPoint(points, seekTimes[i]).position.x;
+    }, NULL, 3);
+    double cursorSeek = NsPerCall(numCalls, [&](int i)
+    {
+      g_benchSink += traj.NextTrajectoryPoint(seekTimes[i]).position.x;
+    }, NULL, 3);
+    printf("%9d %10.0fns %10.0fns %10.0fns %10.0fns\n", n, scanSeq, cursorSeq, scanSeek, cursorSeek);
+
+    // a mix of steps of different sizes, forward and back, and seeks
+    for (int i = 0; i < numScanCalls; i++)
+    {
+      float t = (i % 3 == 0) ? seekTimes[i] : duration * .3f + (i - numScanCalls / 2) * .002f * (1 + (i & 7));
+      TrajectoryPoint cursorPt = traj.NextTrajectoryPoint(t);
+      TrajectoryPoint scanPt = ScanNextTrajectoryPoint(points, t);
+      if (traj.GetCurTrajectoryPoint() != MAX(ScanPointBefore(points, t), 0) || !(cursorPt.position == scanPt.position))
+      {
+        printf("FAIL: %d points, t=%f: the cursor found point %d, the scan %d\n",
+          n, t, traj.GetCurTrajectoryPoint(), ScanPointBefore(points, t));
+        ret = 1;
+        break;
+      }
+    }
+  }
+  return ret;
+}
@@ -11,6 +11,7 @@ BaseController::BaseController(string name, string config)
 	_name = name;
   _config = config;
   Init();
+  AddFields();
 }
 
 void BaseController::Init()
@@ -59,38 +60,36 @@ TrajectoryPoint BaseController::GetNextTrajectoryPoint(float mission_time)
   return pt;  
 }
 
-// Access functions for graphing variables
-bool BaseController::GetData(const string& name, float& ret) const
+void BaseController::SaveState(StateBuffer& s)
 {
-  if (name.find_first_of(".") == string::npos) return false;
-  string leftPart = LeftOf(name, '.');
-  string rightPart = RightOf(name, '.');
+  s.Put(cmd);
+  s.Put(estAtt);
+  s.Put(estVel);
+  s.Put(estPos);
+  s.Put(estOmega);
+  s.Put(curTrajPoint);
+}
 
-  if (ToUpper(leftPart) == ToUpper(_name))
-  {
-#define GETTER_HELPER(A,B) if (SLR::ToUpper(rightPart) == SLR::ToUpper(A)){ ret=(B); return true; }
-    // UDACITY CONVENTION
-    GETTER_HELPER("Ref.X", curTrajPoint.position.x);
-    GETTER_HELPER("Ref.Y", curTrajPoint.position.y);
-    GETTER_HELPER("Ref.Z", curTrajPoint.position.z);
-		GETTER_HELPER("Ref.VX", curTrajPoint.velocity.x);
-		GETTER_HELPER("Ref.VY", curTrajPoint.velocity.y);
-		GETTER_HELPER("Ref.VZ", curTrajPoint.velocity.z);
-		GETTER_HELPER("Ref.Yaw", curTrajPoint.attitude.Yaw());
-#undef GETTER_HELPER
-  }
-  return false;
+bool BaseController::LoadState(StateBuffer& s)
+{
+  s.Get(cmd);
+  s.Get(estAtt);
+  s.Get(estVel);
+  s.Get(estPos);
+  s.Get(estOmega);
+  s.Get(curTrajPoint);
+  return !s.Failed();
 }
 
-vector<string> BaseController::GetFields() const
+// Graphing variables, published once
+void BaseController::AddFields()
 {
-  vector<string> ret;
-  ret.push_back(_name + ".Ref.X");
-  ret.push_back(_name + ".Ref.Y");
-  ret.push_back(_name + ".Ref.Z");
-	ret.push_back(_name + ".Ref.VX");
-	ret.push_back(_name + ".Ref.VY");
-	ret.push_back(_name + ".Ref.VZ");
-	ret.push_back(_name + ".Ref.Yaw");
-  return ret;
+  // UDACITY CONVENTION
+  AddField(_name + ".Ref.X", &curTrajPoint.position.x);
+  AddField(_name + ".Ref.Y", &curTrajPoint.position.y);
+  AddField(_name + ".Ref.Z", &curTrajPoint.position.z);
+	AddField(_name + ".Ref.VX", &curTrajPoint.velocity.x);
+	AddField(_name + ".Ref.VY", &curTrajPoint.velocity.y);
+	AddField(_name + ".Ref.VZ", &curTrajPoint.velocity.z);
+	AddField(_name + ".Ref.Yaw", [this]() { return curTrajPoint.attitude.Yaw(); });
 }
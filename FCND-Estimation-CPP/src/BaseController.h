@@ -4,6 +4,7 @@
 #include "DataSource.h"
 #include "VehicleDatatypes.h"
 #include "Trajectory.h"
+#include "Utility/StateBuffer.h"
 using namespace SLR;
 using namespace std;
 
@@ -28,9 +29,12 @@ public:
   // update the vehicle state estimates the controller will use to do control
   virtual void UpdateEstimates(V3F pos, V3F vel, Quaternion<float> attitude, V3F omega);
 
-  // Access functions for graphing variables
-  virtual bool GetData(const string& name, float& ret) const;
-  virtual vector<string> GetFields() const;
+  // publishes the graphing variables
+  void AddFields();
+
+  // the state that changes while flying, for snapshots (see BaseDynamics::SaveState)
+  virtual void SaveState(SLR::StateBuffer& s);
+  virtual bool LoadState(SLR::StateBuffer& s);
 
   void SetTrajectoryOffset(V3F trajOffset) { _trajectoryOffset = trajOffset; }
   void SetTrajTimeOffset(float timeOffset) { _trajectoryTimeOffset = timeOffset; }
@@ -3,6 +3,7 @@
 #include "DataSource.h"
 #include "Math/V3F.h"
 #include "Math/Quaternion.h"
+#include "Utility/StateBuffer.h"
 
 using SLR::Quaternion;
 
@@ -30,5 +31,12 @@ public:
 	virtual Quaternion<float> EstimatedAttitude()=0;
 	virtual V3F EstimatedOmega()=0;
 
+	// diagonal of the state covariance (x,y,z,vx,vy,vz,yaw), false if the estimator has none
+	virtual bool GetStateVariances(float var[7]) { return false; }
+
+	// the filter's state, for snapshots (see BaseDynamics::SaveState)
+	virtual void SaveState(SLR::StateBuffer& s) {};
+	virtual bool LoadState(SLR::StateBuffer& s) { return true; };
+
   string _config;
 };
@@ -2,21 +2,111 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
+#include "Utility/StringUtils.h"
 using std::string;
 using std::vector;
+using std::shared_ptr;
+
+class DataSource;
+
+// One graphable field of a DataSource. Looked up by name once (FindField),
+// then read every frame with Get() without any string work
+struct DataField
+{
+  DataField() : value(NULL), fresh(NULL) {}
+
+  bool IsValid() const { return value != NULL || (bool)getter; }
+
+  // false if there is no such field, or it has no new data this frame
+  bool Get(float& ret) const
+  {
+    if (!IsValid() || (fresh && !*fresh)) return false;
+    ret = value ? *value : getter();
+    return true;
+  }
+
+  string name;
+  const float* value;            // read directly, or
+  std::function<float()> getter; // computed when read
+  const bool* fresh;             // if set, the field only has data while *fresh is true
+
+  // set by FindField(sources, name), keeps the source (and so value/getter) alive
+  shared_ptr<DataSource> source;
+};
 
 class DataSource
 {
 public:
+  // the field called name (not case-sensitive), invalid if this source has none
+  virtual DataField FindField(const string& name) const
+  {
+    string key = SLR::ToUpper(name);
+    for (unsigned int i = 0; i < _fields.size(); i++)
+    {
+      if (SLR::ToUpper(_fields[i].name) == key)
+      {
+        return _fields[i];
+      }
+    }
+    return DataField();
+  }
+
+  // looks the field up on every call, use FindField to read a field repeatedly
   virtual bool GetData(const string& name, float& ret) const
   {
-    return false;
+    return FindField(name).Get(ret);
   }
 
   virtual vector<string> GetFields() const
   {
-    return vector<string>();
+    vector<string> ret;
+    for (unsigned int i = 0; i < _fields.size(); i++)
+    {
+      ret.push_back(_fields[i].name);
+    }
+    return ret;
   }
 
   virtual void FinalizeDataFrame() {}
-};
\ No newline at end of file
+
+protected:
+  // publish a field, once, typically from the constructor. value/getter must stay
+  // valid for the life of the source
+  void AddField(const string& name, const float* value, const bool* fresh = NULL)
+  {
+    DataField f;
+    f.name = name;
+    f.value = value;
+    f.fresh = fresh;
+    _fields.push_back(f);
+  }
+
+  void AddField(const string& name, std::function<float()> getter, const bool* fresh = NULL)
+  {
+    DataField f;
+    f.name = name;
+    f.getter = getter;
+    f.fresh = fresh;
+    _fields.push_back(f);
+  }
+
+  vector<DataField> _fields;
+};
+
+// the field called name from the first of sources that has it, the way graphs
+// and analyzers look up their variables
+inline DataField FindField(const vector<shared_ptr<DataSource> >& sources, const string& name)
+{
+  for (unsigned int i = 0; i < sources.size(); i++)
+  {
+    DataField f = sources[i]->FindField(name);
+    if (f.IsValid())
+    {
+      f.source = sources[i];
+      return f;
+    }
+  }
+  return DataField();
+}
@@ -1,10 +1,21 @@
 #pragma once
 
+#include "DataSource.h"
+
 class BaseAnalyzer
 {
 public:
 
   virtual void Reset() {};
+  // looks up the analyzed variables in sources, before the first Update() and whenever the sources change
+  virtual void ResolveFields(const std::vector<shared_ptr<DataSource> >& sources) {};
   virtual void Update(double time, std::vector<shared_ptr<DataSource> >& sources) {};
   virtual void Draw(float minX, float maxX, float minY, float maxY) {}
+
+  // true if the analyzer has seen data and its pass criteria were not met.
+  // must be queried before Reset(), which starts a new evaluation
+  virtual bool Failed() const { return false; }
+
+  // short text naming what is checked, empty if the analyzer has no pass/fail criteria
+  virtual string Description() const { return ""; }
 };
\ No newline at end of file
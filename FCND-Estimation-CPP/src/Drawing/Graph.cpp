@@ -1,6 +1,5 @@
 #include "Common.h"
 #include "Graph.h"
-#include "Drawing/DrawingFuncs.h"
 #include "Utility/SimpleConfig.h"
 #include "Utility/StringUtils.h"
 #include "DataSource.h"
@@ -14,7 +13,7 @@ using namespace SLR;
 Graph::Graph(const char* name)
 {
   _name = name;
-	_logFile = NULL;
+  _fieldsResolved = false;
   Reset();
 }
 
@@ -79,6 +78,7 @@ void Graph::AddAbsThreshold(string path)
 
   shared_ptr<AbsThreshold> thr(new AbsThreshold(args[0], (float)atof(args[1].c_str()), (float)atof(args[2].c_str())));
   _analyzers.push_back(thr);
+  _fieldsResolved = false;
 }
 
 void Graph::SetYAxis(string argsString)
@@ -113,6 +113,7 @@ void Graph::AddWindowThreshold(string path)
 
   shared_ptr<WindowThreshold> thr(new WindowThreshold(args[0], (float)atof(args[1].c_str()), (float)atof(args[2].c_str())));
   _analyzers.push_back(thr);
+  _fieldsResolved = false;
 }
 
 void Graph::AddSigmaThreshold(string path)
@@ -139,6 +140,7 @@ void Graph::AddSigmaThreshold(string path)
 		(float)atof(args[5].c_str())
 	));
 	_analyzers.push_back(thr);
+	_fieldsResolved = false;
 }
 
 void Graph::AddSeries(string path, bool autoColor, V3F color, vector<string> options)
@@ -210,6 +212,7 @@ void Graph::AddSeries(string path, bool autoColor, V3F color, vector<string> opt
     newSeries._color = HSVtoRGB(hue + 15.f , 1, 1);
   }
   _series.push_back(newSeries);
+  _fieldsResolved = false;
 }
 
 bool Graph::IsSeriesPlotted(string path)
@@ -232,6 +235,8 @@ void Graph::RemoveAllElements()
   _title = "";
   _series.clear();
   _analyzers.clear(); 
+  _resolvedSources.clear();
+  _fieldsResolved = false;
   _graphYLow = -numeric_limits<float>::infinity();
   _graphYHigh = numeric_limits<float>::infinity();
 }
@@ -265,302 +270,86 @@ void Graph::Clear()
   }
 
 	// if we were logging, stop logging, and reopen the file
-	if (_logFile)
+	if (_log)
 	{
-		fclose(_logFile);
-		_logFile = NULL;
+		_log.reset();
 		BeginLogToFile();
 	}
 }
 
 void Graph::BeginLogToFile()
 {
-	if (_logFile != NULL) return;
+	if (_log) return;
 
-	string path = "../config/log/" + _name + ".txt";
-	_logFile = fopen(path.c_str(), "w");
-	
-	if (_logFile)
+	vector<BinaryLogColumn> columns;
+	columns.push_back(BinaryLogColumn("time", BINLOG_DOUBLE));
+	for (unsigned int i = 0; i < _series.size(); i++)
 	{
-		fprintf(_logFile, "time");
-		for (unsigned int i = 0; i < _series.size(); i++)
-		{
-			fprintf(_logFile, ", ");
-			fprintf(_logFile, "%s", _series[i]._yName.c_str());
-		}
-		fprintf(_logFile, "\n");
-		fflush(_logFile);
+		columns.push_back(BinaryLogColumn(_series[i]._yName));
 	}
+	_log.reset(new BinaryLogWriter("../config/log/" + _name + ".bin", columns));
 }
 
-void Graph::Update(double time, std::vector<shared_ptr<DataSource> >& sources)
+void Graph::ResolveFields(std::vector<shared_ptr<DataSource> >& sources)
 {
-	std::vector<bool> newData(_series.size());
-	bool anyNewData = false;
-
   for (unsigned int i = 0; i < _series.size(); i++)
   {
-		newData[i] = false;
-    for (unsigned int j = 0; j < sources.size(); j++)
-    {
-      float tmp;
-			if (sources[j]->GetData(_series[i]._yName, tmp))
-			{
-				newData[i] = true;
-				anyNewData = true;
-				_series[i].x.push((float)time);
-        if (_series[i].negate)
-        {
-          _series[i].y.push(-tmp);
-        }
-        else
-        {
-          _series[i].y.push(tmp);
-        }
-        break;
-      }
-    } 
+    _series[i]._field = FindField(sources, _series[i]._yName);
   }
-
-	if (_logFile != NULL && anyNewData)
-	{
-		fprintf(_logFile, "%f", time);
-		for (unsigned int i = 0; i < _series.size(); i++)
-		{
-			if (newData[i])
-			{
-				fprintf(_logFile, ",%f", _series[i].y.newest());
-			}
-			else
-			{
-				fprintf(_logFile, ",%f", numeric_limits<float>::quiet_NaN());
-			}
-		}
-		fprintf(_logFile, "\n");
-		fflush(_logFile);
-	}
-
   for (unsigned i = 0; i < _analyzers.size(); i++)
   {
-    _analyzers[i]->Update(time,sources);
-  }
-}
-
-void GetRange(FixedQueue<float>& f, float& low, float& high)
-{
-  low = high = 0;
-  if (f.n_meas() == 0) return;
-  low = high = f[0];
-  for (unsigned int i = 1; i < f.n_meas(); i++)
-  {
-    low = MIN(low, f[i]);
-    high = MAX(high, f[i]);
-  }
-
-}
-
-void Graph::DrawSeries(Series& s)
-{
-  if (s.x.n_meas() < 2 || s.x.n_meas() != s.y.n_meas()) return;
-
-  glColor3f(s._color[0], s._color[1], s._color[2]);
-
-  float tmp = 0;
-  glGetFloatv(GL_LINE_WIDTH, &tmp);
-
-  if (s.bold)
-  {
-    glLineWidth(2);    
+    _analyzers[i]->ResolveFields(sources);
   }
-
-  glBegin(GL_LINE_STRIP);
-  for (unsigned int i = 0; i < s.x.n_meas(); i++)
-  {
-    glVertex2f(s.x[i], s.y[i]); 
-  }
-  glEnd();
-
-  glLineWidth(tmp);
-
+  _resolvedSources = sources;
+  _fieldsResolved = true;
 }
 
-// Given a data range (r), what is the format string we should use for printing the tick
-// labels, how many ticks should there be, and what should the tick labels be?
-// This is a rough pragmatic solution that usually produces reasonable results
-// 
-// Input: low, high -> range of the data of interest
-// Returns: string w/ printf format to use for printing the tick labels (e.g. "%.2lf)
-// Optional returns:
-//    tick: if !null, gets the value at of the 'optimal' tick-tick distance
-//	  A: if !null, set to the 'tick' value just below the input range
-//	  B: if !null, set to the 'tick' value just above the input range
-string GetValueFormat(float low, float high, float* tick, float* A, float* B)
+void Graph::Update(double time, std::vector<shared_ptr<DataSource> >& sources)
 {
-  char format[100];
-
-  float range = high - low;
-  float T = powf(10.f, floor(log10f(range)));
-  if (range / T < 4) T /= 2.f;
-  if (range / T > 8) T *= 2.f;
-
-  if (T<1)
-  {
-    sprintf_s(format, 100, "%%.%dlf", -(int)floor(log10f(T)));
-  }
-  else
+  if (!_fieldsResolved || sources != _resolvedSources)
   {
-    sprintf_s(format, 100, "%%.0lf");
+    ResolveFields(sources);
   }
 
-  if (tick != NULL)		*tick = T;
-  if (A != NULL)		*A = low - fmodf(low, T);
-  if (B != NULL)		*B = high - fmodf(high, T) + T;
-  return format;
-}
-
-void Graph::Draw()
-{
-  if (_series.size() == 0) return;
-
-  // find range
-  float lowX = 0, highX = 0, lowY = 0, highY = 0;
+	std::vector<bool> newData(_series.size());
+	bool anyNewData = false;
 
   for (unsigned int i = 0; i < _series.size(); i++)
   {
-    float tmpLY = lowY, tmpHY = highY;
-    GetRange(_series[i].y, tmpLY, tmpHY);
-    if (i == 0)
-    {
-      lowY = tmpLY;
-      highY = tmpHY;
-    }
-    else
-    {
-      lowY = MIN(lowY, tmpLY);
-      highY = MAX(highY, tmpHY);
-    }
-
-    float tmpLX = lowX, tmpHX = highX;
-    GetRange(_series[i].x, tmpLX, tmpHX);
-    if (i == 0)
-    {
-      lowX = tmpLX;
-      highX = tmpHX;
-    }
-    else
-    {
-      lowX = MIN(lowX, tmpLX);
-      highX = MAX(highX, tmpHX);
+		newData[i] = false;
+    float tmp;
+		if (_series[i]._field.Get(tmp))
+		{
+			newData[i] = true;
+			anyNewData = true;
+			_series[i].x.push((float)time);
+      if (_series[i].negate)
+      {
+        _series[i].y.push(-tmp);
+      }
+      else
+      {
+        _series[i].y.push(tmp);
+      }
     }
   }
 
-  if ((highY - lowY) < 0.001f)
-  {
-    float mid = (highY + lowY) / 2.f;
-    lowY = mid - 0.0005f;
-    highY = mid + 0.0005f;
-  }
-
-  if ((highX - lowX) < 1.f)
-  {
-    highX = lowX + 1.f;
-  }
-
-  if (_graphYLow != -numeric_limits<float>::infinity())
-  {
-    lowY = MIN(_graphYLow,lowY);
-  }
-  if (_graphYHigh != numeric_limits<float>::infinity())
-  {
-    highY = MAX(_graphYHigh,highY);
-  }
-
-  // expand by 10%
-  float rangeY = highY - lowY;
-  lowY -= rangeY * 0.05f;
-  highY += rangeY * 0.05f;
-  
-  // if we have a title, expand up by further 11%
-  if (!_title.empty())
-  {
-    highY += rangeY * 0.11f;
-  }
-
-  lowX -= (highX - lowX) * .1f;
-
-  glPushMatrix();
-
-  glScalef(2.f / (highX - lowX), 2.f / (highY - lowY), 1.f);
-  glTranslatef(-(highX + lowX) / 2.f, -(highY + lowY) / 2.f, 0.f);
-
-  
-  // y=0 line
-  
-  glLineWidth(1);
-  glBegin(GL_LINES);  
-  glColor3f(.5f, .5f, .5f);
-  if (0 > lowY && 0 < highY)
-  {
-    glVertex2f(lowX, 0);
-    glVertex2f(highX, 0);
-  }
-  glEnd();
-  
-
-  glLineWidth(1);
-  glBegin(GL_LINES);
-
-  // grid
-  glColor3f(0.1f, 0.1f, 0.1f);
-  
-  float tickYDelta = 0, tickYLow = 0, tickYHigh = 0;
-  string tickYFormat = GetValueFormat(lowY, highY, &tickYDelta, &tickYLow, &tickYHigh);
-  for (float y = tickYLow; y <= tickYHigh; y += tickYDelta)
-  {
-    if (y < lowY || y> highY || y==0) continue;
-    glVertex2f(lowX, y);
-    glVertex2f(highX, y);
-  }
-
-  glEnd(); // GL_LINES
-
-	for (unsigned int i = 0; i < _series.size(); i++)
+	// series without new data are left NaN. series added after BeginLogToFile aren't logged
+	if (_log && anyNewData)
 	{
-		DrawSeries(_series[i]);
+		_log->Set(0, time);
+		for (unsigned int i = 0; i < _series.size() && (int)i + 1 < _log->NumColumns(); i++)
+		{
+			if (newData[i])
+			{
+				_log->Set(i + 1, _series[i].y.newest());
+			}
+		}
+		_log->EndRow();
 	}
 
   for (unsigned i = 0; i < _analyzers.size(); i++)
   {
-    _analyzers[i]->Draw(lowX, highX, lowY, highY);
-  }
-
-  // tick labels
-  glColor3f(.9f,.9f,.9f);
-  for (float y = tickYLow; y <= tickYHigh; y += tickYDelta)
-  {
-    if (y < (lowY + (highY-lowY)*.05f) || y> (highY - (highY - lowY)*.05f)) continue;
-    char buf[100];
-    sprintf_s(buf, 100, tickYFormat.c_str(), y);
-    DrawStrokeText(buf, lowX + .01f*(highX-lowX), y, 0, 1.2f,(highX-lowX)/3.f, (highY - lowY)/3.f*2.f);
-  }
-  
-  glPopMatrix();
-  
-  // series names
-  int j = 0;
-  if (!_title.empty()) j = 1;
-  for (unsigned int i = 0; i < _series.size(); i++)
-  {
-    if (_series[i].noLegend) continue;
-    glColor3f(_series[i]._color[0], _series[i]._color[1], _series[i]._color[2]);
-    DrawStrokeText_Align(ToLower(_series[i]._legend).c_str(), .95f, .8f - j * .205f, 0, 1.5f, 1.f, 2.f,GLD_ALIGN_RIGHT);
-    j++;
-  }
-
-  // draw title
-  if (!_title.empty())
-  {
-    glColor3f(1, 1, 1);
-    DrawStrokeText_Align(_title.c_str(), 0.01f, .8f, 0, 1.5f, 1.f, 2.f,GLD_ALIGN_CENTER);
+    _analyzers[i]->Update(time,sources);
   }
 }
@@ -4,9 +4,10 @@
 #include <map>
 using namespace std;
 #include "../Utility/FixedQueue.h"
+#include "../DataSource.h"
+#include "../Utility/BinaryLog.h"
 
 class QuadDynamics;
-class DataSource;
 class BaseAnalyzer;
 
 #define MAX_POINTS 10000
@@ -31,6 +32,7 @@ public:
   void RemoveAllElements();
   void SetTitle(string title) { _title = title; }
 
+	// logs the series plotted so far to ../config/log/<name>.bin, see BinaryLog.h
 	void BeginLogToFile();
 
 
@@ -40,6 +42,7 @@ public:
     V3F _color;
     string _yName, _legend;
     string _objName, _fieldName;
+    DataField _field; // _yName, looked up in the sources
     FixedQueue<float> x;
     FixedQueue<float> y;
     bool noLegend, bold, negate;
@@ -57,7 +60,13 @@ public:
   vector<Series> _series;
   string _name;
 
-	FILE* _logFile;
+  // looks up the series' and analyzers' variables once, Update() only reads the fields.
+  // Update() does it again when it is given different sources or something was added
+  void ResolveFields(std::vector<shared_ptr<DataSource> >& sources);
+  std::vector<shared_ptr<DataSource> > _resolvedSources;
+  bool _fieldsResolved;
+
+	shared_ptr<SLR::BinaryLogWriter> _log;
 
   float _graphYLow, _graphYHigh;
   string _title;
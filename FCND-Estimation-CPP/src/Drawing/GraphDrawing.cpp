@@ -0,0 +1,509 @@
+#include "Common.h"
+#include "Graph.h"
+#include "GraphManager.h"
+#include "DrawingFuncs.h"
+#include "Utility/StringUtils.h"
+#include "AbsThreshold.h"
+#include "WindowThreshold.h"
+#include "SigmaThreshold.h"
+
+// everything that draws the graphs with OpenGL, left out of builds without a window (see
+// Headless/NoGraphics.cpp), so the rest of the graph code only needs the standard library
+
+GraphManager* _g_GraphManager=NULL;
+
+void _g_OnGrapherDisplay()
+{
+  if (_g_GraphManager != NULL)
+  {
+    _g_GraphManager->Paint();
+  }
+}
+
+void _g_OnGrapherReshape(int w, int h)
+{
+  if (_g_GraphManager != NULL)
+  {
+    _g_GraphManager->Paint();
+  }
+}
+
+void GraphManager::OpenWindow()
+{
+  _g_GraphManager = this;
+
+  glutInitWindowSize(500, 300);
+  glutInitWindowPosition(0, 0);
+  _glutWindowNum = glutCreateWindow("Grapher");
+  glutSetWindow(_glutWindowNum);
+
+  glutReshapeFunc(&_g_OnGrapherReshape);
+  glutDisplayFunc(&_g_OnGrapherDisplay);
+
+  InitPaint();
+}
+
+void GraphManager::CloseWindow()
+{
+  if (_g_GraphManager == this)
+  {
+    _g_GraphManager = NULL;
+  }
+}
+
+void GraphManager::DrawUpdate()
+{
+ 
+  if (_ownWindow)
+  {
+    glutSetWindow(_glutWindowNum);
+    glutPostRedisplay();
+  }
+}
+
+void GraphManager::InitPaint()
+{
+  glClearColor(0.0, 0.0, 0.0, 0.0);  // When screen cleared, use black.
+  glShadeModel(GL_SMOOTH);  // How the object color will be rendered smooth or flat
+}
+
+void GraphManager::Paint()
+{
+  if (_ownWindow)
+  {
+    glutSetWindow(_glutWindowNum);
+
+    int width = glutGet(GLUT_WINDOW_WIDTH);
+    int height = glutGet(GLUT_WINDOW_HEIGHT);
+
+    glViewport(0, 0, width, height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  //Clear the screen
+  }
+  else
+  {
+
+  }
+
+  if (graph1 && graph1->_series.size())
+  {
+    glPushMatrix();
+    if (graph2 && graph2->_series.size())
+    {
+      glTranslatef(0, .55f, 0);
+    }
+    else
+    {
+      glTranslatef(0, -.5f, 0);
+    }
+    glScalef(1, .5f, 1);
+
+    glColor3f(0, 0, 0);
+    glBegin(GL_QUADS);
+    glVertex2f(-1, 1);
+    glVertex2f(1, 1);
+    glVertex2f(1, -1);
+    glVertex2f(-1, -1);
+    glEnd();
+
+    graph1->Draw();
+    glPopMatrix();
+  }
+
+  if (graph2 && graph2->_series.size())
+  {
+    glPushMatrix();
+    glTranslatef(0, -.5f, 0);
+    glScalef(1, .5f, 1);
+
+    glColor3f(0, 0, 0);
+    glBegin(GL_QUADS);
+    glVertex2f(-1, 1);
+    glVertex2f(1, 1);
+    glVertex2f(1, -1);
+    glVertex2f(-1, -1);
+    glEnd();
+
+    graph2->Draw();
+    glPopMatrix();
+  }
+
+  glFlush();  // Render now
+
+  if (_ownWindow)
+  {
+    glutSwapBuffers();
+  }
+}
+
+void GetRange(FixedQueue<float>& f, float& low, float& high)
+{
+  low = high = 0;
+  if (f.n_meas() == 0) return;
+  low = high = f[0];
+  for (unsigned int i = 1; i < f.n_meas(); i++)
+  {
+    low = MIN(low, f[i]);
+    high = MAX(high, f[i]);
+  }
+
+}
+
+void Graph::DrawSeries(Series& s)
+{
+  if (s.x.n_meas() < 2 || s.x.n_meas() != s.y.n_meas()) return;
+
+  glColor3f(s._color[0], s._color[1], s._color[2]);
+
+  float tmp = 0;
+  glGetFloatv(GL_LINE_WIDTH, &tmp);
+
+  if (s.bold)
+  {
+    glLineWidth(2);    
+  }
+
+  glBegin(GL_LINE_STRIP);
+  for (unsigned int i = 0; i < s.x.n_meas(); i++)
+  {
+    glVertex2f(s.x[i], s.y[i]); 
+  }
+  glEnd();
+
+  glLineWidth(tmp);
+
+}
+
+// Given a data range (r), what is the format string we should use for printing the tick
+// labels, how many ticks should there be, and what should the tick labels be?
+// This is a rough pragmatic solution that usually produces reasonable results
+// 
+// Input: low, high -> range of the data of interest
+// Returns: string w/ printf format to use for printing the tick labels (e.g. "%.2lf)
+// Optional returns:
+//    tick: if !null, gets the value at of the 'optimal' tick-tick distance
+//	  A: if !null, set to the 'tick' value just below the input range
+//	  B: if !null, set to the 'tick' value just above the input range
+string GetValueFormat(float low, float high, float* tick, float* A, float* B)
+{
+  char format[100];
+
+  float range = high - low;
+  float T = powf(10.f, floor(log10f(range)));
+  if (range / T < 4) T /= 2.f;
+  if (range / T > 8) T *= 2.f;
+
+  if (T<1)
+  {
+    sprintf_s(format, 100, "%%.%dlf", -(int)floor(log10f(T)));
+  }
+  else
+  {
+    sprintf_s(format, 100, "%%.0lf");
+  }
+
+  if (tick != NULL)		*tick = T;
+  if (A != NULL)		*A = low - fmodf(low, T);
+  if (B != NULL)		*B = high - fmodf(high, T) + T;
+  return format;
+}
+
+void Graph::Draw()
+{
+  if (_series.size() == 0) return;
+
+  // find range
+  float lowX = 0, highX = 0, lowY = 0, highY = 0;
+
+  for (unsigned int i = 0; i < _series.size(); i++)
+  {
+    float tmpLY = lowY, tmpHY = highY;
+    GetRange(_series[i].y, tmpLY, tmpHY);
+    if (i == 0)
+    {
+      lowY = tmpLY;
+      highY = tmpHY;
+    }
+    else
+    {
+      lowY = MIN(lowY, tmpLY);
+      highY = MAX(highY, tmpHY);
+    }
+
+    float tmpLX = lowX, tmpHX = highX;
+    GetRange(_series[i].x, tmpLX, tmpHX);
+    if (i == 0)
+    {
+      lowX = tmpLX;
+      highX = tmpHX;
+    }
+    else
+    {
+      lowX = MIN(lowX, tmpLX);
+      highX = MAX(highX, tmpHX);
+    }
+  }
+
+  if ((highY - lowY) < 0.001f)
+  {
+    float mid = (highY + lowY) / 2.f;
+    lowY = mid - 0.0005f;
+    highY = mid + 0.0005f;
+  }
+
+  if ((highX - lowX) < 1.f)
+  {
+    highX = lowX + 1.f;
+  }
+
+  if (_graphYLow != -numeric_limits<float>::infinity())
+  {
+    lowY = MIN(_graphYLow,lowY);
+  }
+  if (_graphYHigh != numeric_limits<float>::infinity())
+  {
+    highY = MAX(_graphYHigh,highY);
+  }
+
+  // expand by 10%
+  float rangeY = highY - lowY;
+  lowY -= rangeY * 0.05f;
+  highY += rangeY * 0.05f;
+  
+  // if we have a title, expand up by further 11%
+  if (!_title.empty())
+  {
+    highY += rangeY * 0.11f;
+  }
+
+  lowX -= (highX - lowX) * .1f;
+
+  glPushMatrix();
+
+  glScalef(2.f / (highX - lowX), 2.f / (highY - lowY), 1.f);
+  glTranslatef(-(highX + lowX) / 2.f, -(highY + lowY) / 2.f, 0.f);
+
+  
+  // y=0 line
+  
+  glLineWidth(1);
+  glBegin(GL_LINES);  
+  glColor3f(.5f, .5f, .5f);
+  if (0 > lowY && 0 < highY)
+  {
+    glVertex2f(lowX, 0);
+    glVertex2f(highX, 0);
+  }
+  glEnd();
+  
+
+  glLineWidth(1);
+  glBegin(GL_LINES);
+
+  // grid
+  glColor3f(0.1f, 0.1f, 0.1f);
+  
+  float tickYDelta = 0, tickYLow = 0, tickYHigh = 0;
+  string tickYFormat = GetValueFormat(lowY, highY, &tickYDelta, &tickYLow, &tickYHigh);
+  for (float y = tickYLow; y <= tickYHigh; y += tickYDelta)
+  {
+    if (y < lowY || y> highY || y==0) continue;
+    glVertex2f(lowX, y);
+    glVertex2f(highX, y);
+  }
+
+  glEnd(); // GL_LINES
+
+	for (unsigned int i = 0; i < _series.size(); i++)
+	{
+		DrawSeries(_series[i]);
+	}
+
+  for (unsigned i = 0; i < _analyzers.size(); i++)
+  {
+    _analyzers[i]->Draw(lowX, highX, lowY, highY);
+  }
+
+  // tick labels
+  glColor3f(.9f,.9f,.9f);
+  for (float y = tickYLow; y <= tickYHigh; y += tickYDelta)
+  {
+    if (y < (lowY + (highY-lowY)*.05f) || y> (highY - (highY - lowY)*.05f)) continue;
+    char buf[100];
+    sprintf_s(buf, 100, tickYFormat.c_str(), y);
+    DrawStrokeText(buf, lowX + .01f*(highX-lowX), y, 0, 1.2f,(highX-lowX)/3.f, (highY - lowY)/3.f*2.f);
+  }
+  
+  glPopMatrix();
+  
+  // series names
+  int j = 0;
+  if (!_title.empty()) j = 1;
+  for (unsigned int i = 0; i < _series.size(); i++)
+  {
+    if (_series[i].noLegend) continue;
+    glColor3f(_series[i]._color[0], _series[i]._color[1], _series[i]._color[2]);
+    DrawStrokeText_Align(ToLower(_series[i]._legend).c_str(), .95f, .8f - j * .205f, 0, 1.5f, 1.f, 2.f,GLD_ALIGN_RIGHT);
+    j++;
+  }
+
+  // draw title
+  if (!_title.empty())
+  {
+    glColor3f(1, 1, 1);
+    DrawStrokeText_Align(_title.c_str(), 0.01f, .8f, 0, 1.5f, 1.f, 2.f,GLD_ALIGN_CENTER);
+  }
+}
+
+void AbsThreshold::Draw(float minX, float maxX, float minY, float maxY)
+{
+  glColor3f(.1f, .2f, .1f);
+
+  if (_thresh > minY && _thresh < maxY)
+  {
+    glBegin(GL_LINES);
+    glVertex2f(minX, _thresh);
+    glVertex2f(maxX, _thresh);
+    glEnd();
+  }
+
+  if ((-_thresh) > minY && (-_thresh) < maxY)
+  {
+    glBegin(GL_LINES);
+    glVertex2f(minX, -_thresh);
+    glVertex2f(maxX, -_thresh);
+    glEnd();
+  }
+
+  if (_lastTimeAboveThresh == numeric_limits<float>::infinity() || _lastTimeAboveThresh<minX || _lastTimeAboveThresh>maxX)
+  {
+    return;
+  }
+
+  if (_triggered)
+  {
+    glColor3f(0, 1, 0);
+  }
+  else
+  {
+    glColor3f(.2f, .4f, .2f);
+  }
+  glBegin(GL_LINES);
+  glVertex2f(_lastTimeAboveThresh, minY);
+  glVertex2f(_lastTimeAboveThresh, maxY);
+  glEnd();
+
+  char buf[100];
+  sprintf_s(buf, 100, "t_set = %.3lf", _lastTimeAboveThresh);
+  DrawStrokeText(buf, _lastTimeAboveThresh + (maxX - minX)*.05f , minY + (maxY - minY) / 2.f, 0, 1.2f, (maxX - minX) / 2.f, (maxY - minY) / 2.f *2.f);
+}
+
+void WindowThreshold::Draw(float minX, float maxX, float minY, float maxY)
+{
+  glColor3f(.1f, .2f, .1f);
+
+  if (_thresh > minY && _thresh < maxY)
+  {
+    glBegin(GL_LINES);
+    glVertex2f(minX, _thresh);
+    glVertex2f(maxX, _thresh);
+    glEnd();
+  }
+
+  if ((-_thresh) > minY && (-_thresh) < maxY)
+  {
+    glBegin(GL_LINES);
+    glVertex2f(minX, -_thresh);
+    glVertex2f(maxX, -_thresh);
+    glEnd();
+  }
+
+  if (_lastTimeAboveThresh == numeric_limits<float>::infinity() || _lastTimeAboveThresh<minX || _lastTimeAboveThresh>maxX)
+  {
+    return;
+  }
+
+  if (_active)
+  {
+			float tmp = 0;
+			glGetFloatv(GL_LINE_WIDTH, &tmp);
+			glLineWidth(2);
+    glColor3f(0, 1, 0);
+    glBegin(GL_LINE_STRIP);
+    glVertex2f(_lastTimeAboveThresh, CONSTRAIN(_thresh,minY,maxY));
+    glVertex2f(_lastTime, CONSTRAIN(_thresh, minY, maxY));
+    glVertex2f(_lastTime, CONSTRAIN(-_thresh, minY, maxY));
+    glVertex2f(_lastTimeAboveThresh, CONSTRAIN(-_thresh, minY, maxY));
+    glVertex2f(_lastTimeAboveThresh, CONSTRAIN(_thresh, minY, maxY));
+    glEnd();
+			glLineWidth(tmp);
+  }
+  else
+  {
+    glColor3f(.7f, .1f, .1f);
+    if (_thresh > minY && _thresh < maxY)
+    {
+      glBegin(GL_LINES);
+      glVertex2f(minX, _thresh);
+      glVertex2f(maxX, _thresh);
+      glEnd();
+    }
+    if (-_thresh > minY && -_thresh < maxY)
+    {
+      glBegin(GL_LINES);
+      glVertex2f(minX, -_thresh);
+      glVertex2f(maxX, -_thresh);
+      glEnd();
+    }
+  }
+}
+
+void SigmaThreshold::Draw(float minX, float maxX, float minY, float maxY)
+{
+  glColor3f(.1f, .2f, .1f);
+
+		if (x.n_meas() < 2) return;
+
+		float g = 0.8f;
+		if ((_lastTime- _lastViolationTime) >= _minTimeWindow)
+		{
+			g = 1.f;
+			glColor3f(.2f, g, .2f);
+		}
+		else
+		{
+			glColor3f(.7f, .7f, .7f);
+		}
+
+		glBegin(GL_LINE_STRIP);
+		for (unsigned int i = 0; i < x.n_meas(); i++)
+		{
+			glVertex2f(x[i], CONSTRAIN(low[i],minY,maxY));
+		}
+		glEnd();
+		glBegin(GL_LINE_STRIP);
+		for (unsigned int i = 0; i < x.n_meas(); i++)
+		{
+			glVertex2f(x[i], CONSTRAIN(high[i],minY,maxY));
+		}
+		glEnd();
+
+		float per = (float)in / (float)(in + out)*100.f;
+
+		const float dx = maxX - minX;
+		const float dy = maxY - minY;
+		const float left = minX + dx*.1f;
+		const float bot = minY + dy / 2.f;
+
+		glColor4f(.8f, g, .8f, .8f);
+		glBegin(GL_QUADS);
+		glVertex2f(left -dx*.02f, bot-dy*.02f);
+		glVertex2f(left +dx*.07f, bot - dy * .02f);
+		glVertex2f(left +dx*.07f, bot+dy*.1f);
+		glVertex2f(left - dx * .02f, bot+dy*.1f);
+		glEnd();
+
+		glColor3f(.1f, .1f, .1f);
+		char buf[100];
+		sprintf_s(buf, 100, "%.0lf%%", per);
+		DrawStrokeText(buf, left, bot, 0, 1.2f, (maxX - minX) / 2.5f, (maxY - minY) / 2.5f *2.f);
+}
@@ -2,48 +2,22 @@
 #include "GraphManager.h"
 #include "../Utility/SimpleConfig.h"
 #include "../Utility/StringUtils.h"
-#include "DrawingFuncs.h"
 #include "DataSource.h"
 
 using namespace SLR;
 
-GraphManager* _g_GraphManager=NULL;
-
-void _g_OnGrapherDisplay()
-{
-  if (_g_GraphManager != NULL)
-  {
-    _g_GraphManager->Paint();
-  }
-}
-
-void _g_OnGrapherReshape(int w, int h)
-{
-  if (_g_GraphManager != NULL)
-  {
-    _g_GraphManager->Paint();
-  }
-}
-
 GraphManager::GraphManager(bool own_window)
 {
 	ParamsHandle config = SimpleConfig::GetInstance();
 
   _ownWindow = own_window;
+  _dataLogDecimation = 1;
+  _dataLogCount = 0;
 
+  _glutWindowNum = 0;
   if (_ownWindow)
   {
-    _g_GraphManager = this;
-
-    glutInitWindowSize(500, 300);
-    glutInitWindowPosition(0, 0);
-    _glutWindowNum = glutCreateWindow("Grapher");
-    glutSetWindow(_glutWindowNum);
-
-    glutReshapeFunc(&_g_OnGrapherReshape);
-    glutDisplayFunc(&_g_OnGrapherDisplay);
-
-    InitPaint();
+    OpenWindow();
   }
 
   graph1.reset(new Graph("Graph1"));
@@ -52,10 +26,11 @@ GraphManager::GraphManager(bool own_window)
 
 GraphManager::~GraphManager()
 {
+  EndDataLog();
   graph1.reset();
   graph2.reset();
   Sleep(100);
-  _g_GraphManager = NULL;
+  CloseWindow();
 }
 
 void GraphManager::Reset()
@@ -81,99 +56,59 @@ void GraphManager::UpdateData(double time)
     graph2->Update(time, _sources);
   }
 
-  for (auto i = _sources.begin(); i != _sources.end(); i++)
+  // before FinalizeDataFrame() clears the sensors' fresh flags
+  if (_dataLog && (_dataLogCount++ % _dataLogDecimation) == 0)
   {
-    (*i)->FinalizeDataFrame();
+    _dataLog->Set(0, time);
+    for (unsigned int i = 0; i < _dataLogFields.size(); i++)
+    {
+      float tmp;
+      if (_dataLogFields[i].Get(tmp))
+      {
+        _dataLog->Set(i + 1, tmp);
+      }
+    }
+    _dataLog->EndRow();
   }
-}
 
-void GraphManager::DrawUpdate()
-{
- 
-  if (_ownWindow)
+  for (auto i = _sources.begin(); i != _sources.end(); i++)
   {
-    glutSetWindow(_glutWindowNum);
-    glutPostRedisplay();
+    (*i)->FinalizeDataFrame();
   }
 }
 
-void GraphManager::InitPaint()
+void GraphManager::RegisterDataSource(shared_ptr<DataSource> src)
 {
-  glClearColor(0.0, 0.0, 0.0, 0.0);  // When screen cleared, use black.
-  glShadeModel(GL_SMOOTH);  // How the object color will be rendered smooth or flat
+  _sources.push_back(src);
 }
 
-void GraphManager::Paint()
+void GraphManager::BeginDataLog(const string& filename, int decimation)
 {
-  if (_ownWindow)
-  {
-    glutSetWindow(_glutWindowNum);
-
-    int width = glutGet(GLUT_WINDOW_WIDTH);
-    int height = glutGet(GLUT_WINDOW_HEIGHT);
-
-    glViewport(0, 0, width, height);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);  //Clear the screen
-  }
-  else
-  {
+  EndDataLog();
 
-  }
-
-  if (graph1 && graph1->_series.size())
+  vector<BinaryLogColumn> columns;
+  columns.push_back(BinaryLogColumn("time", BINLOG_DOUBLE));
+  for (auto i = _sources.begin(); i != _sources.end(); i++)
   {
-    glPushMatrix();
-    if (graph2 && graph2->_series.size())
+    vector<string> fields = (*i)->GetFields();
+    for (auto j = fields.begin(); j != fields.end(); j++)
     {
-      glTranslatef(0, .55f, 0);
+      DataField f = (*i)->FindField(*j);
+      f.source = *i;
+      _dataLogFields.push_back(f);
+      columns.push_back(BinaryLogColumn(*j));
     }
-    else
-    {
-      glTranslatef(0, -.5f, 0);
-    }
-    glScalef(1, .5f, 1);
-
-    glColor3f(0, 0, 0);
-    glBegin(GL_QUADS);
-    glVertex2f(-1, 1);
-    glVertex2f(1, 1);
-    glVertex2f(1, -1);
-    glVertex2f(-1, -1);
-    glEnd();
-
-    graph1->Draw();
-    glPopMatrix();
-  }
-
-  if (graph2 && graph2->_series.size())
-  {
-    glPushMatrix();
-    glTranslatef(0, -.5f, 0);
-    glScalef(1, .5f, 1);
-
-    glColor3f(0, 0, 0);
-    glBegin(GL_QUADS);
-    glVertex2f(-1, 1);
-    glVertex2f(1, 1);
-    glVertex2f(1, -1);
-    glVertex2f(-1, -1);
-    glEnd();
-
-    graph2->Draw();
-    glPopMatrix();
   }
 
-  glFlush();  // Render now
-
-  if (_ownWindow)
-  {
-    glutSwapBuffers();
-  }
+  _dataLog.reset(new BinaryLogWriter(filename, columns));
+  _dataLogDecimation = MAX(decimation, 1);
+  _dataLogCount = 0;
 }
 
-void GraphManager::RegisterDataSource(shared_ptr<DataSource> src)
+void GraphManager::EndDataLog()
 {
-  _sources.push_back(src);
+  _dataLog.reset();
+  _dataLogFields.clear();
 }
 
 vector<string> GraphManager::GetGraphableStrings()
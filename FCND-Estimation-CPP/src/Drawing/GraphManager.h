@@ -35,7 +35,21 @@ public:
 
   std::vector<std::string> GetGraphableStrings();
 
+  // logs every field of the registered sources to filename (see BinaryLog.h), on every
+  // decimation'th UpdateData() call. The columns are the fields registered at the time of the call.
+  // Replaces any log already running
+  void BeginDataLog(const string& filename, int decimation = 1);
+  void EndDataLog();
+
 protected:
+  // the drawing side, in GraphDrawing.cpp
+  void OpenWindow();
+  void CloseWindow();
+
   int _glutWindowNum;
   bool _ownWindow;
+
+  shared_ptr<SLR::BinaryLogWriter> _dataLog;
+  std::vector<DataField> _dataLogFields;
+  int _dataLogDecimation, _dataLogCount;
 };
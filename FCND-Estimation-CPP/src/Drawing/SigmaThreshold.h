@@ -48,7 +48,7 @@ public:
     Reset();
   }
 
-	string MakeStringFromParamOrConst(string param, float c)
+	string MakeStringFromParamOrConst(string param, float c) const
 	{
 		string ret = param;
 		if (param== "")
@@ -107,22 +107,31 @@ public:
 		out = 0;
   }
 
-	bool TryUpdate(std::vector<shared_ptr<DataSource> >& sources, string& varname, float& ret)
+	bool Failed() const
 	{
-		for (unsigned int j = 0; j < sources.size(); j++)
-		{
-			if (sources[j]->GetData(varname, ret))
-			{
-				return true;
-			}
-		}
-		return false;
+		return _lastTime != 0 && (_lastTime - _lastViolationTime) < _minTimeWindow;
+	}
+
+	string Description() const
+	{
+		char buf[300];
+		sprintf_s(buf, 300, "ABS(%s-%s) < %s for %g-%g%% of the time",
+			_var.c_str(), MakeStringFromParamOrConst(_ref, _constRef).c_str(),
+			MakeStringFromParamOrConst(_sigma, _constSigma).c_str(), _threshMin, _threshMax);
+		return buf;
+	}
+
+	void ResolveFields(const std::vector<shared_ptr<DataSource> >& sources)
+	{
+		_varField = FindField(sources, _var);
+		_refField = _ref == "" ? DataField() : FindField(sources, _ref);
+		_sigmaField = _sigma == "" ? DataField() : FindField(sources, _sigma);
 	}
 
   void Update(double time, std::vector<shared_ptr<DataSource> >& sources)
   {
 		float tmp = 0;
-		if (!TryUpdate(sources, _var, tmp))
+		if (!_varField.Get(tmp))
 		{
 			return;
 		}
@@ -137,11 +146,11 @@ public:
 
 		if (_constRef == numeric_limits<float>::infinity())
 		{
-			TryUpdate(sources, _ref, _lastRefVal);
+			_refField.Get(_lastRefVal);
 		}
 		if (_constSigma == numeric_limits<float>::infinity())
 		{
-			TryUpdate(sources, _sigma, _lastSigmaVal);
+			_sigmaField.Get(_lastSigmaVal);
 		}
 
 		low.push(_lastRefVal - _lastSigmaVal);
@@ -168,56 +177,7 @@ public:
 
   // Draws horizontal threshold bands
   // and detection marker/time
-  void Draw(float minX, float maxX, float minY, float maxY)
-  {
-    glColor3f(.1f, .2f, .1f);
-
-		if (x.n_meas() < 2) return;
-
-		float g = 0.8f;
-		if ((_lastTime- _lastViolationTime) >= _minTimeWindow)
-		{
-			g = 1.f;
-			glColor3f(.2f, g, .2f);
-		}
-		else
-		{
-			glColor3f(.7f, .7f, .7f);
-		}
-
-		glBegin(GL_LINE_STRIP);
-		for (unsigned int i = 0; i < x.n_meas(); i++)
-		{
-			glVertex2f(x[i], CONSTRAIN(low[i],minY,maxY));
-		}
-		glEnd();
-		glBegin(GL_LINE_STRIP);
-		for (unsigned int i = 0; i < x.n_meas(); i++)
-		{
-			glVertex2f(x[i], CONSTRAIN(high[i],minY,maxY));
-		}
-		glEnd();
-
-		float per = (float)in / (float)(in + out)*100.f;
-
-		const float dx = maxX - minX;
-		const float dy = maxY - minY;
-		const float left = minX + dx*.1f;
-		const float bot = minY + dy / 2.f;
-
-		glColor4f(.8f, g, .8f, .8f);
-		glBegin(GL_QUADS);
-		glVertex2f(left -dx*.02f, bot-dy*.02f);
-		glVertex2f(left +dx*.07f, bot - dy * .02f);
-		glVertex2f(left +dx*.07f, bot+dy*.1f);
-		glVertex2f(left - dx * .02f, bot+dy*.1f);
-		glEnd();
-
-		glColor3f(.1f, .1f, .1f);
-		char buf[100];
-		sprintf_s(buf, 100, "%.0lf%%", per);
-		DrawStrokeText(buf, left, bot, 0, 1.2f, (maxX - minX) / 2.5f, (maxY - minY) / 2.5f *2.f);
-  }
+  void Draw(float minX, float maxX, float minY, float maxY);
 
   bool _active;
 
@@ -228,6 +188,7 @@ public:
 	float _lastViolationTime;
 
 	string _var, _ref, _sigma;
+	DataField _varField, _refField, _sigmaField;
 
 	// for each of these, if the value is inifinity, then it's a dynamic value that should be read from the datasource system
 	float _constSigma;
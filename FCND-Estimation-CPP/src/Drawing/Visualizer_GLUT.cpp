@@ -116,6 +116,7 @@ Visualizer_GLUT::Visualizer_GLUT(int *argcp, char **argv)
   initializeGL(argcp, argv);
   
   Reset();
+  AddFields();
 }
 
 Visualizer_GLUT::~Visualizer_GLUT()
@@ -559,9 +560,9 @@ void Visualizer_GLUT::VisualizeTrajectory(const Trajectory& traj, bool drawPoint
     glLineWidth(1.5);
     glColor4d(color[0], color[1], color[2], alpha);
     glBegin(GL_LINE_STRIP);
-    for (unsigned int i = 0; i < traj.traj.size(); i++)
+    for (unsigned int i = 0; i < traj.Points().size(); i++)
     {
-      glVertex3fv((traj.traj[i].position + offset).getArray());
+      glVertex3fv((traj.Points()[i].position + offset).getArray());
     }
     glEnd();
   }
@@ -574,15 +575,15 @@ void Visualizer_GLUT::VisualizeTrajectory(const Trajectory& traj, bool drawPoint
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     glDisable(GL_CULL_FACE);
     glBegin(GL_QUADS);
-    for (unsigned int i = 1; i < traj.traj.size(); i++)
+    for (unsigned int i = 1; i < traj.Points().size(); i++)
     {
-      V3F p = (traj.traj[i].position + offset);
-      V3F l = traj.traj[i].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
+      V3F p = (traj.Points()[i].position + offset);
+      V3F l = traj.Points()[i].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
       glVertex3fv((p+l).getArray());
       glVertex3fv((p-l).getArray());
         
-      p = (traj.traj[i-1].position + offset);
-      l = traj.traj[i-1].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
+      p = (traj.Points()[i-1].position + offset);
+      l = traj.Points()[i-1].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
       glVertex3fv((p - l).getArray());
       glVertex3fv((p + l).getArray());
     }
@@ -592,15 +593,15 @@ void Visualizer_GLUT::VisualizeTrajectory(const Trajectory& traj, bool drawPoint
 
     glColor4d(color[0], color[1], color[2], .1f);
     glBegin(GL_QUADS);
-    for (unsigned int i = 1; i < traj.traj.size(); i++)
+    for (unsigned int i = 1; i < traj.Points().size(); i++)
     {
-      V3F p = (traj.traj[i].position + offset);
-      V3F l = traj.traj[i].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
+      V3F p = (traj.Points()[i].position + offset);
+      V3F l = traj.Points()[i].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
       glVertex3fv((p + l).getArray());
       glVertex3fv((p - l).getArray());
 
-      p = (traj.traj[i - 1].position + offset);
-      l = traj.traj[i - 1].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
+      p = (traj.Points()[i - 1].position + offset);
+      l = traj.Points()[i - 1].attitude.Rotate_BtoI(V3F(0, 1, 0)) * 0.1f;
       glVertex3fv((p - l).getArray());
       glVertex3fv((p + l).getArray());
     }
@@ -610,9 +611,9 @@ void Visualizer_GLUT::VisualizeTrajectory(const Trajectory& traj, bool drawPoint
   if (drawPoints)
   {
     // Draw the desired trajectory points as spheres
-    for (unsigned int i = 0; i < traj.traj.size(); i++)
+    for (unsigned int i = 0; i < traj.Points().size(); i++)
     {
-      V3F pos = traj.traj[i].position + offset;
+      V3F pos = traj.Points()[i].position + offset;
       float r = 0.01f;
       // Draw the current trajectory point in a different colour
       if (i == (unsigned)traj.GetCurTrajectoryPoint())
@@ -873,29 +874,10 @@ void Visualizer_GLUT::OnMainTimer()
   _lastMainTimerEvent.Reset();
 }
 
-bool Visualizer_GLUT::GetData(const string& name, float& ret) const
+// Graphing variables, published once
+void Visualizer_GLUT::AddFields()
 {
-  if (name.find_first_of(".") == string::npos) return false;
-  string leftPart = LeftOf(name, '.');
-  string rightPart = RightOf(name, '.');
-  
-  if (ToUpper(leftPart) == "SIM")
-  {
-#define GETTER_HELPER(A,B) if (SLR::ToUpper(rightPart) == SLR::ToUpper(A)){ ret=(B); return true; }
-    // UDACITY CONVENTION
-    GETTER_HELPER("Draw_dt", _draw_dt_ms);
-    GETTER_HELPER("Update_dt", _timer_dt_ms);
-    GETTER_HELPER("DrawTime", _last_draw_time_ms);
-#undef GETTER_HELPER
-  }
-  return false;
-}
-
-vector<string> Visualizer_GLUT::GetFields() const
-{
-  vector<string> ret;
-  ret.push_back("Sim.Draw_dt");
-  ret.push_back("Sim.Update_dt");
-  ret.push_back("Sim.DrawTime");
-  return ret;
+  AddField("Sim.Draw_dt", &_draw_dt_ms);
+  AddField("Sim.Update_dt", &_timer_dt_ms);
+  AddField("Sim.DrawTime", &_last_draw_time_ms);
 }
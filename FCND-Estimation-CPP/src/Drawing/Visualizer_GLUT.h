@@ -107,8 +107,8 @@ public:
   bool paused;
 
    // data source functions
-   virtual bool GetData(const string& name, float& ret) const;
-   virtual vector<string> GetFields() const;
+   // publishes the graphing variables
+   void AddFields();
 
   void OnMainTimer();
 
@@ -35,19 +35,32 @@ public:
     _active = false;
   }
 
+  void ResolveFields(const std::vector<shared_ptr<DataSource> >& sources)
+  {
+    _field = FindField(sources, _var);
+  }
+
   void Update(double time, std::vector<shared_ptr<DataSource> >& sources)
   {
-    for (unsigned int j = 0; j < sources.size(); j++)
+    float tmp;
+    if (_field.Get(tmp))
     {
-      float tmp;
-      if (sources[j]->GetData(_var, tmp))
-      {
-        OnNewData((float)time, tmp);
-        break;
-      }
+      OnNewData((float)time, tmp);
     }
   }
 
+  bool Failed() const
+  {
+    return _lastTime != 0 && !_active;
+  }
+
+  string Description() const
+  {
+    char buf[200];
+    sprintf_s(buf, 200, "ABS(%s) < %g for %gs", _var.c_str(), _thresh, _minWindow);
+    return buf;
+  }
+
   void OnNewData(float time, float meas)
   {
     _lastTime = time;
@@ -71,68 +84,11 @@ public:
 
   // Draws horizontal threshold bands
   // and detection marker/time
-  void Draw(float minX, float maxX, float minY, float maxY)
-  {
-    glColor3f(.1f, .2f, .1f);
-
-    if (_thresh > minY && _thresh < maxY)
-    {
-      glBegin(GL_LINES);
-      glVertex2f(minX, _thresh);
-      glVertex2f(maxX, _thresh);
-      glEnd();
-    }
-
-    if ((-_thresh) > minY && (-_thresh) < maxY)
-    {
-      glBegin(GL_LINES);
-      glVertex2f(minX, -_thresh);
-      glVertex2f(maxX, -_thresh);
-      glEnd();
-    }
-
-    if (_lastTimeAboveThresh == numeric_limits<float>::infinity() || _lastTimeAboveThresh<minX || _lastTimeAboveThresh>maxX)
-    {
-      return;
-    }
-
-    if (_active)
-    {
-			float tmp = 0;
-			glGetFloatv(GL_LINE_WIDTH, &tmp);
-			glLineWidth(2);
-      glColor3f(0, 1, 0);
-      glBegin(GL_LINE_STRIP);
-      glVertex2f(_lastTimeAboveThresh, CONSTRAIN(_thresh,minY,maxY));
-      glVertex2f(_lastTime, CONSTRAIN(_thresh, minY, maxY));
-      glVertex2f(_lastTime, CONSTRAIN(-_thresh, minY, maxY));
-      glVertex2f(_lastTimeAboveThresh, CONSTRAIN(-_thresh, minY, maxY));
-      glVertex2f(_lastTimeAboveThresh, CONSTRAIN(_thresh, minY, maxY));
-      glEnd();
-			glLineWidth(tmp);
-    }
-    else
-    {
-      glColor3f(.7f, .1f, .1f);
-      if (_thresh > minY && _thresh < maxY)
-      {
-        glBegin(GL_LINES);
-        glVertex2f(minX, _thresh);
-        glVertex2f(maxX, _thresh);
-        glEnd();
-      }
-      if (-_thresh > minY && -_thresh < maxY)
-      {
-        glBegin(GL_LINES);
-        glVertex2f(minX, -_thresh);
-        glVertex2f(maxX, -_thresh);
-        glEnd();
-      }
-    }
-  }
+  void Draw(float minX, float maxX, float minY, float maxY);
 
   bool _active;
   string _var;
+  DataField _field;
   float _lastTimeAboveThresh;
   float _thresh, _minWindow;
   float _lastTime;
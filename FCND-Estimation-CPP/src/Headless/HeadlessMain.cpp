@@ -0,0 +1,281 @@
+// Headless batch runner: steps each scenario as fast as the CPU allows,
+// without a window or GLUT event loop, and reports the analyzer PASS/FAIL
+// results when Sim.EndTime is reached.
+// With --runs N every scenario is instead run as a Monte Carlo campaign of
+// N noise realizations (see MonteCarlo.h).
+// With --replay, a sensor recording (Sim.SensorRecordFile) is fed to the
+// estimator configured by each scenario instead, without simulating anything.
+// With --sweep, estimator parameter sets are ranked on sensor recordings (see ParameterSweep.h).
+// With --shards S, each scenario's vehicles are split over S worker processes (see ShardedRun.h).
+// With --save-snapshot and --snapshot, runs are saved at Sim.EndTime and continued from there
+// (see Simulator::SaveSnapshot), e.g. to branch a Monte Carlo campaign off one shared approach.
+//
+// usage: CPPEstSimHeadless [--runs N] [--threads T] [--snapshot F] [--save-snapshot F] <scenario.txt> [<scenario.txt> ...]
+//        CPPEstSimHeadless --replay <recording.bin> [--vehicle NAME] <scenario.txt> [<scenario.txt> ...]
+//        CPPEstSimHeadless --sweep <sweep.txt> [--threads T]
+//        CPPEstSimHeadless --shards S <scenario.txt> [<scenario.txt> ...]
+// exit code: 0 if every analyzer passed, 1 if any failed, 2 on setup errors
+
+#include "Common.h"
+#include "Utility/Timer.h"
+#include "Simulation/Simulator.h"
+#include "Utility/TelemetryLogger.h"
+#include "Utility/SimpleConfig.h"
+#include "Drawing/GraphManager.h"
+#include "ScenarioSetup.h"
+#include "MonteCarlo.h"
+#include "ParameterSweep.h"
+#include "ShardedRun.h"
+#include "Simulation/SensorRecording.h"
+#include "QuadEstimatorEKF.h"
+
+void PrintUsage();
+int RunScenario(const string& scenarioFile, const string& snapshotFile, const string& saveSnapshotFile);
+int RunReplay(const string& scenarioFile, const string& recordingFile, const string& vehicle);
+
+int main(int argc, char **argv)
+{
+  int numRuns = 0;
+  int numThreads = 0;
+  int numShards = 0;
+  string replayFile, replayVehicle = "Quad", sweepFile;
+  string snapshotFile, saveSnapshotFile;
+  vector<string> scenarios;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    if ((arg == "--runs" || arg == "--threads" || arg == "--shards") && i + 1 < argc)
+    {
+      int val = atoi(argv[++i]);
+      if (arg == "--runs") numRuns = val;
+      else if (arg == "--shards") numShards = val;
+      else numThreads = val;
+    }
+    else if (arg == "--replay" && i + 1 < argc)
+    {
+      replayFile = argv[++i];
+    }
+    else if (arg == "--vehicle" && i + 1 < argc)
+    {
+      replayVehicle = argv[++i];
+    }
+    else if (arg == "--sweep" && i + 1 < argc)
+    {
+      sweepFile = argv[++i];
+    }
+    else if (arg == "--snapshot" && i + 1 < argc)
+    {
+      snapshotFile = argv[++i];
+    }
+    else if (arg == "--save-snapshot" && i + 1 < argc)
+    {
+      saveSnapshotFile = argv[++i];
+    }
+    else if (arg.find("--") == 0)
+    {
+      PrintUsage();
+      return 2;
+    }
+    else
+    {
+      scenarios.push_back(arg);
+    }
+  }
+
+  if (sweepFile != "")
+  {
+    ParameterSweep sweep(sweepFile, numThreads);
+    return sweep.Run();
+  }
+
+  bool snapshots = snapshotFile != "" || saveSnapshotFile != "";
+  if (scenarios.empty() || (numShards > 0 && (numRuns > 0 || replayFile != ""))
+    || (snapshots && (numShards > 0 || replayFile != "")) || (saveSnapshotFile != "" && numRuns > 0))
+  {
+    PrintUsage();
+    return 2;
+  }
+
+  int ret = 0;
+  for (unsigned int i = 0; i < scenarios.size(); i++)
+  {
+    int result;
+    if (replayFile != "")
+    {
+      result = RunReplay(scenarios[i], replayFile, replayVehicle);
+    }
+    else if (numRuns > 0)
+    {
+      MonteCarloCampaign campaign(scenarios[i], numRuns, numThreads, snapshotFile);
+      result = campaign.Run();
+    }
+    else if (numShards > 0)
+    {
+      ShardedRun run(scenarios[i], numShards);
+      result = run.Run();
+    }
+    else
+    {
+      result = RunScenario(scenarios[i], snapshotFile, saveSnapshotFile);
+    }
+    ret = MAX(ret, result);
+  }
+
+  return ret;
+}
+
+int RunScenario(const string& scenarioFile, const string& snapshotFile, const string& saveSnapshotFile)
+{
+  shared_ptr<Simulator> simulator(new Simulator());
+  shared_ptr<GraphManager> grapher(new GraphManager(false));
+
+  simulator->LoadScenario(scenarioFile);
+  string sensorRecordFile = SLR::SimpleConfig::GetInstance()->Get("Sim.SensorRecordFile", "");
+  if (sensorRecordFile != "")
+  {
+    simulator->_sensorRecordFile = "../config/" + sensorRecordFile;
+  }
+  simulator->Reset();
+
+  if (simulator->_vehicles.empty())
+  {
+    SLR_ERROR1("Scenario %s defines no vehicles", scenarioFile.c_str());
+    return 2;
+  }
+  if (simulator->_endTime <= 0)
+  {
+    SLR_ERROR1("Scenario %s has no positive Sim.EndTime, refusing to run forever", scenarioFile.c_str());
+    return 2;
+  }
+
+  if (snapshotFile != "")
+  {
+    SLR::StateBuffer snapshot;
+    if (!snapshot.Load(snapshotFile))
+    {
+      SLR_ERROR1("Can't read snapshot %s", snapshotFile.c_str());
+      return 2;
+    }
+    Timer restoreTime;
+    if (!simulator->RestoreSnapshot(snapshot))
+    {
+      SLR_ERROR2("Snapshot %s doesn't fit scenario %s", snapshotFile.c_str(), scenarioFile.c_str());
+      return 2;
+    }
+    printf("Restored %s at %.3lfs in %.1lfus\n", snapshotFile.c_str(), (double)simulator->_simTime, restoreTime.ElapsedSeconds() * 1e6);
+  }
+
+  RegisterDataSources(grapher, simulator->_vehicles);
+  ProcessConfigCommands(grapher);
+
+  ParamsHandle config = SLR::SimpleConfig::GetInstance();
+  string dataLogFile = config->Get("Sim.DataLogFile", "");
+  if (dataLogFile != "")
+  {
+    grapher->BeginDataLog("../config/" + dataLogFile, config->Get("Sim.DataLogDecimation", 1));
+  }
+
+  // the logger writes on its own thread and is stopped (and flushed) when it goes out of scope
+  shared_ptr<SLR::TelemetryLogger> telemetryLogger;
+  string telemetryFile = config->Get("Sim.TelemetryLogFile", "");
+  if (telemetryFile != "")
+  {
+    simulator->_telemetry.reset(new SLR::TelemetryBus());
+    telemetryLogger.reset(new SLR::TelemetryLogger(simulator->_telemetry, "../config/" + telemetryFile));
+  }
+
+  Timer wallTime;
+  while (!simulator->EndTimeReached())
+  {
+    simulator->RunSteps(NUM_SIM_STEPS_PER_FRAME);
+    grapher->UpdateData(simulator->_simTime);
+  }
+
+  int numFailed = CountFailedAnalyzers(grapher->graph1) + CountFailedAnalyzers(grapher->graph2);
+
+  if (saveSnapshotFile != "")
+  {
+    SLR::StateBuffer snapshot;
+    simulator->SaveSnapshot(snapshot);
+    if (!snapshot.Save(saveSnapshotFile))
+    {
+      SLR_ERROR1("Can't write snapshot %s", saveSnapshotFile.c_str());
+      return 2;
+    }
+  }
+
+  // resetting the analyzers prints their PASS/FAIL verdicts
+  grapher->Clear();
+
+  printf("Simulated %.3lfs in %.3lfs wall time (%.1lfx real time)\n",
+    (double)simulator->_simTime, wallTime.ElapsedSeconds(),
+    (double)simulator->_simTime / MAX(wallTime.ElapsedSeconds(), 1e-6));
+
+  return numFailed > 0 ? 1 : 0;
+}
+
+int RunReplay(const string& scenarioFile, const string& recordingFile, const string& vehicle)
+{
+  SensorRecording recording;
+  if (!recording.Load(recordingFile))
+  {
+    return 2;
+  }
+
+  ParamsHandle config = SLR::SimpleConfig::GetInstance();
+  config->Reset(scenarioFile);
+  QuadEstimatorEKF estimator(config->Get(vehicle + ".Estimator", "QuadEstimatorEKF"), vehicle);
+
+  // RMS of the estimate's error against the recorded true state
+  double sumPos = 0, sumVel = 0, sumYaw = 0;
+  int numTruth = 0;
+
+  Timer wallTime;
+  recording.Replay(estimator, [&](const SensorEvent& e)
+  {
+    if (e.type != SENSOR_TRUTH) return;
+    sumPos += estimator.posErrorMag * estimator.posErrorMag;
+    sumVel += estimator.velErrorMag * estimator.velErrorMag;
+    sumYaw += estimator.trueError(6) * estimator.trueError(6);
+    numTruth++;
+  });
+  double wall = wallTime.ElapsedSeconds();
+
+  numTruth = MAX(numTruth, 1);
+  printf("Replayed %s (%d events, %.3lfs) through %s in %.4lfs wall time (%.0lfx real time)\n",
+    recordingFile.c_str(), (int)recording.Events().size(), recording.Duration(), scenarioFile.c_str(),
+    wall, recording.Duration() / MAX(wall, 1e-6));
+  printf("RMS error: position %f, velocity %f, yaw %f\n",
+    sqrt(sumPos / numTruth), sqrt(sumVel / numTruth), sqrt(sumYaw / numTruth));
+  V3F pos = estimator.EstimatedPosition(), vel = estimator.EstimatedVelocity();
+  printf("Final estimate: pos %f %f %f, vel %f %f %f, yaw %f\n",
+    pos.x, pos.y, pos.z, vel.x, vel.y, vel.z, estimator.ekfState(6));
+
+  return 0;
+}
+
+void PrintUsage()
+{
+  printf("HEADLESS SIMULATOR\n");
+  printf("usage: CPPEstSimHeadless [--runs N] [--threads T] [--snapshot F] [--save-snapshot F] <scenario.txt> [<scenario.txt> ...]\n");
+  printf("       CPPEstSimHeadless --replay <recording.bin> [--vehicle NAME] <scenario.txt> [<scenario.txt> ...]\n");
+  printf("       CPPEstSimHeadless --sweep <sweep.txt> [--threads T]\n");
+  printf("       CPPEstSimHeadless --shards S <scenario.txt> [<scenario.txt> ...]\n");
+  printf("Runs each scenario once until Sim.EndTime and prints the analyzer results.\n");
+  printf("  --runs N     run each scenario as a Monte Carlo campaign of N noise realizations,\n");
+  printf("               starting at Sim.RunNumber, and print aggregated results instead\n");
+  printf("  --threads T  worker threads for --runs and --sweep (default: one per core)\n");
+  printf("  --replay F   feed the sensor recording F (see Sim.SensorRecordFile) to the estimator\n");
+  printf("               configured by each scenario for vehicle NAME (default Quad), and print\n");
+  printf("               its RMS error. No dynamics or control are simulated\n");
+  printf("  --sweep S    replay the recordings listed by sweep file S through every estimator\n");
+  printf("               parameter set it describes and rank the sets (see config/X_EstimatorSweep.txt)\n");
+  printf("  --shards S   split each scenario's vehicles over S worker processes stepped in lockstep,\n");
+  printf("               and print each process' analyzer results. A process that dies only drops\n");
+  printf("               its own vehicles\n");
+  printf("  --save-snapshot F  save the whole simulation state at Sim.EndTime to F\n");
+  printf("  --snapshot F       continue from the snapshot F of the same vehicles instead of starting\n");
+  printf("               over. Each --runs realization branches off it with its own noise\n");
+  printf("Run from the build directory so that ../config/ resolves like the GUI simulator.\n");
+}
@@ -0,0 +1,281 @@
+#include "Common.h"
+#include "MonteCarlo.h"
+#include "ScenarioSetup.h"
+#include "Utility/SimpleConfig.h"
+#include "Utility/StringUtils.h"
+#include "Utility/Timer.h"
+#include "Utility/WorkerPool.h"
+#include "BaseQuadEstimator.h"
+#include "Drawing/BaseAnalyzer.h"
+#include <algorithm>
+
+using namespace SLR;
+
+namespace
+{
+  // nearest-rank percentile of sorted values, p in [0,100]
+  float Percentile(const vector<float>& sorted, float p)
+  {
+    if (sorted.empty()) return 0;
+    int rank = (int)ceilf(p / 100.f * (float)sorted.size());
+    return sorted[CONSTRAIN(rank - 1, 0, (int)sorted.size() - 1)];
+  }
+
+  // mean, median, 95th percentile and max of vals
+  void PrintStats(vector<float> vals)
+  {
+    std::sort(vals.begin(), vals.end());
+    double sum = 0;
+    for (unsigned int i = 0; i < vals.size(); i++)
+    {
+      sum += vals[i];
+    }
+    printf(" %10.4f %10.4f %10.4f %10.4f", sum / MAX((double)vals.size(), 1.0),
+      Percentile(vals, 50), Percentile(vals, 95), vals.empty() ? 0.f : vals.back());
+  }
+
+  // one Est.E.* field of one vehicle, accumulated over a run
+  struct ErrorTrack
+  {
+    DataField field;
+    string key;
+    double sumSq;
+    float maxAbs;
+    int n;
+  };
+}
+
+MonteCarloCampaign::MonteCarloCampaign(const string& scenarioFile, int numRuns, int numThreads, const string& snapshotFile)
+  : _scenarioFile(scenarioFile), _snapshotFile(snapshotFile), _numRuns(numRuns), _numThreads(numThreads)
+{
+}
+
+int MonteCarloCampaign::Run()
+{
+  if (_numRuns < 1)
+  {
+    SLR_ERROR0("A campaign needs at least one run");
+    return 2;
+  }
+
+  // check the scenario once up front, and find out which realization to start from
+  int firstRun;
+  {
+    Simulator sim;
+    sim.LoadScenario(_scenarioFile);
+    sim.Reset();
+    if (sim._vehicles.empty())
+    {
+      SLR_ERROR1("Scenario %s defines no vehicles", _scenarioFile.c_str());
+      return 2;
+    }
+    if (sim._endTime <= 0)
+    {
+      SLR_ERROR1("Scenario %s has no positive Sim.EndTime, refusing to run forever", _scenarioFile.c_str());
+      return 2;
+    }
+    firstRun = sim._runNumber;
+
+    if (_snapshotFile != "")
+    {
+      if (!_snapshot.Load(_snapshotFile))
+      {
+        SLR_ERROR1("Can't read snapshot %s", _snapshotFile.c_str());
+        return 2;
+      }
+      if (!sim.RestoreSnapshot(_snapshot))
+      {
+        SLR_ERROR2("Snapshot %s doesn't fit scenario %s", _snapshotFile.c_str(), _scenarioFile.c_str());
+        return 2;
+      }
+    }
+  }
+
+  _results.assign(_numRuns, RunResult());
+  for (int i = 0; i < _numRuns; i++)
+  {
+    _results[i].runNumber = firstRun + i;
+  }
+
+  Timer wallTime;
+  WorkerPool pool(_numThreads);
+  _numThreads = MIN(pool.NumThreads(), _numRuns);
+  pool.Run(_numThreads, [this](int i) { WorkerTask(i); });
+
+  return PrintReport(wallTime.ElapsedSeconds());
+}
+
+void MonteCarloCampaign::WorkerTask(int threadIndex)
+{
+  shared_ptr<Simulator> sim(new Simulator());
+  shared_ptr<GraphManager> grapher(new GraphManager(false));
+  {
+    std::lock_guard<std::mutex> lock(_setupMutex);
+    sim->LoadScenario(_scenarioFile);
+  }
+
+  // restoring reads through a buffer, so every worker needs its own
+  StateBuffer snapshot(_snapshot);
+
+  // static assignment, so which worker ran a run can't influence its result
+  for (int i = threadIndex; i < _numRuns; i += _numThreads)
+  {
+    RunOne(_results[i].runNumber, sim, grapher, snapshot, _results[i]);
+  }
+}
+
+void MonteCarloCampaign::RunOne(int runNumber, shared_ptr<Simulator> sim, shared_ptr<GraphManager> grapher, StateBuffer& snapshot, RunResult& res)
+{
+  {
+    std::lock_guard<std::mutex> lock(_setupMutex);
+    sim->Reset(runNumber);
+    // checked to fit in Run()
+    if (snapshot.Size() > 0)
+    {
+      sim->RestoreSnapshot(snapshot, true);
+    }
+    // the campaign already keeps every core busy with whole runs
+    sim->_numThreads = 1;
+
+    grapher->graph1->RemoveAllElements();
+    grapher->graph2->RemoveAllElements();
+    grapher->Reset();
+    RegisterDataSources(grapher, sim->_vehicles);
+    ProcessConfigCommands(grapher, false);
+  }
+
+  vector<ErrorTrack> errors;
+  for (unsigned int i = 0; i < sim->_vehicles.size(); i++)
+  {
+    shared_ptr<BaseQuadEstimator> est = sim->_vehicles[i]->estimator;
+    if (!est) continue;
+    vector<string> fields = est->GetFields();
+    for (unsigned int j = 0; j < fields.size(); j++)
+    {
+      if (fields[j].find(".Est.E.") == string::npos) continue;
+      ErrorTrack t;
+      t.field = est->FindField(fields[j]);
+      t.key = RightOf(fields[j], '.');
+      t.sumSq = 0;
+      t.maxAbs = 0;
+      t.n = 0;
+      errors.push_back(t);
+    }
+  }
+
+  while (!sim->EndTimeReached())
+  {
+    sim->RunSteps(NUM_SIM_STEPS_PER_FRAME);
+
+    for (unsigned int i = 0; i < errors.size(); i++)
+    {
+      float val;
+      if (errors[i].field.Get(val))
+      {
+        errors[i].sumSq += (double)val * val;
+        errors[i].maxAbs = MAX(errors[i].maxAbs, fabsf(val));
+        errors[i].n++;
+      }
+    }
+
+    grapher->UpdateData(sim->_simTime);
+  }
+
+  shared_ptr<Graph> graphs[2] = { grapher->graph1, grapher->graph2 };
+  for (int g = 0; g < 2; g++)
+  {
+    for (unsigned int i = 0; i < graphs[g]->_analyzers.size(); i++)
+    {
+      string desc = graphs[g]->_analyzers[i]->Description();
+      if (desc == "") continue;
+      res.analyzers.push_back(desc);
+      res.analyzerFailed.push_back(graphs[g]->_analyzers[i]->Failed());
+    }
+  }
+
+  for (unsigned int i = 0; i < errors.size(); i++)
+  {
+    if (errors[i].n == 0) continue;
+    res.errorRMS[errors[i].key].push_back((float)sqrt(errors[i].sumSq / errors[i].n));
+    res.errorMax[errors[i].key].push_back(errors[i].maxAbs);
+  }
+}
+
+int MonteCarloCampaign::PrintReport(double wallTime)
+{
+  printf("\nMONTE CARLO CAMPAIGN: %s\n", _scenarioFile.c_str());
+  printf("%d runs (RunNumber %d..%d) on %d threads, %.3lfs wall time\n",
+    _numRuns, _results[0].runNumber, _results[_numRuns - 1].runNumber, _numThreads, wallTime);
+
+  int numFailedRuns = 0;
+  const vector<string>& analyzers = _results[0].analyzers;
+  vector<vector<int> > failedRuns(analyzers.size());
+  map<string, vector<float> > rms, maxErr;
+
+  for (int r = 0; r < _numRuns; r++)
+  {
+    const RunResult& res = _results[r];
+    if (res.analyzers != analyzers)
+    {
+      SLR_WARNING1("Run %d set up different analyzers than the first run, skipping it", res.runNumber);
+      continue;
+    }
+
+    bool anyFailed = false;
+    for (unsigned int i = 0; i < res.analyzerFailed.size(); i++)
+    {
+      if (res.analyzerFailed[i])
+      {
+        failedRuns[i].push_back(res.runNumber);
+        anyFailed = true;
+      }
+    }
+    if (anyFailed) numFailedRuns++;
+
+    for (auto i = res.errorRMS.begin(); i != res.errorRMS.end(); i++)
+    {
+      rms[i->first].insert(rms[i->first].end(), i->second.begin(), i->second.end());
+    }
+    for (auto i = res.errorMax.begin(); i != res.errorMax.end(); i++)
+    {
+      maxErr[i->first].insert(maxErr[i->first].end(), i->second.begin(), i->second.end());
+    }
+  }
+
+  printf("\nANALYZERS\n");
+  if (analyzers.empty())
+  {
+    printf("  (scenario has no pass/fail analyzers)\n");
+  }
+  for (unsigned int i = 0; i < analyzers.size(); i++)
+  {
+    int numPassed = _numRuns - (int)failedRuns[i].size();
+    printf("%4d/%d PASS (%5.1lf%%): %s\n", numPassed, _numRuns, 100.0 * numPassed / _numRuns, analyzers[i].c_str());
+    if (!failedRuns[i].empty())
+    {
+      printf("      failed runs:");
+      for (unsigned int j = 0; j < failedRuns[i].size() && j < 20; j++)
+      {
+        printf(" %d", failedRuns[i][j]);
+      }
+      printf(failedRuns[i].size() > 20 ? " ...\n" : "\n");
+    }
+  }
+
+  if (!rms.empty())
+  {
+    printf("\nESTIMATION ERRORS (per vehicle and run: RMS and max ABS over time)\n");
+    printf("%-14s %10s %10s %10s %10s %10s %10s %10s %10s\n", "",
+      "RMS mean", "RMS p50", "RMS p95", "RMS max", "MAX mean", "MAX p50", "MAX p95", "MAX max");
+    for (auto i = rms.begin(); i != rms.end(); i++)
+    {
+      printf("%-14s", i->first.c_str());
+      PrintStats(i->second);
+      PrintStats(maxErr[i->first]);
+      printf("\n");
+    }
+  }
+
+  printf("\n%d of %d runs failed\n", numFailedRuns, _numRuns);
+  return numFailedRuns > 0 ? 1 : 0;
+}
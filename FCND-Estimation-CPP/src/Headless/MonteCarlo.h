@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Common.h"
+#include "Simulation/Simulator.h"
+#include "Drawing/GraphManager.h"
+#include <vector>
+#include <map>
+#include <mutex>
+
+// Monte Carlo campaign: runs one scenario numRuns times with consecutive
+// noise realizations (Sim.RunNumber, Sim.RunNumber+1, ...) spread over the
+// cores, then reports how often each pass/fail analyzer failed and the
+// spread of every Est.E.* estimation error across the runs.
+// Graph logging (LogToFile) is disabled, the runs would overwrite each other's logs.
+// With a snapshot file, every run starts from the snapshot with its own noise, so
+// the campaign only covers what happens after it.
+class MonteCarloCampaign
+{
+public:
+  // numThreads = 0 uses one thread per core
+  MonteCarloCampaign(const string& scenarioFile, int numRuns, int numThreads = 0, const string& snapshotFile = "");
+
+  // runs the campaign and prints the report.
+  // returns 0 if every run passed, 1 if any analyzer failed in any run, 2 on setup errors
+  int Run();
+
+protected:
+  struct RunResult
+  {
+    RunResult() : runNumber(0) {}
+    int runNumber;
+    vector<string> analyzers;      // descriptions of the pass/fail analyzers, graph1 then graph2
+    vector<bool> analyzerFailed;
+    // per Est.E.* field (vehicle name stripped), one entry per vehicle
+    map<string, vector<float> > errorRMS, errorMax;
+  };
+
+  void WorkerTask(int threadIndex);
+  void RunOne(int runNumber, shared_ptr<Simulator> sim, shared_ptr<GraphManager> grapher, SLR::StateBuffer& snapshot, RunResult& res);
+  int PrintReport(double wallTime);
+
+  string _scenarioFile, _snapshotFile;
+  int _numRuns, _numThreads;
+  SLR::StateBuffer _snapshot; // empty without a snapshot file
+  vector<RunResult> _results;
+
+  // the config is a process-wide singleton and vehicles read it while they're
+  // (re)initialized, so only one worker may set up a run at a time.
+  // stepping doesn't touch the config and runs unlocked
+  std::mutex _setupMutex;
+};
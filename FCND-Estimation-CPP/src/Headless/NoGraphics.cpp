@@ -0,0 +1,27 @@
+#include "Common.h"
+#include "Drawing/Graph.h"
+#include "Drawing/GraphManager.h"
+#include "Drawing/AbsThreshold.h"
+#include "Drawing/WindowThreshold.h"
+#include "Drawing/SigmaThreshold.h"
+
+// stands in for Drawing/GraphDrawing.cpp in the headless runner, which never opens a
+// window, so it builds and runs without OpenGL or GLUT
+
+void GraphManager::OpenWindow()
+{
+  SLR_WARNING0("No graph window without OpenGL");
+  _ownWindow = false;
+}
+
+void GraphManager::CloseWindow() {}
+void GraphManager::DrawUpdate() {}
+void GraphManager::InitPaint() {}
+void GraphManager::Paint() {}
+
+void Graph::Draw() {}
+void Graph::DrawSeries(Series& s) {}
+
+void AbsThreshold::Draw(float minX, float maxX, float minY, float maxY) {}
+void WindowThreshold::Draw(float minX, float maxX, float minY, float maxY) {}
+void SigmaThreshold::Draw(float minX, float maxX, float minY, float maxY) {}
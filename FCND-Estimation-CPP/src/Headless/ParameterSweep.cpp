@@ -0,0 +1,246 @@
+#include "Common.h"
+#include "ParameterSweep.h"
+#include "QuadEstimatorEKF.h"
+#include "Utility/SimpleConfig.h"
+#include "Utility/StringUtils.h"
+#include "Utility/Timer.h"
+#include "Utility/WorkerPool.h"
+#include "Math/Random.h"
+#include <algorithm>
+#include <limits>
+
+using namespace SLR;
+
+ParameterSweep::ParameterSweep(const string& sweepFile, int numThreads)
+  : _sweepFile(sweepFile), _numThreads(numThreads)
+{
+  _top = 10;
+}
+
+int ParameterSweep::Run()
+{
+  if (!ReadSpec())
+  {
+    return 2;
+  }
+
+  for (unsigned int i = 0; i < _recordingFiles.size(); i++)
+  {
+    shared_ptr<SensorRecording> rec(new SensorRecording());
+    if (!rec->Load(_recordingFiles[i]))
+    {
+      return 2;
+    }
+    _recordings.push_back(rec);
+  }
+
+  MakeParameterSets();
+  if (_results.empty())
+  {
+    SLR_ERROR1("Sweep %s has no parameter sets to try", _sweepFile.c_str());
+    return 2;
+  }
+
+  ParamsHandle config = SimpleConfig::GetInstance();
+  for (unsigned int i = 0; i < _params.size(); i++)
+  {
+    _configured.values.push_back(config->Get(_estimatorConfig + "." + _params[i].name, 0.f));
+  }
+  Evaluate(_configured);
+
+  Timer wallTime;
+  WorkerPool pool(_numThreads);
+  _numThreads = pool.NumThreads();
+  pool.Run((int)_results.size(), [this](int i) { Evaluate(_results[i]); });
+
+  PrintReport(wallTime.ElapsedSeconds());
+  return 0;
+}
+
+bool ParameterSweep::ReadSpec()
+{
+  ParamsHandle config = SimpleConfig::GetInstance();
+  config->Reset(_sweepFile);
+
+  vector<string> files = Split(config->Get("Sweep.Recordings", ""), ',');
+  for (unsigned int i = 0; i < files.size(); i++)
+  {
+    string f = Trim(files[i]);
+    if (f != "") _recordingFiles.push_back("../config/" + f);
+  }
+  if (_recordingFiles.empty())
+  {
+    SLR_ERROR1("Sweep %s lists no Sweep.Recordings", _sweepFile.c_str());
+    return false;
+  }
+
+  _estimatorConfig = config->Get("Sweep.Estimator", "QuadEstimatorEKF");
+  _rankBy = ToUpper(config->Get("Sweep.RankBy", "Pos"));
+  _top = (int)config->Get("Sweep.Top", 10);
+  if (_rankBy != "POS" && _rankBy != "VEL" && _rankBy != "YAW" && _rankBy != "NEES")
+  {
+    SLR_WARNING1("Unknown Sweep.RankBy %s, ranking by Pos", _rankBy.c_str());
+    _rankBy = "POS";
+  }
+
+  bool random = ToUpper(config->Get("Sweep.Mode", "Grid")) == "RANDOM";
+  for (int i = 1; ; i++)
+  {
+    char buf[100];
+    sprintf_s(buf, 100, "Sweep.Param%d", i);
+    string spec = config->Get(buf, "");
+    if (spec == "") break;
+
+    vector<string> args = Split(spec, ',');
+    Param p;
+    p.name = Trim(args[0]);
+    for (unsigned int j = 1; j < args.size(); j++)
+    {
+      p.values.push_back((float)atof(args[j].c_str()));
+    }
+
+    bool known = false;
+    for (int j = 0; j < QuadEstimatorEKF::NUM_NOISE_PARAMS; j++)
+    {
+      known = known || ToUpper(p.name) == ToUpper(QuadEstimatorEKF::NOISE_PARAMS[j]);
+    }
+    if (!known || p.values.empty() || (random && p.values.size() != 2))
+    {
+      SLR_ERROR2("Malformed %s (%s)", buf, spec.c_str());
+      return false;
+    }
+    _params.push_back(p);
+  }
+
+  return true;
+}
+
+void ParameterSweep::MakeParameterSets()
+{
+  ParamsHandle config = SimpleConfig::GetInstance();
+  _results.clear();
+
+  if (ToUpper(config->Get("Sweep.Mode", "Grid")) == "RANDOM")
+  {
+    // log-uniform between min and max, for std deviations spanning orders of magnitude
+    RandomStream rng((uint64_t)config->Get("Sweep.Seed", 0));
+    int numSamples = (int)config->Get("Sweep.NumSamples", 100);
+    for (int s = 0; s < numSamples; s++)
+    {
+      Result res;
+      for (unsigned int i = 0; i < _params.size(); i++)
+      {
+        float lo = _params[i].values[0], hi = _params[i].values[1];
+        float u = rng.Uniform();
+        res.values.push_back(lo > 0 && hi > 0 ? lo * powf(hi / lo, u) : lo + (hi - lo) * u);
+      }
+      _results.push_back(res);
+    }
+    return;
+  }
+
+  // every combination, the last parameter varying fastest
+  size_t numSets = 1;
+  for (unsigned int i = 0; i < _params.size(); i++)
+  {
+    numSets *= _params[i].values.size();
+  }
+  for (size_t s = 0; s < numSets; s++)
+  {
+    Result res;
+    res.values.resize(_params.size());
+    size_t rest = s;
+    for (int i = (int)_params.size() - 1; i >= 0; i--)
+    {
+      res.values[i] = _params[i].values[rest % _params[i].values.size()];
+      rest /= _params[i].values.size();
+    }
+    _results.push_back(res);
+  }
+}
+
+void ParameterSweep::Evaluate(Result& res)
+{
+  double sumPos = 0, sumVel = 0, sumYaw = 0, sumNEES = 0;
+  int n = 0;
+
+  for (unsigned int r = 0; r < _recordings.size(); r++)
+  {
+    shared_ptr<QuadEstimatorEKF> est;
+    {
+      std::lock_guard<std::mutex> lock(_setupMutex);
+      est.reset(new QuadEstimatorEKF(_estimatorConfig, "Sweep"));
+    }
+    for (unsigned int i = 0; i < _params.size(); i++)
+    {
+      est->SetNoiseParam(_params[i].name, res.values[i]);
+    }
+
+    _recordings[r]->Replay(*est, [&](const SensorEvent& e)
+    {
+      if (e.type != SENSOR_TRUTH) return;
+      const QuadEstimatorEKF::StateVector& err = est->trueError;
+      sumPos += est->posErrorMag * est->posErrorMag;
+      sumVel += est->velErrorMag * est->velErrorMag;
+      sumYaw += err(6) * err(6);
+      sumNEES += err.dot(est->ekfCov.ldlt().solve(err));
+      n++;
+    });
+  }
+
+  n = MAX(n, 1);
+  res.rmsPos = sqrt(sumPos / n);
+  res.rmsVel = sqrt(sumVel / n);
+  res.rmsYaw = sqrt(sumYaw / n);
+  res.meanNEES = sumNEES / n;
+
+  if (_rankBy == "VEL") res.score = res.rmsVel;
+  else if (_rankBy == "YAW") res.score = res.rmsYaw;
+  // a consistent filter's mean NEES is the number of states; too low is as bad as too high
+  else if (_rankBy == "NEES") res.score = fabs(log(res.meanNEES / QuadEstimatorEKF::QUAD_EKF_NUM_STATES));
+  else res.score = res.rmsPos;
+
+  // diverged
+  if (!(res.score == res.score) || !(res.meanNEES == res.meanNEES))
+  {
+    res.score = std::numeric_limits<double>::infinity();
+  }
+}
+
+void ParameterSweep::PrintReport(double wallTime)
+{
+  std::stable_sort(_results.begin(), _results.end(),
+    [](const Result& a, const Result& b) { return a.score < b.score; });
+
+  double recorded = 0;
+  for (unsigned int i = 0; i < _recordings.size(); i++)
+  {
+    recorded += _recordings[i]->Duration();
+  }
+
+  printf("\nESTIMATOR PARAMETER SWEEP: %s\n", _sweepFile.c_str());
+  printf("%d parameter sets x %d recordings (%.1lfs) on %d threads, %.3lfs wall time (%.0lf replays/s)\n",
+    (int)_results.size(), (int)_recordings.size(), recorded, _numThreads, wallTime,
+    _results.size() * _recordings.size() / MAX(wallTime, 1e-6));
+  printf("ranked by %s, mean NEES of a consistent filter = %d\n\n", _rankBy.c_str(), QuadEstimatorEKF::QUAD_EKF_NUM_STATES);
+
+  printf("%4s %10s %10s %10s %10s", "rank", "RMS pos", "RMS vel", "RMS yaw", "mean NEES");
+  for (unsigned int i = 0; i < _params.size(); i++)
+  {
+    printf(" %12s", _params[i].name.c_str());
+  }
+  printf("\n");
+
+  for (int r = -1; r < (int)_results.size() && r < _top; r++)
+  {
+    const Result& res = r < 0 ? _configured : _results[r];
+    if (r < 0) printf("%4s", "cfg");
+    else printf("%4d", r + 1);
+    printf(" %10.4f %10.4f %10.4f %10.2f", res.rmsPos, res.rmsVel, res.rmsYaw, res.meanNEES);
+    for (unsigned int i = 0; i < res.values.size(); i++)
+    {
+      printf(" %12.4g", res.values[i]);
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Common.h"
+#include "Simulation/SensorRecording.h"
+#include <vector>
+#include <mutex>
+
+// Estimator parameter sweep: replays sensor recordings (see SensorRecording.h)
+// through one QuadEstimatorEKF per parameter set, spread over the cores, and
+// ranks the sets by the estimate's error against the recorded true state and
+// by how consistent the estimator's covariance is with that error (NEES).
+// The sweep is described by a config file, see config/X_EstimatorSweep.txt
+class ParameterSweep
+{
+public:
+  // numThreads = 0 uses one thread per core
+  ParameterSweep(const string& sweepFile, int numThreads = 0);
+
+  // runs the sweep and prints the ranking.
+  // returns 0 on success, 2 on setup errors
+  int Run();
+
+protected:
+  struct Param
+  {
+    string name;
+    vector<float> values; // Grid: the values to try, Random: min and max
+  };
+
+  struct Result
+  {
+    Result() : rmsPos(0), rmsVel(0), rmsYaw(0), meanNEES(0), score(0) {}
+    vector<float> values; // per Param
+    // over all truth samples of all recordings
+    double rmsPos, rmsVel, rmsYaw;
+    // mean normalized estimation error squared, err' * inv(cov) * err.
+    // the number of states for a consistent filter
+    double meanNEES;
+    double score; // by RankBy, lower is better
+  };
+
+  bool ReadSpec();
+  void MakeParameterSets();
+  void Evaluate(Result& res);
+  void PrintReport(double wallTime);
+
+  string _sweepFile, _estimatorConfig, _rankBy;
+  int _numThreads, _top;
+  vector<Param> _params;
+  vector<shared_ptr<SensorRecording> > _recordings;
+  vector<string> _recordingFiles;
+  vector<Result> _results;
+  Result _configured; // the parameters as the estimator config sets them, for reference
+
+  // estimators read the (process-wide) config while they're created
+  std::mutex _setupMutex;
+};
@@ -0,0 +1,83 @@
+#include "Common.h"
+#include "ScenarioSetup.h"
+#include "Utility/SimpleConfig.h"
+#include "BaseQuadEstimator.h"
+#include "Simulation/SimulatedQuadSensor.h"
+#include "Drawing/BaseAnalyzer.h"
+
+namespace
+{
+  // whether cmd names a field of the vehicle called name, as in AddGraph1.<name>.x
+  // or AddGraph1.WindowThreshold(<name>.x,...)
+  bool NamesVehicle(const string& cmd, const string& name)
+  {
+    string key = name + ".";
+    for (size_t pos = cmd.find(key); pos != string::npos; pos = cmd.find(key, pos + 1))
+    {
+      if (pos == 0 || cmd[pos - 1] == '.' || cmd[pos - 1] == '(' || cmd[pos - 1] == ',' || cmd[pos - 1] == ' ')
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+}
+
+void RegisterDataSources(shared_ptr<GraphManager> grapher, const vector<QuadcopterHandle>& quads)
+{
+  grapher->_sources.clear();
+  for (auto i = quads.begin(); i != quads.end(); i++)
+  {
+    grapher->RegisterDataSource(*i);
+    grapher->RegisterDataSources((*i)->sensors);
+    grapher->RegisterDataSource((*i)->estimator);
+    grapher->RegisterDataSource((*i)->controller);
+  }
+}
+
+void ProcessConfigCommands(shared_ptr<GraphManager> grapher, bool allowLogToFile, const vector<string>& skipVehicles)
+{
+  ParamsHandle config = SimpleConfig::GetInstance();
+  int i = 1;
+  while (1)
+  {
+    char buf[100];
+    sprintf_s(buf, 100, "Commands.%d", i);
+    string cmd = config->Get(buf, "");
+    if (cmd == "") break;
+    i++;
+
+    // visualization-only commands have no meaning without a window
+    if (cmd.find("Toggle.") == 0 || cmd.find("Scenario.") != string::npos)
+    {
+      continue;
+    }
+    if (!allowLogToFile && cmd.find("LogToFile") != string::npos)
+    {
+      continue;
+    }
+    bool skip = false;
+    for (unsigned int j = 0; j < skipVehicles.size() && !skip; j++)
+    {
+      skip = NamesVehicle(cmd, skipVehicles[j]);
+    }
+    if (skip)
+    {
+      continue;
+    }
+    grapher->GraphCommand(cmd);
+  }
+}
+
+int CountFailedAnalyzers(shared_ptr<Graph> graph)
+{
+  int ret = 0;
+  for (unsigned int i = 0; i < graph->_analyzers.size(); i++)
+  {
+    if (graph->_analyzers[i]->Failed())
+    {
+      ret++;
+    }
+  }
+  return ret;
+}
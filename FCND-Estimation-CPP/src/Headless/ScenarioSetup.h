@@ -0,0 +1,21 @@
+#pragma once
+
+// Scenario setup shared by the single-run and Monte Carlo headless modes
+
+#include "Simulation/QuadDynamics.h"
+#include "Drawing/GraphManager.h"
+
+// matches the GUI's steps per OnTimer, so analyzers see the same data frames
+const int NUM_SIM_STEPS_PER_FRAME = 5;
+
+// hands every vehicle's dynamics, sensors, estimator and controller to the grapher
+void RegisterDataSources(shared_ptr<GraphManager> grapher, const vector<QuadcopterHandle>& quads);
+
+// runs the scenario's Commands.N graph commands, skipping the ones that only
+// make sense with a window. LogToFile is skipped too unless allowLogToFile, and so
+// are the commands that name any of skipVehicles (vehicles simulated elsewhere)
+void ProcessConfigCommands(shared_ptr<GraphManager> grapher, bool allowLogToFile = true,
+  const vector<string>& skipVehicles = vector<string>());
+
+// number of analyzers on the graph whose pass criteria were not met
+int CountFailedAnalyzers(shared_ptr<Graph> graph);
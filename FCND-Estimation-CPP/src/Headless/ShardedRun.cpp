@@ -0,0 +1,314 @@
+#include "Common.h"
+#include "ShardedRun.h"
+#include "ScenarioSetup.h"
+#include "Simulation/Simulator.h"
+#include "Drawing/GraphManager.h"
+#include "Utility/SimpleConfig.h"
+#include "Utility/TelemetryLogger.h"
+#include "Utility/Timer.h"
+#include <atomic>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using namespace SLR;
+
+struct alignas(64) ShardedRun::ShardStatus
+{
+  std::atomic<int> frame;    // frames published so far
+  std::atomic<int> finished; // set once its vehicles reached Sim.EndTime, after the last frame
+  std::atomic<int> reported; // set once it printed its analyzer results
+  int numFailed;             // analyzers that failed, valid once finished
+};
+
+struct alignas(64) ShardedRun::Shared
+{
+  std::atomic<int> frame;       // the frame the shards may step to
+  std::atomic<int> reportShard; // the shard whose turn it is to print its results
+
+  ShardStatus* Status() { return (ShardStatus*)(this + 1); }
+  TelemetryFrame* Frames(int numShards) { return (TelemetryFrame*)(Status() + numShards); }
+};
+
+ShardedRun::ShardedRun(const string& scenarioFile, int numShards)
+  : _scenarioFile(scenarioFile), _numShards(numShards), _numVehicles(0), _shared(NULL), _sharedSize(0)
+{
+}
+
+#ifdef _WIN32
+
+int ShardedRun::Run()
+{
+  SLR_ERROR0("Sharded runs fork their shards, which this platform can't do");
+  return 2;
+}
+
+void ShardedRun::RunShard(int shard)
+{
+}
+
+#else
+
+template <typename Pred> bool ShardedRun::WaitForShard(int shard, Pred ready)
+{
+  for (int spin = 0; !ready(); spin++)
+  {
+    // checking costs a system call, and dying is rare
+    if ((spin & 1023) != 1023)
+    {
+      std::this_thread::yield();
+      continue;
+    }
+
+    int ret;
+    if (waitpid(_pids[shard], &ret, WNOHANG) != _pids[shard])
+    {
+      continue;
+    }
+    if (WIFSIGNALED(ret))
+    {
+      SLR_WARNING4("Shard %d (vehicles %d..%d) was killed by signal %d, dropping its vehicles",
+        shard, FirstVehicle(shard) + 1, FirstVehicle(shard + 1), WTERMSIG(ret));
+    }
+    else
+    {
+      SLR_WARNING4("Shard %d (vehicles %d..%d) exited with code %d, dropping its vehicles",
+        shard, FirstVehicle(shard) + 1, FirstVehicle(shard + 1), WEXITSTATUS(ret));
+    }
+    _pids[shard] = 0;
+    _failed[shard] = true;
+    return false;
+  }
+  return true;
+}
+
+int ShardedRun::Run()
+{
+  if (_numShards < 1)
+  {
+    SLR_ERROR0("A sharded run needs at least one shard");
+    return 2;
+  }
+
+  ParamsHandle config = SimpleConfig::GetInstance();
+  config->Reset(_scenarioFile);
+  _vehicleNames = Simulator::ScenarioVehicleNames();
+  _numVehicles = (int)_vehicleNames.size();
+  if (_numVehicles == 0)
+  {
+    SLR_ERROR1("Scenario %s defines no vehicles", _scenarioFile.c_str());
+    return 2;
+  }
+  if (config->Get("Sim.EndTime", -1.f) <= 0)
+  {
+    SLR_ERROR1("Scenario %s has no positive Sim.EndTime, refusing to run forever", _scenarioFile.c_str());
+    return 2;
+  }
+  _numShards = MIN(_numShards, _numVehicles);
+
+  // mapped before forking, so every shard inherits it
+  _sharedSize = sizeof(Shared) + _numShards * sizeof(ShardStatus) + _numVehicles * sizeof(TelemetryFrame);
+  void* p = mmap(NULL, _sharedSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+  {
+    SLR_ERROR1("Can't map %d bytes of shared memory for the shards", (int)_sharedSize);
+    return 2;
+  }
+  _shared = new (p) Shared();
+  _shared->frame = 0;
+  _shared->reportShard = -1;
+  for (int s = 0; s < _numShards; s++)
+  {
+    ShardStatus* status = new (_shared->Status() + s) ShardStatus();
+    status->frame = 0;
+    status->finished = 0;
+    status->reported = 0;
+    status->numFailed = 0;
+  }
+  TelemetryFrame* frames = _shared->Frames(_numShards);
+
+  printf("Simulating %s: %d vehicles in %d shards\n", _scenarioFile.c_str(), _numVehicles, _numShards);
+
+  // or the shards would print whatever is still buffered again
+  fflush(stdout);
+  fflush(stderr);
+
+  _pids.assign(_numShards, 0);
+  _failed.assign(_numShards, false);
+  for (int s = 0; s < _numShards; s++)
+  {
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      RunShard(s);
+    }
+    if (pid < 0)
+    {
+      SLR_ERROR1("Can't start shard %d", s);
+      _failed[s] = true;
+      continue;
+    }
+    _pids[s] = (int)pid;
+  }
+
+  // the logger writes on its own thread, which must not exist yet when the shards fork
+  shared_ptr<TelemetryBus> telemetry;
+  shared_ptr<TelemetryLogger> telemetryLogger;
+  string telemetryFile = config->Get("Sim.TelemetryLogFile", "");
+  if (telemetryFile != "")
+  {
+    telemetry.reset(new TelemetryBus());
+    telemetryLogger.reset(new TelemetryLogger(telemetry, "../config/" + telemetryFile));
+  }
+
+  Timer wallTime;
+  double simTime = 0;
+  for (int frame = 1; ; frame++)
+  {
+    _shared->frame.store(frame, std::memory_order_release);
+
+    bool anyRunning = false;
+    for (int s = 0; s < _numShards; s++)
+    {
+      if (!_pids[s]) continue;
+      ShardStatus& status = _shared->Status()[s];
+      WaitForShard(s, [&]() {
+        return status.frame.load(std::memory_order_acquire) >= frame || status.finished.load(std::memory_order_acquire);
+      });
+      anyRunning = anyRunning || (_pids[s] && status.frame.load(std::memory_order_acquire) >= frame);
+    }
+    if (!anyRunning) break;
+
+    // every shard that's still running published this frame, and waits for the next
+    for (int s = 0; s < _numShards; s++)
+    {
+      if (!_pids[s]) continue;
+      for (int i = FirstVehicle(s); i < FirstVehicle(s + 1); i++)
+      {
+        simTime = frames[i].time;
+        if (telemetry)
+        {
+          telemetry->Publish(frames[i]);
+        }
+      }
+    }
+  }
+  double wall = wallTime.ElapsedSeconds();
+
+  // one shard at a time, so their results don't interleave
+  int numFailed = 0;
+  for (int s = 0; s < _numShards; s++)
+  {
+    if (!_pids[s]) continue;
+    ShardStatus& status = _shared->Status()[s];
+    _shared->reportShard.store(s, std::memory_order_release);
+    if (WaitForShard(s, [&]() { return status.reported.load(std::memory_order_acquire) != 0; }))
+    {
+      numFailed += status.numFailed;
+    }
+  }
+  _shared->reportShard.store(_numShards, std::memory_order_release);
+
+  int numDied = 0;
+  for (int s = 0; s < _numShards; s++)
+  {
+    if (_pids[s])
+    {
+      int ret;
+      waitpid(_pids[s], &ret, 0);
+      _pids[s] = 0;
+    }
+    numDied += _failed[s] ? 1 : 0;
+  }
+  munmap(_shared, _sharedSize);
+  _shared = NULL;
+
+  printf("Simulated %.3lfs in %.3lfs wall time (%.1lfx real time)\n", simTime, wall, simTime / MAX(wall, 1e-6));
+  if (numDied > 0)
+  {
+    printf("%d of %d shards died, their vehicles were dropped\n", numDied, _numShards);
+  }
+
+  return (numFailed > 0 || numDied > 0) ? 1 : 0;
+}
+
+void ShardedRun::RunShard(int shard)
+{
+  int firstVehicle = FirstVehicle(shard), lastVehicle = FirstVehicle(shard + 1);
+  ShardStatus& status = _shared->Status()[shard];
+  TelemetryFrame* frames = _shared->Frames(_numShards);
+
+  // waits for the coordinator, or gives up if it's gone
+  pid_t coordinator = getppid();
+  auto waitFor = [&](const std::atomic<int>& val, int minVal)
+  {
+    for (int spin = 0; val.load(std::memory_order_acquire) < minVal; spin++)
+    {
+      if ((spin & 1023) == 1023 && getppid() != coordinator)
+      {
+        _exit(2);
+      }
+      std::this_thread::yield();
+    }
+  };
+
+  // buffered until it's the shard's turn to report
+  printf("Shard %d (vehicles %d..%d):\n", shard, firstVehicle + 1, lastVehicle);
+
+  {
+    shared_ptr<Simulator> sim(new Simulator());
+    shared_ptr<GraphManager> grapher(new GraphManager(false));
+
+    sim->LoadScenario(_scenarioFile, firstVehicle, lastVehicle - firstVehicle);
+    string sensorRecordFile = SimpleConfig::GetInstance()->Get("Sim.SensorRecordFile", "");
+    if (sensorRecordFile != "")
+    {
+      sim->_sensorRecordFile = "../config/" + sensorRecordFile;
+    }
+    sim->Reset();
+
+    // the analyzers of the other shards' vehicles would never see any data
+    vector<string> otherVehicles(_vehicleNames.begin(), _vehicleNames.begin() + firstVehicle);
+    otherVehicles.insert(otherVehicles.end(), _vehicleNames.begin() + lastVehicle, _vehicleNames.end());
+    RegisterDataSources(grapher, sim->_vehicles);
+    ProcessConfigCommands(grapher, false, otherVehicles);
+
+    int frame = 0;
+    while (!sim->EndTimeReached())
+    {
+      waitFor(_shared->frame, frame + 1);
+
+      sim->RunSteps(NUM_SIM_STEPS_PER_FRAME);
+      grapher->UpdateData(sim->_simTime);
+      for (unsigned int i = 0; i < sim->_vehicles.size(); i++)
+      {
+        sim->GetTelemetryFrame((int)i, frames[firstVehicle + i]);
+      }
+
+      status.frame.store(++frame, std::memory_order_release);
+    }
+
+    status.numFailed = CountFailedAnalyzers(grapher->graph1) + CountFailedAnalyzers(grapher->graph2);
+    status.finished.store(1, std::memory_order_release);
+
+    // resetting the analyzers prints their PASS/FAIL verdicts
+    waitFor(_shared->reportShard, shard);
+    grapher->Clear();
+
+    // closes the sensor recordings
+    sim.reset();
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  status.reported.store(1, std::memory_order_release);
+
+  // without running the coordinator's exit handlers and destructors
+  _exit(0);
+}
+
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Common.h"
+#include "Utility/TelemetryBus.h"
+#include <vector>
+
+// Runs one scenario with its vehicles split over numShards worker processes.
+// Shard s simulates its share of Sim.Vehicle1..N (consecutive vehicles, the same
+// share every time) exactly as the whole scenario would, checks the analyzers on
+// its own vehicles, and publishes every vehicle's frame into a memory region shared
+// with this process, the coordinator. The shards step frame by frame in lockstep:
+// none starts a frame before all have published the last one, so the coordinator
+// always reads every vehicle at the same sim time. It republishes the frames on
+// Sim.TelemetryLogFile like a single-process run would.
+// A shard that dies is reported and dropped, and the others run to the end.
+// Shards are forked from this process, so this mode is POSIX-only.
+class ShardedRun
+{
+public:
+  ShardedRun(const string& scenarioFile, int numShards);
+
+  // runs the scenario and prints each shard's analyzer results in shard order.
+  // returns 0 if every analyzer passed, 1 if any failed or a shard died, 2 on setup errors
+  int Run();
+
+protected:
+  // per shard, written by the shard and read by the coordinator
+  struct ShardStatus;
+  // the shared region's header, the status of every shard, then every vehicle's frame
+  struct Shared;
+
+  // the shard process' main. never returns
+  void RunShard(int shard);
+
+  // spins until ready() or shard died, in which case it's reported and false is returned
+  template <typename Pred> bool WaitForShard(int shard, Pred ready);
+
+  int FirstVehicle(int shard) const { return (int)((int64_t)shard * _numVehicles / _numShards); }
+
+  string _scenarioFile;
+  int _numShards, _numVehicles;
+  vector<string> _vehicleNames;
+
+  Shared* _shared;
+  size_t _sharedSize;
+  vector<int> _pids;    // per shard, 0 once it died or was reaped
+  vector<bool> _failed; // per shard, whether it died
+};
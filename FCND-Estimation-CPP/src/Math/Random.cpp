@@ -5,68 +5,182 @@
 #include "Random.h"
 #include <math.h>
 
-// from num recipes in c++ chap7
-// a uniform random number generator 
-double ran1(int &idum)
+namespace
 {
-	const int IA = 16807, IM = 2147483647, IQ = 127773, IR = 2836, NTAB = 32;
-	const int NDIV = (1+ (IM-1)/NTAB);
-	const double EPS = 3.0e-16, AM = 1.0/IM, RNMX = (1.0-EPS);
-	static int iy = 0;
-	static int iv[NTAB];
-	int j,k;
-	double temp;
-
-	if(idum<=0 || ! iy) // initialization
-	{
-		if(-idum<1) idum = 1; // prevent idum = 0
-		else idum = -idum;
-		for (j = NTAB+7; j>=0; j--) 
-		{
-			k = idum/IQ;
-			idum = IA*(idum-k*IQ)-IR*k;
-			if(idum<0) idum += IM;
-			if (j<NTAB) iv[j] = idum;
-		}
-		iy = iv[0];
-	}
-
-	// normal operation
-	k = idum/IQ; 
-	idum = IA*(idum-k*IQ)-IR*k;
-	if(idum<0) idum += IM;
-	j = iy/NDIV;
-	iy = iv[j];
-	iv[j] = idum;
-	if((temp = AM*iy)>RNMX) return RNMX;
-	else return temp;
+  const uint32_t PHILOX_M0 = 0xD2511F53, PHILOX_M1 = 0xCD9E8D57;
+  const uint32_t PHILOX_W0 = 0x9E3779B9, PHILOX_W1 = 0xBB67AE85;
+  const int PHILOX_ROUNDS = 10;
+
+  // one Philox4x32-10 block of counter (block, streamId, 0)
+  void PhiloxBlock(const uint32_t key[2], uint32_t streamId, uint64_t block, uint32_t out[4])
+  {
+    uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32), c2 = streamId, c3 = 0;
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < PHILOX_ROUNDS; r++)
+    {
+      uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+      uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+      c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+      c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+      c1 = (uint32_t)p1;
+      c3 = (uint32_t)p0;
+      k0 += PHILOX_W0;
+      k1 += PHILOX_W1;
+    }
+    out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+  }
+
+  // blocks generated side by side in PhiloxBlocks. the rounds are written
+  // lane-wise so the compiler can keep several counters in one vector register
+  const int PHILOX_LANES = 8;
+
+  // PhiloxBlock of counters first..first+n-1, written as out[4*i..4*i+3]
+  void PhiloxBlocks(const uint32_t key[2], uint32_t streamId, uint64_t first, int n, uint32_t* out)
+  {
+    for (int base = 0; base < n; base += PHILOX_LANES)
+    {
+      uint32_t c0[PHILOX_LANES], c1[PHILOX_LANES], c2[PHILOX_LANES], c3[PHILOX_LANES];
+      for (int l = 0; l < PHILOX_LANES; l++)
+      {
+        uint64_t block = first + base + l;
+        c0[l] = (uint32_t)block;
+        c1[l] = (uint32_t)(block >> 32);
+        c2[l] = streamId;
+        c3[l] = 0;
+      }
+
+      uint32_t k0 = key[0], k1 = key[1];
+      for (int r = 0; r < PHILOX_ROUNDS; r++)
+      {
+        for (int l = 0; l < PHILOX_LANES; l++)
+        {
+          uint64_t p0 = (uint64_t)PHILOX_M0 * c0[l];
+          uint64_t p1 = (uint64_t)PHILOX_M1 * c2[l];
+          uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1[l] ^ k0;
+          uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3[l] ^ k1;
+          c1[l] = (uint32_t)p1;
+          c3[l] = (uint32_t)p0;
+          c0[l] = n0;
+          c2[l] = n2;
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+      }
+
+      int m = MIN(PHILOX_LANES, n - base);
+      for (int l = 0; l < m; l++)
+      {
+        uint32_t* o = out + 4 * (base + l);
+        o[0] = c0[l]; o[1] = c1[l]; o[2] = c2[l]; o[3] = c3[l];
+      }
+    }
+  }
+
+  // 24 random bits to [0,1) and (0,1]
+  inline float ToUnitOpen1(uint32_t x) { return (float)(x >> 8) * (1.f / 16777216.f); }
+  inline float ToUnitOpen0(uint32_t x) { return (float)((x >> 8) + 1) * (1.f / 16777216.f); }
+
+  // Box-Muller, 4 uniforms to 4 gaussians
+  inline void BoxMuller(const uint32_t* u, float* out)
+  {
+    const float TWO_PI = 6.28318530717958647f;
+    for (int i = 0; i < 4; i += 2)
+    {
+      float r = sqrtf(-2.f * logf(ToUnitOpen0(u[i])));
+      float theta = TWO_PI * ToUnitOpen1(u[i + 1]);
+      out[i] = r * cosf(theta);
+      out[i + 1] = r * sinf(theta);
+    }
+  }
+
+  // splitmix64 finalizer, used to fold seed components into a key
+  uint64_t Mix64(uint64_t x)
+  {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+  }
+}
+
+void RandomStream::Seed(uint64_t key, uint32_t streamId)
+{
+  _key[0] = (uint32_t)key;
+  _key[1] = (uint32_t)(key >> 32);
+  _streamId = streamId;
+  _nextBlock = 0;
+  _uniformPos = 4;
+  _gaussPos = 4;
+}
+
+uint64_t RandomStream::MakeKey(const std::string& scenarioName, int vehicleIndex, int runNumber)
+{
+  // FNV-1a of the name, then mix in the numbers
+  uint64_t h = 0xCBF29CE484222325ull;
+  for (unsigned int i = 0; i < scenarioName.size(); i++)
+  {
+    h = (h ^ (uint8_t)scenarioName[i]) * 0x100000001B3ull;
+  }
+  h = Mix64(h ^ (uint32_t)vehicleIndex);
+  h = Mix64(h ^ ((uint64_t)(uint32_t)runNumber << 32));
+  return h;
+}
+
+uint32_t RandomStream::NextUInt()
+{
+  if (_uniformPos >= 4)
+  {
+    PhiloxBlock(_key, _streamId, _nextBlock++, _uniformBuf);
+    _uniformPos = 0;
+  }
+  return _uniformBuf[_uniformPos++];
+}
+
+float RandomStream::Uniform()
+{
+  return ToUnitOpen1(NextUInt());
 }
 
-// a gaussian random number generator from numerical recipes
-// need the uniform RV generator to work
-double gasdev(int &idum)
-{	
-  static int iset = 0;
-	static double gset;
-	double fac, rsq, v1,v2;
-
-	if(idum<0) iset = 0;
-	if(iset == 0)
-	{
-		do 
+float RandomStream::Gaussian()
+{
+  if (_gaussPos >= 4)
+  {
+    uint32_t u[4];
+    PhiloxBlock(_key, _streamId, _nextBlock++, u);
+    BoxMuller(u, _gaussBuf);
+    _gaussPos = 0;
+  }
+  return _gaussBuf[_gaussPos++];
+}
+
+void RandomStream::FillGaussian(float* out, int n)
+{
+  // use up what's left of the current block first, to match Gaussian()
+  while (n > 0 && _gaussPos < 4)
+  {
+    *out++ = _gaussBuf[_gaussPos++];
+    n--;
+  }
+
+  // whole blocks straight into the output
+  const int CHUNK = 64;
+  uint32_t u[4 * CHUNK];
+  while (n >= 4)
+  {
+    int numBlocks = MIN(n / 4, CHUNK);
+    PhiloxBlocks(_key, _streamId, _nextBlock, numBlocks, u);
+    _nextBlock += numBlocks;
+    for (int b = 0; b < numBlocks; b++)
     {
-			v1=2.0*ran1(idum)-1.0;
-			v2=2.0*ran1(idum)-1.0;
-			rsq = v1*v1 + v2*v2;
-		} while (rsq >= 1.0 || rsq == 0.0);
-		fac = sqrt(-2.0 * log(rsq)/rsq);
-		gset = v1*fac;
-		iset = 1;
-		return v2*fac;
-	} 
-  else 
+      BoxMuller(u + 4 * b, out + 4 * b);
+    }
+    out += 4 * numBlocks;
+    n -= 4 * numBlocks;
+  }
+
+  while (n > 0)
   {
-		iset = 0;
-		return gset;
-	}
+    *out++ = Gaussian();
+    n--;
+  }
 }
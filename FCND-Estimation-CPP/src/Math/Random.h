@@ -3,17 +3,47 @@
 
 #pragma once
 
-// random number routines from Numerical Recipes
-double gasdev(int &idum);
-double ran1(int &idum);
-inline float gasdev_f(int &idum) { return (float)gasdev(idum); }
+#include <stdint.h>
+#include <string>
 
-inline float ran1_inRange(float min, float max, int& idum)
+// A counter-based random number stream (Philox4x32-10, Salmon et al.,
+// "Parallel Random Numbers: As Easy as 1, 2, 3", SC11).
+// Draw n of a stream is a pure function of (key, stream id, n), so every
+// vehicle and sensor can own a stream that reproduces exactly no matter which
+// thread runs it or in what order. The key normally comes from MakeKey(),
+// the stream id separates the streams of one vehicle (motors, each sensor).
+class RandomStream
 {
-  return (float)(ran1(idum)*(max-min)+min);
-}
+public:
+  RandomStream(uint64_t key = 0, uint32_t streamId = 0) { Seed(key, streamId); }
 
-inline double ran1_inRange(double min, double max, int& idum)
-{
-  return (double)(ran1(idum)*(max-min)+min);
-}
\ No newline at end of file
+  // restarts the stream at its first draw
+  void Seed(uint64_t key, uint32_t streamId = 0);
+
+  // stream key for one vehicle of one run of a scenario
+  static uint64_t MakeKey(const std::string& scenarioName, int vehicleIndex, int runNumber);
+
+  uint32_t NextUInt();
+
+  // uniform in [0,1)
+  float Uniform();
+  float Uniform(float min, float max) { return min + (max - min) * Uniform(); }
+
+  // standard normal
+  float Gaussian();
+
+  // n standard normal draws, same values as n calls to Gaussian() but
+  // generated a block of counters at a time
+  void FillGaussian(float* out, int n);
+
+protected:
+  uint32_t _key[2];
+  uint32_t _streamId;
+  uint64_t _nextBlock;   // counter of the next 128-bit block to generate
+
+  // leftovers of the last block, a Philox block is 4 uniforms or 4 gaussians
+  uint32_t _uniformBuf[4];
+  int _uniformPos;
+  float _gaussBuf[4];
+  int _gaussPos;
+};
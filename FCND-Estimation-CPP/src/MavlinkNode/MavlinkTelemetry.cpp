@@ -0,0 +1,48 @@
+#include "Common.h"
+#include "MavlinkTelemetry.h"
+#include "MavlinkNode.h"
+#include "Math/Quaternion.h"
+#include <vector>
+using std::vector;
+using SLR::Quaternion;
+using SLR::TelemetryFrame;
+#include "MavlinkTranslation.h"
+
+MavlinkTelemetry::MavlinkTelemetry(shared_ptr<SLR::TelemetryBus> bus, shared_ptr<MavlinkNode> node, double sendInterval)
+	: TelemetryConsumer(bus), _node(node), _sendInterval(sendInterval)
+{
+	_haveLatest = false;
+	Start();
+}
+
+MavlinkTelemetry::~MavlinkTelemetry()
+{
+	// the thread uses _node
+	Stop();
+}
+
+void MavlinkTelemetry::OnFrame(const TelemetryFrame& frame)
+{
+	if (frame.vehicle != 0) return;
+	_latest = frame;
+	_haveLatest = true;
+}
+
+void MavlinkTelemetry::OnIdle()
+{
+	// keeps re-sending the last frame while the simulation is paused, like a live vehicle would
+	if (!_haveLatest || _lastSend.ElapsedSeconds() < _sendInterval) return;
+
+	const TelemetryFrame& f = _latest;
+	V3F pos(f.pos[0], f.pos[1], f.pos[2]);
+	V3F vel(f.vel[0], f.vel[1], f.vel[2]);
+	V3F omega(f.omega[0], f.omega[1], f.omega[2]);
+	Quaternion<float> att(f.att[0], f.att[1], f.att[2], f.att[3]);
+
+	_node->Send(MakeMavlinkPacket_Heartbeat());
+	_node->Send(MakeMavlinkPacket_Status());
+	_node->Send(MakeMavlinkPacket_LocalPose((float)f.time, pos, vel));
+	_node->Send(MakeMavlinkPacket_Attitude((float)f.time, att, omega));
+
+	_lastSend.Reset();
+}
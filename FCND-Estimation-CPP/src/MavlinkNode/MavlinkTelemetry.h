@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Utility/TelemetryBus.h"
+#include "Utility/Timer.h"
+
+class MavlinkNode;
+
+// Streams the pose of vehicle 0 to the ground station from the telemetry bus,
+// so the UDP sends happen on this consumer's thread and not on the GLUT/simulation one
+class MavlinkTelemetry : public SLR::TelemetryConsumer
+{
+public:
+	MavlinkTelemetry(shared_ptr<SLR::TelemetryBus> bus, shared_ptr<MavlinkNode> node, double sendInterval = 0.030);
+	~MavlinkTelemetry();
+
+protected:
+	virtual void OnFrame(const SLR::TelemetryFrame& frame);
+	virtual void OnIdle();
+
+	shared_ptr<MavlinkNode> _node;
+	double _sendInterval;
+	Timer _lastSend;
+
+	// latest frame of vehicle 0
+	SLR::TelemetryFrame _latest;
+	bool _haveLatest;
+};
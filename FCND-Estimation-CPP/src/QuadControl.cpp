@@ -35,6 +35,7 @@ void QuadControl::Init()
   kpYaw = config->Get(_config + ".kpYaw", 0);
 
   kpPQR = config->Get(_config + ".kpPQR", V3F());
+  ffPQR = config->Get(_config + ".ffPQR", 0);
 
   maxDescentRate = config->Get(_config + ".maxDescentRate", 100);
   maxAscentRate = config->Get(_config + ".maxAscentRate", 100);
@@ -305,6 +306,9 @@ VehicleCommand QuadControl::RunControl(float dt, float simTime)
   V3F desOmega = RollPitchControl(desAcc, estAtt, collThrustCmd);
   desOmega.z = YawControl(curTrajPoint.attitude.Yaw(), estAtt.Yaw());
 
+  // body rates the trajectory itself turns at, where it has them (splines do, see TrajectorySpline.h)
+  desOmega += curTrajPoint.omega * ffPQR;
+
   V3F desMoment = BodyRateControl(desOmega, estOmega);
 
   return GenerateMotorCommands(collThrustCmd, desMoment);
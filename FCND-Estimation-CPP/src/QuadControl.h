@@ -38,6 +38,8 @@ public:
   float kpBank, kpYaw;
   float KiPosZ;
   V3F kpPQR;
+  // how much of the trajectory's body rates to feed forward (0..1)
+  float ffPQR;
   
   // limits & saturations
   float maxAscentRate, maxDescentRate;
@@ -48,4 +50,17 @@ public:
 
   // integral control
   float integratedAltitudeError;
+
+  virtual void SaveState(SLR::StateBuffer& s)
+  {
+    BaseController::SaveState(s);
+    s.Put(integratedAltitudeError);
+  }
+
+  virtual bool LoadState(SLR::StateBuffer& s)
+  {
+    BaseController::LoadState(s);
+    s.Get(integratedAltitudeError);
+    return !s.Failed();
+  }
 };
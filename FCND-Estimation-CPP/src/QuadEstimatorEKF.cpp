@@ -7,18 +7,34 @@
 using namespace SLR;
 
 const int QuadEstimatorEKF::QUAD_EKF_NUM_STATES;
+const int QuadEstimatorEKF::NUM_NOISE_PARAMS;
+
+const char* const QuadEstimatorEKF::NOISE_PARAMS[QuadEstimatorEKF::NUM_NOISE_PARAMS] = {
+  "GPSPosXYStd", "GPSPosZStd", "GPSVelXYStd", "GPSVelZStd", "MagYawStd",
+  "QPosXYStd", "QPosZStd", "QVelXYStd", "QVelZStd", "QYawStd"
+};
+
+namespace
+{
+  QuadEstimatorEKF::UpdateMode GetUpdateMode(ParamsHandle paramSys, const string& param)
+  {
+    string mode = ToUpper(paramSys->Get(param, "Batch"));
+    if (mode == "SEQUENTIAL") return QuadEstimatorEKF::UPDATE_SEQUENTIAL;
+    if (mode == "SEQUENTIALJOSEPH") return QuadEstimatorEKF::UPDATE_SEQUENTIAL_JOSEPH;
+    if (mode != "BATCH")
+    {
+      SLR_WARNING2("Unknown %s %s, using Batch", param.c_str(), mode.c_str());
+    }
+    return QuadEstimatorEKF::UPDATE_BATCH;
+  }
+}
 
 QuadEstimatorEKF::QuadEstimatorEKF(string config, string name)
-  : BaseQuadEstimator(config),
-  Q(QUAD_EKF_NUM_STATES, QUAD_EKF_NUM_STATES),
-  R_GPS(6, 6),
-  R_Mag(1, 1),
-  ekfState(QUAD_EKF_NUM_STATES),
-  ekfCov(QUAD_EKF_NUM_STATES, QUAD_EKF_NUM_STATES),
-  trueError(QUAD_EKF_NUM_STATES)
+  : BaseQuadEstimator(config)
 {
   _name = name;
   Init();
+  AddFields();
 }
 
 QuadEstimatorEKF::~QuadEstimatorEKF()
@@ -30,9 +46,12 @@ void QuadEstimatorEKF::Init()
 {
   ParamsHandle paramSys = SimpleConfig::GetInstance();
 
+  // zero first, so a missing config gives a defined (and repeatable) state
+  ekfState.setZero();
   paramSys->GetFloatVector(_config + ".InitState", ekfState);
 
-  VectorXf initStdDevs(QUAD_EKF_NUM_STATES);
+  StateVector initStdDevs;
+  initStdDevs.setZero();
   paramSys->GetFloatVector(_config + ".InitStdDevs", initStdDevs);
   ekfCov.setIdentity();
   for (int i = 0; i < QUAD_EKF_NUM_STATES; i++)
@@ -47,30 +66,41 @@ void QuadEstimatorEKF::Init()
   pitchEst = 0;
   rollEst = 0;
   
-  // GPS measurement model covariance
+  // GPS and magnetometer measurement model covariances, and the transition model covariance
   R_GPS.setZero();
-  R_GPS(0, 0) = R_GPS(1, 1) = powf(paramSys->Get(_config + ".GPSPosXYStd", 0), 2);
-  R_GPS(2, 2) = powf(paramSys->Get(_config + ".GPSPosZStd", 0), 2);
-  R_GPS(3, 3) = R_GPS(4, 4) = powf(paramSys->Get(_config + ".GPSVelXYStd", 0), 2);
-  R_GPS(5, 5) = powf(paramSys->Get(_config + ".GPSVelZStd", 0), 2);
-
-  // magnetometer measurement model covariance
   R_Mag.setZero();
-  R_Mag(0, 0) = powf(paramSys->Get(_config + ".MagYawStd", 0), 2);
-
-  // load the transition model covariance
   Q.setZero();
-  Q(0, 0) = Q(1, 1) = powf(paramSys->Get(_config + ".QPosXYStd", 0), 2);
-  Q(2, 2) = powf(paramSys->Get(_config + ".QPosZStd", 0), 2);
-  Q(3, 3) = Q(4, 4) = powf(paramSys->Get(_config + ".QVelXYStd", 0), 2);
-  Q(5, 5) = powf(paramSys->Get(_config + ".QVelZStd", 0), 2);
-  Q(6, 6) = powf(paramSys->Get(_config + ".QYawStd", 0), 2);
-  Q *= dtIMU;
+  for (int i = 0; i < NUM_NOISE_PARAMS; i++)
+  {
+    SetNoiseParam(NOISE_PARAMS[i], paramSys->Get(_config + "." + NOISE_PARAMS[i], 0));
+  }
+
+  gpsUpdateMode = GetUpdateMode(paramSys, _config + ".GPSUpdateMode");
+  magUpdateMode = GetUpdateMode(paramSys, _config + ".MagUpdateMode");
 
   rollErr = pitchErr = maxEuler = 0;
   posErrorMag = velErrorMag = 0;
 }
 
+bool QuadEstimatorEKF::SetNoiseParam(const string& name, float stdDev)
+{
+  string n = ToUpper(name);
+  float var = powf(stdDev, 2);
+  if (n == "GPSPOSXYSTD") R_GPS(0, 0) = R_GPS(1, 1) = var;
+  else if (n == "GPSPOSZSTD") R_GPS(2, 2) = var;
+  else if (n == "GPSVELXYSTD") R_GPS(3, 3) = R_GPS(4, 4) = var;
+  else if (n == "GPSVELZSTD") R_GPS(5, 5) = var;
+  else if (n == "MAGYAWSTD") R_Mag(0, 0) = var;
+  // the process noise is specified per second, Q is per IMU step
+  else if (n == "QPOSXYSTD") Q(0, 0) = Q(1, 1) = var * dtIMU;
+  else if (n == "QPOSZSTD") Q(2, 2) = var * dtIMU;
+  else if (n == "QVELXYSTD") Q(3, 3) = Q(4, 4) = var * dtIMU;
+  else if (n == "QVELZSTD") Q(5, 5) = var * dtIMU;
+  else if (n == "QYAWSTD") Q(6, 6) = var * dtIMU;
+  else return false;
+  return true;
+}
+
 void QuadEstimatorEKF::UpdateFromIMU(V3F accel, V3F gyro)
 {
   // Improve a complementary filter-type attitude filter
@@ -139,7 +169,7 @@ void QuadEstimatorEKF::UpdateFromIMU(V3F accel, V3F gyro)
 
 void QuadEstimatorEKF::UpdateTrueError(V3F truePos, V3F trueVel, Quaternion<float> trueAtt)
 {
-  VectorXf trueState(QUAD_EKF_NUM_STATES);
+  StateVector trueState;
   trueState(0) = truePos.x;
   trueState(1) = truePos.y;
   trueState(2) = truePos.z;
@@ -160,10 +190,9 @@ void QuadEstimatorEKF::UpdateTrueError(V3F truePos, V3F trueVel, Quaternion<floa
   velErrorMag = trueVel.dist(V3F(ekfState(3), ekfState(4), ekfState(5)));
 }
 
-VectorXf QuadEstimatorEKF::PredictState(VectorXf curState, float dt, V3F accel, V3F gyro)
+QuadEstimatorEKF::StateVector QuadEstimatorEKF::PredictState(const StateVector& curState, float dt, V3F accel, V3F gyro)
 {
-  assert(curState.size() == QUAD_EKF_NUM_STATES);
-  VectorXf predictedState = curState;
+  StateVector predictedState = curState;
   // Predict the current state forward by time dt using current accelerations and body rates as input
   // INPUTS: 
   //   curState: starting state
@@ -206,10 +235,10 @@ VectorXf QuadEstimatorEKF::PredictState(VectorXf curState, float dt, V3F accel,
   return predictedState;
 }
 
-MatrixXf QuadEstimatorEKF::GetRbgPrime(float roll, float pitch, float yaw)
+Eigen::Matrix3f QuadEstimatorEKF::GetRbgPrime(float roll, float pitch, float yaw)
 {
   // first, figure out the Rbg_prime
-  MatrixXf RbgPrime(3, 3);
+  Eigen::Matrix3f RbgPrime;
   RbgPrime.setZero();
 
   // Return the partial derivative of the Rbg rotation matrix with respect to yaw. We call this RbgPrime.
@@ -262,7 +291,7 @@ MatrixXf QuadEstimatorEKF::GetRbgPrime(float roll, float pitch, float yaw)
 void QuadEstimatorEKF::Predict(float dt, V3F accel, V3F gyro)
 {
   // predict the state forward
-  VectorXf newState = PredictState(ekfState, dt, accel, gyro);
+  StateVector newState = PredictState(ekfState, dt, accel, gyro);
 
   // Predict the current covariance forward by dt using the current accelerations and body rates as input.
   // INPUTS: 
@@ -291,26 +320,18 @@ void QuadEstimatorEKF::Predict(float dt, V3F accel, V3F gyro)
   // 
 
   // we'll want the partial derivative of the Rbg matrix
-  MatrixXf RbgPrime = GetRbgPrime(rollEst, pitchEst, ekfState(6));
-
-  // we've created an empty Jacobian for you, currently simply set to identity
-  MatrixXf gPrime(QUAD_EKF_NUM_STATES, QUAD_EKF_NUM_STATES);
-  gPrime.setIdentity();
+  Eigen::Matrix3f RbgPrime = GetRbgPrime(rollEst, pitchEst, ekfState(6));
 
   ////////////////////////////// BEGIN STUDENT CODE ///////////////////////////
 
-  // Position update due to velocity
-    // Velocity update due to yaw affecting acceleration (RbgPrime · accel)
-
-  gPrime(0, 3) = dt;
-  gPrime(1, 4) = dt;
-  gPrime(2, 5) = dt;
+  // gPrime is identity apart from the position-from-velocity entries gPrime(i, i+3) = dt
+  // and the velocity-from-yaw column gPrime(3..5, 6), which is all PredictCovariance needs
+  float gPrimeYaw[3];
   for (int i = 0; i < 3; ++i) {
-      gPrime(i + 3, 6) = (RbgPrime(i) * accel).sum() * dt;
+      gPrimeYaw[i] = GPrimeYaw(RbgPrime(i), accel, dt);
   }
 
-
-  ekfCov = gPrime * ekfCov * gPrime.transpose() + Q;
+  PredictCovariance(dt, gPrimeYaw);
 
 
   /////////////////////////////// END STUDENT CODE ////////////////////////////
@@ -318,9 +339,72 @@ void QuadEstimatorEKF::Predict(float dt, V3F accel, V3F gyro)
   ekfState = newState;
 }
 
+void QuadEstimatorEKF::PredictCovariance(float dt, const float gPrimeYaw[3])
+{
+  // ekfCov = gPrime * ekfCov * gPrime' + Q, without forming gPrime.
+  // gPrime is identity except for gPrime(i, i+3) = dt (i < 3) and gPrime(3..5, 6),
+  // so multiplying by it from the left adds a scaled copy of one row to rows 0..5,
+  // and by gPrime' from the right does the same with the columns.
+  // Only the upper triangle of ekfCov is read and computed and the lower one is
+  // mirrored from it, so ekfCov comes out exactly symmetric.
+  const int N = QUAD_EKF_NUM_STATES;
+
+  // the current covariance, symmetrized from its upper triangle
+  float P[N][N];
+  for (int i = 0; i < N; i++)
+  {
+    for (int j = i; j < N; j++)
+    {
+      P[i][j] = P[j][i] = ekfCov(i, j);
+    }
+  }
+
+  // A = gPrime * P
+  float A[N][N];
+  for (int j = 0; j < N; j++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      A[i][j] = P[i][j] + dt * P[i + 3][j];
+      A[i + 3][j] = P[i + 3][j] + gPrimeYaw[i] * P[6][j];
+    }
+    A[6][j] = P[6][j];
+  }
+
+  // ekfCov = A * gPrime' + Q, upper triangle
+  for (int i = 0; i < N; i++)
+  {
+    for (int j = i; j < 3; j++)
+    {
+      ekfCov(i, j) = A[i][j] + dt * A[i][j + 3];
+    }
+    for (int j = MAX(i, 3); j < 6; j++)
+    {
+      ekfCov(i, j) = A[i][j] + gPrimeYaw[j - 3] * A[i][6];
+    }
+    ekfCov(i, 6) = A[i][6];
+
+    // Q is diagonal, see Init()
+    ekfCov(i, i) += Q(i, i);
+  }
+
+  SymmetrizeCov();
+}
+
+void QuadEstimatorEKF::SymmetrizeCov()
+{
+  for (int i = 1; i < QUAD_EKF_NUM_STATES; i++)
+  {
+    for (int j = 0; j < i; j++)
+    {
+      ekfCov(i, j) = ekfCov(j, i);
+    }
+  }
+}
+
 void QuadEstimatorEKF::UpdateFromGPS(V3F pos, V3F vel)
 {
-  VectorXf z(6), zFromX(6);
+  MeasVector<6> z, zFromX;
   z(0) = pos.x;
   z(1) = pos.y;
   z(2) = pos.z;
@@ -328,7 +412,7 @@ void QuadEstimatorEKF::UpdateFromGPS(V3F pos, V3F vel)
   z(4) = vel.y;
   z(5) = vel.z;
 
-  MatrixXf hPrime(6, QUAD_EKF_NUM_STATES);
+  MeasJacobian<6> hPrime;
   hPrime.setZero();
 
   // GPS UPDATE
@@ -344,15 +428,15 @@ for (int i = 0; i < 6; ++i) {
 
   /////////////////////////////// END STUDENT CODE ////////////////////////////
 
-  Update(z, hPrime, R_GPS, zFromX);
+  Update(z, hPrime, R_GPS, zFromX, gpsUpdateMode);
 }
 
 void QuadEstimatorEKF::UpdateFromMag(float magYaw)
 {
-  VectorXf z(1), zFromX(1);
+  MeasVector<1> z, zFromX;
   z(0) = magYaw;
 
-  MatrixXf hPrime(1, QUAD_EKF_NUM_STATES);
+  MeasJacobian<1> hPrime;
   hPrime.setZero();
 
   // MAGNETOMETER UPDATE
@@ -378,7 +462,7 @@ void QuadEstimatorEKF::UpdateFromMag(float magYaw)
 
   /////////////////////////////// END STUDENT CODE ////////////////////////////
 
-  Update(z, hPrime, R_Mag, zFromX);
+  Update(z, hPrime, R_Mag, zFromX, magUpdateMode);
 }
 
 // Execute an EKF update step
@@ -386,147 +470,167 @@ void QuadEstimatorEKF::UpdateFromMag(float magYaw)
 // H: Jacobian of observation function evaluated at the current estimated state
 // R: observation error model covariance 
 // zFromX: measurement prediction based on current state
-void QuadEstimatorEKF::Update(VectorXf& z, MatrixXf& H, MatrixXf& R, VectorXf& zFromX)
+// mode: batch, or one scalar measurement at a time (see UpdateMode)
+template<int M>
+void QuadEstimatorEKF::Update(const MeasVector<M>& z, const MeasJacobian<M>& H, const MeasMatrix<M>& R, const MeasVector<M>& zFromX,
+  UpdateMode mode)
 {
-  assert(z.size() == H.rows());
-  assert(QUAD_EKF_NUM_STATES == H.cols());
-  assert(z.size() == R.rows());
-  assert(z.size() == R.cols());
-  assert(z.size() == zFromX.size());
+  if (mode != UPDATE_BATCH)
+  {
+    // with a diagonal R the measurements are independent, and folding them in one at
+    // a time gives the batch result. zFromX was predicted from the state before
+    // the update, so each innovation is corrected by what the earlier ones moved the state.
+    // R's off-diagonal terms are ignored, R_GPS and R_Mag are diagonal
+    StateVector startState = ekfState;
+    for (int i = 0; i < M; i++)
+    {
+      float y = z(i) - zFromX(i) - H.row(i).dot(ekfState - startState);
+      ScalarUpdate(H.row(i), R(i, i), y, mode == UPDATE_SEQUENTIAL_JOSEPH);
+    }
+    return;
+  }
 
-  MatrixXf toInvert(z.size(), z.size());
-  toInvert = H*ekfCov*H.transpose() + R;
-  MatrixXf K = ekfCov * H.transpose() * toInvert.inverse();
+  MeasMatrix<M> toInvert = H*ekfCov*H.transpose() + R;
+  Eigen::Matrix<float, QUAD_EKF_NUM_STATES, M> K = ekfCov * H.transpose() * toInvert.inverse();
 
   ekfState = ekfState + K*(z - zFromX);
 
-  MatrixXf eye(QUAD_EKF_NUM_STATES, QUAD_EKF_NUM_STATES);
-  eye.setIdentity();
-
-  ekfCov = (eye - K*H)*ekfCov;
+  ekfCov = (StateMatrix::Identity() - K*H)*ekfCov;
 }
 
-// Calculate the condition number of the EKF ovariance matrix (useful for numerical diagnostics)
-// The condition number provides a measure of how similar the magnitudes of the error metric beliefs 
-// about the different states are. If the magnitudes are very far apart, numerical issues will start to come up.
-float QuadEstimatorEKF::CovConditionNumber() const
+void QuadEstimatorEKF::ScalarUpdate(const Eigen::Matrix<float, 1, QUAD_EKF_NUM_STATES>& h, float r, float y, bool joseph)
 {
-  MatrixXf m(7, 7);
-  for (int i = 0; i < 7; i++)
+  // P*h', the innovation variance h*P*h'+r and the gain K = P*h'/s.
+  // the sensors' h are selector rows, so only the columns with a nonzero h(k) are summed
+  StateVector Ph;
+  Ph.setZero();
+  for (int k = 0; k < QUAD_EKF_NUM_STATES; k++)
   {
-    for (int j = 0; j < 7; j++)
+    if (h(k) != 0)
     {
-      m(i, j) = ekfCov(i, j);
+      Ph += ekfCov.col(k) * h(k);
     }
   }
+  float s = h.dot(Ph) + r;
+  StateVector K = Ph / s;
 
-  Eigen::JacobiSVD<MatrixXf> svd(m);
+  ekfState += K * y;
+
+  if (!joseph)
+  {
+    // P = (I - K*h)*P = P - Ph*Ph'/s. Ph(i)*Ph(j) == Ph(j)*Ph(i), so this keeps P symmetric
+    float invS = 1.f / s;
+    for (int j = 0; j < QUAD_EKF_NUM_STATES; j++)
+    {
+      for (int i = 0; i < QUAD_EKF_NUM_STATES; i++)
+      {
+        ekfCov(i, j) -= Ph(i) * Ph(j) * invS;
+      }
+    }
+    return;
+  }
+
+  // Joseph form P = (I - K*h)*P*(I - K*h)' + K*r*K', as a sum of rank-1 terms:
+  // B = (I - K*h)*P = P - K*Ph', then B*(I - K*h)' = B - (B*h')*K'.
+  // less prone to losing positive definiteness when s is poorly conditioned
+  StateMatrix B = ekfCov - K * Ph.transpose();
+  StateVector Bh = B * h.transpose();
+  ekfCov = B - Bh * K.transpose() + (r * K) * K.transpose();
+  SymmetrizeCov();
+}
+
+// Calculate the condition number of the EKF ovariance matrix (useful for numerical diagnostics)
+// The condition number provides a measure of how similar the magnitudes of the error metric beliefs 
+// about the different states are. If the magnitudes are very far apart, numerical issues will start to come up.
+float QuadEstimatorEKF::CovConditionNumber() const
+{
+  Eigen::JacobiSVD<StateMatrix> svd(ekfCov);
   float cond = svd.singularValues()(0)
     / svd.singularValues()(svd.singularValues().size() - 1);
   return cond;
 }
 
-// Access functions for graphing variables
-bool QuadEstimatorEKF::GetData(const string& name, float& ret) const
+void QuadEstimatorEKF::SaveState(StateBuffer& s)
 {
-  if (name.find_first_of(".") == string::npos) return false;
-  string leftPart = LeftOf(name, '.');
-  string rightPart = RightOf(name, '.');
+  s.PutArray(ekfState.data(), QUAD_EKF_NUM_STATES);
+  s.PutArray(ekfCov.data(), QUAD_EKF_NUM_STATES * QUAD_EKF_NUM_STATES);
+  s.Put(rollEst);
+  s.Put(pitchEst);
+  s.Put(accelRoll);
+  s.Put(accelPitch);
+  s.Put(accelG);
+  s.Put(lastGyro);
+  s.PutArray(trueError.data(), QUAD_EKF_NUM_STATES);
+  s.Put(rollErr);
+  s.Put(pitchErr);
+  s.Put(maxEuler);
+  s.Put(posErrorMag);
+  s.Put(velErrorMag);
+}
 
-  if (ToUpper(leftPart) == ToUpper(_name))
-  {
-#define GETTER_HELPER(A,B) if (SLR::ToUpper(rightPart) == SLR::ToUpper(A)){ ret=(B); return true; }
-    GETTER_HELPER("Est.roll", rollEst);
-    GETTER_HELPER("Est.pitch", pitchEst);
-
-    GETTER_HELPER("Est.x", ekfState(0));
-    GETTER_HELPER("Est.y", ekfState(1));
-    GETTER_HELPER("Est.z", ekfState(2));
-    GETTER_HELPER("Est.vx", ekfState(3));
-    GETTER_HELPER("Est.vy", ekfState(4));
-    GETTER_HELPER("Est.vz", ekfState(5));
-    GETTER_HELPER("Est.yaw", ekfState(6));
-
-    GETTER_HELPER("Est.S.x", sqrtf(ekfCov(0, 0)));
-    GETTER_HELPER("Est.S.y", sqrtf(ekfCov(1, 1)));
-    GETTER_HELPER("Est.S.z", sqrtf(ekfCov(2, 2)));
-    GETTER_HELPER("Est.S.vx", sqrtf(ekfCov(3, 3)));
-    GETTER_HELPER("Est.S.vy", sqrtf(ekfCov(4, 4)));
-    GETTER_HELPER("Est.S.vz", sqrtf(ekfCov(5, 5)));
-    GETTER_HELPER("Est.S.yaw", sqrtf(ekfCov(6, 6)));
-
-    // diagnostic variables
-    GETTER_HELPER("Est.D.AccelPitch", accelPitch);
-    GETTER_HELPER("Est.D.AccelRoll", accelRoll);
-
-    GETTER_HELPER("Est.D.ax_g", accelG[0]);
-    GETTER_HELPER("Est.D.ay_g", accelG[1]);
-    GETTER_HELPER("Est.D.az_g", accelG[2]);
-
-    GETTER_HELPER("Est.E.x", trueError(0));
-    GETTER_HELPER("Est.E.y", trueError(1));
-    GETTER_HELPER("Est.E.z", trueError(2));
-    GETTER_HELPER("Est.E.vx", trueError(3));
-    GETTER_HELPER("Est.E.vy", trueError(4));
-    GETTER_HELPER("Est.E.vz", trueError(5));
-    GETTER_HELPER("Est.E.yaw", trueError(6));
-    GETTER_HELPER("Est.E.pitch", pitchErr);
-    GETTER_HELPER("Est.E.roll", rollErr);
-    GETTER_HELPER("Est.E.MaxEuler", maxEuler);
-
-    GETTER_HELPER("Est.E.pos", posErrorMag);
-    GETTER_HELPER("Est.E.vel", velErrorMag);
-
-    GETTER_HELPER("Est.D.covCond", CovConditionNumber());
-#undef GETTER_HELPER
-  }
-  return false;
-};
+bool QuadEstimatorEKF::LoadState(StateBuffer& s)
+{
+  s.GetArray(ekfState.data(), QUAD_EKF_NUM_STATES);
+  s.GetArray(ekfCov.data(), QUAD_EKF_NUM_STATES * QUAD_EKF_NUM_STATES);
+  s.Get(rollEst);
+  s.Get(pitchEst);
+  s.Get(accelRoll);
+  s.Get(accelPitch);
+  s.Get(accelG);
+  s.Get(lastGyro);
+  s.GetArray(trueError.data(), QUAD_EKF_NUM_STATES);
+  s.Get(rollErr);
+  s.Get(pitchErr);
+  s.Get(maxEuler);
+  s.Get(posErrorMag);
+  s.Get(velErrorMag);
+  return !s.Failed();
+}
 
-vector<string> QuadEstimatorEKF::GetFields() const
+// Graphing variables, published once. the pointers stay valid, the state and
+// covariance are fixed-size members
+void QuadEstimatorEKF::AddFields()
 {
-  vector<string> ret = BaseQuadEstimator::GetFields();
-  ret.push_back(_name + ".Est.roll");
-  ret.push_back(_name + ".Est.pitch");
-
-  ret.push_back(_name + ".Est.x");
-  ret.push_back(_name + ".Est.y");
-  ret.push_back(_name + ".Est.z");
-  ret.push_back(_name + ".Est.vx");
-  ret.push_back(_name + ".Est.vy");
-  ret.push_back(_name + ".Est.vz");
-  ret.push_back(_name + ".Est.yaw");
-
-  ret.push_back(_name + ".Est.S.x");
-  ret.push_back(_name + ".Est.S.y");
-  ret.push_back(_name + ".Est.S.z");
-  ret.push_back(_name + ".Est.S.vx");
-  ret.push_back(_name + ".Est.S.vy");
-  ret.push_back(_name + ".Est.S.vz");
-  ret.push_back(_name + ".Est.S.yaw");
-
-  ret.push_back(_name + ".Est.E.x");
-  ret.push_back(_name + ".Est.E.y");
-  ret.push_back(_name + ".Est.E.z");
-  ret.push_back(_name + ".Est.E.vx");
-  ret.push_back(_name + ".Est.E.vy");
-  ret.push_back(_name + ".Est.E.vz");
-  ret.push_back(_name + ".Est.E.yaw");
-  ret.push_back(_name + ".Est.E.pitch");
-  ret.push_back(_name + ".Est.E.roll");
-
-  ret.push_back(_name + ".Est.E.pos");
-  ret.push_back(_name + ".Est.E.vel");
-
-  ret.push_back(_name + ".Est.E.maxEuler");
-
-  ret.push_back(_name + ".Est.D.covCond");
+  AddField(_name + ".Est.roll", &rollEst);
+  AddField(_name + ".Est.pitch", &pitchEst);
+
+  AddField(_name + ".Est.x", &ekfState(0));
+  AddField(_name + ".Est.y", &ekfState(1));
+  AddField(_name + ".Est.z", &ekfState(2));
+  AddField(_name + ".Est.vx", &ekfState(3));
+  AddField(_name + ".Est.vy", &ekfState(4));
+  AddField(_name + ".Est.vz", &ekfState(5));
+  AddField(_name + ".Est.yaw", &ekfState(6));
+
+  AddField(_name + ".Est.S.x", [this]() { return sqrtf(ekfCov(0, 0)); });
+  AddField(_name + ".Est.S.y", [this]() { return sqrtf(ekfCov(1, 1)); });
+  AddField(_name + ".Est.S.z", [this]() { return sqrtf(ekfCov(2, 2)); });
+  AddField(_name + ".Est.S.vx", [this]() { return sqrtf(ekfCov(3, 3)); });
+  AddField(_name + ".Est.S.vy", [this]() { return sqrtf(ekfCov(4, 4)); });
+  AddField(_name + ".Est.S.vz", [this]() { return sqrtf(ekfCov(5, 5)); });
+  AddField(_name + ".Est.S.yaw", [this]() { return sqrtf(ekfCov(6, 6)); });
+
+  AddField(_name + ".Est.E.x", &trueError(0));
+  AddField(_name + ".Est.E.y", &trueError(1));
+  AddField(_name + ".Est.E.z", &trueError(2));
+  AddField(_name + ".Est.E.vx", &trueError(3));
+  AddField(_name + ".Est.E.vy", &trueError(4));
+  AddField(_name + ".Est.E.vz", &trueError(5));
+  AddField(_name + ".Est.E.yaw", &trueError(6));
+  AddField(_name + ".Est.E.pitch", &pitchErr);
+  AddField(_name + ".Est.E.roll", &rollErr);
+
+  AddField(_name + ".Est.E.pos", &posErrorMag);
+  AddField(_name + ".Est.E.vel", &velErrorMag);
+
+  AddField(_name + ".Est.E.maxEuler", &maxEuler);
+
+  AddField(_name + ".Est.D.covCond", [this]() { return CovConditionNumber(); });
 
   // diagnostic variables
-  ret.push_back(_name + ".Est.D.AccelPitch");
-  ret.push_back(_name + ".Est.D.AccelRoll");
-  ret.push_back(_name + ".Est.D.ax_g");
-  ret.push_back(_name + ".Est.D.ay_g");
-  ret.push_back(_name + ".Est.D.az_g");
-  return ret;
-};
+  AddField(_name + ".Est.D.AccelPitch", &accelPitch);
+  AddField(_name + ".Est.D.AccelRoll", &accelRoll);
+  AddField(_name + ".Est.D.ax_g", &accelG.x);
+  AddField(_name + ".Est.D.ay_g", &accelG.y);
+  AddField(_name + ".Est.D.az_g", &accelG.z);
+}
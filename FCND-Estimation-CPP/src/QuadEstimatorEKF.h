@@ -16,6 +16,23 @@ using Eigen::VectorXf;
 class QuadEstimatorEKF : public BaseQuadEstimator
 {
 public:
+  static const int QUAD_EKF_NUM_STATES = 7;
+
+  // the filter's matrices are all fixed-size, so they live inside the object
+  // (or on the stack) and a predict/update step never touches the heap
+  typedef Eigen::Matrix<float, QUAD_EKF_NUM_STATES, 1> StateVector;
+  typedef Eigen::Matrix<float, QUAD_EKF_NUM_STATES, QUAD_EKF_NUM_STATES> StateMatrix;
+  template<int M> using MeasVector = Eigen::Matrix<float, M, 1>;
+  template<int M> using MeasMatrix = Eigen::Matrix<float, M, M>;
+  template<int M> using MeasJacobian = Eigen::Matrix<float, M, QUAD_EKF_NUM_STATES>;
+
+  // how a sensor's measurements are folded in, set per sensor by
+  // GPSUpdateMode / MagUpdateMode in the estimator config:
+  //   Batch            - one update with the full measurement, inverts H*P*H'+R
+  //   Sequential       - one scalar update per measurement, no inversion. needs diagonal R
+  //   SequentialJoseph - Sequential, with the covariance in Joseph form
+  enum UpdateMode { UPDATE_BATCH, UPDATE_SEQUENTIAL, UPDATE_SEQUENTIAL_JOSEPH };
+
   QuadEstimatorEKF(string config, string name);
   virtual ~QuadEstimatorEKF();
 
@@ -24,24 +41,41 @@ public:
   virtual void Predict(float dt, V3F accel, V3F gyro);
 
   // helper functions for Predict
-  VectorXf PredictState(VectorXf curState, float dt, V3F accel, V3F gyro);
-  MatrixXf GetRbgPrime(float roll, float pitch, float yaw);
+  StateVector PredictState(const StateVector& curState, float dt, V3F accel, V3F gyro);
+  Eigen::Matrix3f GetRbgPrime(float roll, float pitch, float yaw);
+  // row i of gPrime's velocity-from-yaw column, from rbgPrime = GetRbgPrime(...)(i, 0)
+  // as Predict takes it. QuadEstimatorEKFBatch uses it too, so the two stay identical
+  static inline float GPrimeYaw(float rbgPrime, V3F accel, float dt)
+  {
+    return (rbgPrime * accel).sum() * dt;
+  }
+  // ekfCov = gPrime * ekfCov * gPrime' + Q for the sparse gPrime of Predict,
+  // gPrimeYaw being its column 6 (velocity rows). only the upper triangle is computed
+  void PredictCovariance(float dt, const float gPrimeYaw[3]);
 
   virtual void UpdateFromIMU(V3F accel, V3F gyro);
   virtual void UpdateFromGPS(V3F pos, V3F vel);
   virtual void UpdateFromBaro(float z) {};
 	virtual void UpdateFromMag(float magYaw);
 
-  static const int QUAD_EKF_NUM_STATES = 7;
-
   // process covariance
-	MatrixXf Q;
+	StateMatrix Q;
 
 	// GPS measurement covariance
-	MatrixXf R_GPS;
+	MeasMatrix<6> R_GPS;
 
 	// Magnetometer measurement covariance
-	MatrixXf R_Mag;
+	MeasMatrix<1> R_Mag;
+
+	UpdateMode gpsUpdateMode, magUpdateMode;
+
+  // the std deviation parameters of the config that make up Q, R_GPS and R_Mag
+  static const int NUM_NOISE_PARAMS = 10;
+  static const char* const NOISE_PARAMS[NUM_NOISE_PARAMS];
+
+  // sets one of NOISE_PARAMS (not case-sensitive) the way Init() reads it from the config,
+  // e.g. for tuning. false if there is no such parameter
+  bool SetNoiseParam(const string& name, float stdDev);
 
   // attitude filter state
   float pitchEst, rollEst;
@@ -49,29 +83,38 @@ public:
 	V3F accelG;
 	V3F lastGyro;
 
-  // generic EKF update
+  // generic EKF update for an M-dimensional measurement
   // z: measurement
   // H: Jacobian of observation function evaluated at the current estimated state
   // R: observation error model covariance 
   // zFromX: measurement prediction based on current state
-  void Update(VectorXf& z, MatrixXf& H, MatrixXf& R, VectorXf& zFromX);
+  // mode: see UpdateMode
+  template<int M>
+  void Update(const MeasVector<M>& z, const MeasJacobian<M>& H, const MeasMatrix<M>& R, const MeasVector<M>& zFromX,
+    UpdateMode mode = UPDATE_BATCH);
+
+  // update with one scalar measurement, observation row h, variance r and innovation y.
+  // O(n^2): the covariance changes by a rank-1 term
+  void ScalarUpdate(const Eigen::Matrix<float, 1, QUAD_EKF_NUM_STATES>& h, float r, float y, bool joseph);
+
+  // copies the upper triangle of ekfCov onto the lower one
+  void SymmetrizeCov();
 
   // EKF state and covariance
-	VectorXf ekfState;
-	MatrixXf ekfCov;
+	StateVector ekfState;
+	StateMatrix ekfCov;
 
   // params
   float attitudeTau;
   float dtIMU;
 
-  // Access functions for graphing variables
-  virtual bool GetData(const string& name, float& ret) const;
-  virtual vector<string> GetFields() const;
+  // publishes the graphing variables
+  void AddFields();
   string _name;
 
 	// error vs ground truth (trueError = estimated-actual)
 	virtual void UpdateTrueError(V3F truePos, V3F trueVel, SLR::Quaternion<float> trueAtt);
-	VectorXf trueError;
+	StateVector trueError;
 	float pitchErr, rollErr, maxEuler;
 
 	float posErrorMag, velErrorMag;
@@ -96,5 +139,17 @@ public:
 		return lastGyro;
 	}
 
+	virtual bool GetStateVariances(float var[7])
+	{
+		for (int i = 0; i < 7; i++) var[i] = ekfCov(i, i);
+		return true;
+	}
+
 	float CovConditionNumber() const;
+
+	virtual void SaveState(SLR::StateBuffer& s);
+	virtual bool LoadState(SLR::StateBuffer& s);
+
+	// R_GPS is a 16-byte multiple, which Eigen vectorizes and needs aligned
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 };
@@ -0,0 +1,295 @@
+#include "Common.h"
+#include "QuadEstimatorEKFBatch.h"
+
+const int QuadEstimatorEKFBatch::BLOCK;
+const int QuadEstimatorEKFBatch::N;
+const int QuadEstimatorEKFBatch::NUM_COV;
+
+QuadEstimatorEKFBatch::QuadEstimatorEKFBatch(int numLanes)
+{
+  _numLanes = numLanes;
+  _capacity = (numLanes + BLOCK - 1) / BLOCK * BLOCK;
+  _numStaged = 0;
+  _firstStaged = _capacity;
+  _lastStaged = -1;
+  _status.assign(_capacity, LANE_IDLE);
+
+  // lanes that were never staged are predicted along with the rest, keep them finite
+  _state.assign(N * _capacity, 0.f);
+  _predState.assign(N * _capacity, 0.f);
+  _cov.assign(NUM_COV * _capacity, 0.f);
+  _predCov.assign(NUM_COV * _capacity, 0.f);
+  _inputs.assign(NUM_INPUTS * _capacity, 0.f);
+}
+
+void QuadEstimatorEKFBatch::Stage(int lane, const QuadEstimatorEKF& ekf, float dt, V3F accel)
+{
+  for (int i = 0; i < N; i++)
+  {
+    Lanes(_state, i)[lane] = ekf.ekfState(i);
+    Lanes(_inputs, INPUT_Q + i)[lane] = ekf.Q(i, i);
+    for (int j = i; j < N; j++)
+    {
+      Lanes(_cov, CovIndex(i, j))[lane] = ekf.ekfCov(i, j);
+    }
+  }
+  Lanes(_inputs, INPUT_ROLL)[lane] = ekf.rollEst;
+  Lanes(_inputs, INPUT_PITCH)[lane] = ekf.pitchEst;
+  Lanes(_inputs, INPUT_DT)[lane] = dt;
+  Lanes(_inputs, INPUT_AX)[lane] = accel.x;
+  Lanes(_inputs, INPUT_AY)[lane] = accel.y;
+  Lanes(_inputs, INPUT_AZ)[lane] = accel.z;
+
+  if (_status[lane] != LANE_STAGED) _numStaged++;
+  _status[lane] = LANE_STAGED;
+  _firstStaged = MIN(_firstStaged, lane);
+  _lastStaged = MAX(_lastStaged, lane);
+}
+
+void QuadEstimatorEKFBatch::Unstage(int lane)
+{
+  if (_status[lane] == LANE_STAGED) _numStaged--;
+  _status[lane] = LANE_IDLE;
+}
+
+void QuadEstimatorEKFBatch::Collect(int lane, QuadEstimatorEKF::StateVector& state, QuadEstimatorEKF::StateMatrix& cov)
+{
+  for (int i = 0; i < N; i++)
+  {
+    state(i) = Lanes(_predState, i)[lane];
+    for (int j = i; j < N; j++)
+    {
+      cov(i, j) = cov(j, i) = Lanes(_predCov, CovIndex(i, j))[lane];
+    }
+  }
+  _status[lane] = LANE_IDLE;
+}
+
+void QuadEstimatorEKFBatch::Flush()
+{
+  if (_numStaged == 0) return;
+
+  for (int first = _firstStaged / BLOCK * BLOCK; first <= _lastStaged; first += BLOCK)
+  {
+    bool anyStaged = false;
+    for (int l = first; l < first + BLOCK; l++)
+    {
+      if (_status[l] == LANE_STAGED)
+      {
+        anyStaged = true;
+        _status[l] = LANE_PREDICTED;
+      }
+    }
+    if (anyStaged)
+    {
+      PredictBlock(first);
+    }
+  }
+  _numStaged = 0;
+  _firstStaged = _capacity;
+  _lastStaged = -1;
+}
+
+// all loops over l have BLOCK iterations and only touch local arrays, which is
+// what the compiler needs to vectorize them without -O3
+void QuadEstimatorEKFBatch::PredictBlock(int first)
+{
+  float in[NUM_INPUTS][BLOCK], x[N][BLOCK], P[NUM_COV][BLOCK];
+  for (int k = 0; k < NUM_INPUTS; k++) memcpy(in[k], Lanes(_inputs, k) + first, sizeof(in[k]));
+  for (int k = 0; k < N; k++) memcpy(x[k], Lanes(_state, k) + first, sizeof(x[k]));
+  for (int k = 0; k < NUM_COV; k++) memcpy(P[k], Lanes(_cov, k) + first, sizeof(P[k]));
+
+  const float* dt = in[INPUT_DT];
+  const float* ax = in[INPUT_AX];
+  const float* ay = in[INPUT_AY];
+  const float* az = in[INPUT_AZ];
+
+  // trig first, with libm, so results match QuadEstimatorEKF exactly
+  float cr[BLOCK], sr[BLOCK], cp[BLOCK], sp[BLOCK], cy[BLOCK], sy[BLOCK];
+  float cPitch[BLOCK], cYaw[BLOCK], sYaw[BLOCK];
+  for (int l = 0; l < BLOCK; l++)
+  {
+    cr[l] = cosf(in[INPUT_ROLL][l] / 2.f); sr[l] = sinf(in[INPUT_ROLL][l] / 2.f);
+    cp[l] = cosf(in[INPUT_PITCH][l] / 2.f); sp[l] = sinf(in[INPUT_PITCH][l] / 2.f);
+    cy[l] = cosf(x[6][l] / 2.f); sy[l] = sinf(x[6][l] / 2.f);
+    cPitch[l] = cosf(in[INPUT_PITCH][l]);
+    cYaw[l] = cosf(x[6][l]); sYaw[l] = sinf(x[6][l]);
+  }
+
+  // state: PredictState, with the attitude quaternion of Quaternion::FromEuler123_RPY
+  // and the rotation of Quaternion::Rotate_BtoI, term by term
+  float gYaw[3][BLOCK];
+  for (int l = 0; l < BLOCK; l++)
+  {
+    float q0 = cr[l] * cp[l] * cy[l] + sr[l] * sp[l] * sy[l];
+    float q1 = -cr[l] * sp[l] * sy[l] + cp[l] * cy[l] * sr[l];
+    float q2 = cr[l] * cy[l] * sp[l] + sr[l] * cp[l] * sy[l];
+    float q3 = cr[l] * cp[l] * sy[l] - sr[l] * cy[l] * sp[l];
+
+    float a0 = -q0;
+    float r0 = a0 * a0, r1 = q1 * q1, r2 = q2 * q2, r3 = q3 * q3;
+    float accX = (r0 + r1 - r2 - r3) * ax[l] + (2 * q1*q2 + 2 * a0*q3) * ay[l] + (2 * q1*q3 - 2 * a0*q2) * az[l];
+    float accY = (2 * q1*q2 - 2 * a0*q3) * ax[l] + (r0 - r1 + r2 - r3) * ay[l] + (2 * q2*q3 + 2 * a0*q1) * az[l];
+    float accZ = (2 * q1*q3 + 2 * a0*q2) * ax[l] + (2 * q2*q3 - 2 * a0*q1) * ay[l] + (r0 - r1 - r2 + r3) * az[l];
+
+    x[0][l] = x[0][l] + x[3][l] * dt[l];
+    x[1][l] = x[1][l] + x[4][l] * dt[l];
+    x[2][l] = x[2][l] + x[5][l] * dt[l];
+    x[3][l] = x[3][l] + accX * dt[l];
+    x[4][l] = x[4][l] + accY * dt[l];
+    x[5][l] = x[5][l] + accZ * dt[l];
+
+    // gPrime's yaw column, from column 0 of GetRbgPrime as in Predict
+    V3F accel(ax[l], ay[l], az[l]);
+    gYaw[0][l] = QuadEstimatorEKF::GPrimeYaw(-cPitch[l] * sYaw[l], accel, dt[l]);
+    gYaw[1][l] = QuadEstimatorEKF::GPrimeYaw(cPitch[l] * cYaw[l], accel, dt[l]);
+    gYaw[2][l] = QuadEstimatorEKF::GPrimeYaw(0.f, accel, dt[l]);
+  }
+
+  // covariance: PredictCovariance, A = gPrime * P, then P = A * gPrime' + Q (upper triangle).
+  // rows 0..5 of A; row 6 is row 6 of P
+  float A[6][N][BLOCK];
+  for (int i = 0; i < 3; i++)
+  {
+    for (int j = 0; j < N; j++)
+    {
+      const float* Pij = P[CovIndex(MIN(i, j), MAX(i, j))];
+      const float* Pi3j = P[CovIndex(MIN(i + 3, j), MAX(i + 3, j))];
+      const float* P6j = P[CovIndex(j, 6)];
+      for (int l = 0; l < BLOCK; l++)
+      {
+        A[i][j][l] = Pij[l] + dt[l] * Pi3j[l];
+        A[i + 3][j][l] = Pi3j[l] + gYaw[i][l] * P6j[l];
+      }
+    }
+  }
+
+  float out[NUM_COV][BLOCK];
+  for (int i = 0; i < N; i++)
+  {
+    const float* Ai6 = i < 6 ? A[i][6] : P[CovIndex(6, 6)];
+    for (int j = i; j < N; j++)
+    {
+      float* o = out[CovIndex(i, j)];
+      if (j < 3)
+      {
+        const float* Aij = i < 6 ? A[i][j] : P[CovIndex(j, 6)];
+        const float* Aij3 = i < 6 ? A[i][j + 3] : P[CovIndex(j + 3, 6)];
+        for (int l = 0; l < BLOCK; l++) o[l] = Aij[l] + dt[l] * Aij3[l];
+      }
+      else if (j < 6)
+      {
+        const float* Aij = i < 6 ? A[i][j] : P[CovIndex(j, 6)];
+        for (int l = 0; l < BLOCK; l++) o[l] = Aij[l] + gYaw[j - 3][l] * Ai6[l];
+      }
+      else
+      {
+        for (int l = 0; l < BLOCK; l++) o[l] = Ai6[l];
+      }
+    }
+
+    // Q is diagonal
+    float* o = out[CovIndex(i, i)];
+    for (int l = 0; l < BLOCK; l++) o[l] += in[INPUT_Q + i][l];
+  }
+
+  for (int k = 0; k < N; k++) memcpy(Lanes(_predState, k) + first, x[k], sizeof(x[k]));
+  for (int k = 0; k < NUM_COV; k++) memcpy(Lanes(_predCov, k) + first, out[k], sizeof(out[k]));
+}
+
+QuadEstimatorEKFLane::QuadEstimatorEKFLane(string config, string name, shared_ptr<QuadEstimatorEKFBatch> batch, int lane)
+  : QuadEstimatorEKF(config, name), _batch(batch), _lane(lane)
+{
+  _batch->Unstage(_lane);
+  _stagedDt = 0;
+}
+
+void QuadEstimatorEKFLane::Predict(float dt, V3F accel, V3F gyro)
+{
+  FinishPredict();
+  _batch->Stage(_lane, *this, dt, accel);
+  _stagedDt = dt;
+  _stagedAccel = accel;
+  _stagedGyro = gyro;
+}
+
+void QuadEstimatorEKFLane::FinishPredict()
+{
+  if (_batch->IsPredicted(_lane))
+  {
+    _batch->Collect(_lane, ekfState, ekfCov);
+  }
+  else if (_batch->IsStaged(_lane))
+  {
+    _batch->Unstage(_lane);
+    QuadEstimatorEKF::Predict(_stagedDt, _stagedAccel, _stagedGyro);
+  }
+}
+
+void QuadEstimatorEKFLane::UpdateFromIMU(V3F accel, V3F gyro)
+{
+  FinishPredict();
+  QuadEstimatorEKF::UpdateFromIMU(accel, gyro);
+}
+
+void QuadEstimatorEKFLane::UpdateFromGPS(V3F pos, V3F vel)
+{
+  FinishPredict();
+  QuadEstimatorEKF::UpdateFromGPS(pos, vel);
+}
+
+void QuadEstimatorEKFLane::UpdateFromMag(float magYaw)
+{
+  FinishPredict();
+  QuadEstimatorEKF::UpdateFromMag(magYaw);
+}
+
+// QuadDynamics calls this on every controller update, after the sensors and predictions
+// due by then, so a staged prediction is always collected before anything graphs the estimator
+void QuadEstimatorEKFLane::UpdateTrueError(V3F truePos, V3F trueVel, SLR::Quaternion<float> trueAtt)
+{
+  FinishPredict();
+  QuadEstimatorEKF::UpdateTrueError(truePos, trueVel, trueAtt);
+}
+
+V3F QuadEstimatorEKFLane::EstimatedPosition()
+{
+  FinishPredict();
+  return QuadEstimatorEKF::EstimatedPosition();
+}
+
+V3F QuadEstimatorEKFLane::EstimatedVelocity()
+{
+  FinishPredict();
+  return QuadEstimatorEKF::EstimatedVelocity();
+}
+
+Quaternion<float> QuadEstimatorEKFLane::EstimatedAttitude()
+{
+  FinishPredict();
+  return QuadEstimatorEKF::EstimatedAttitude();
+}
+
+V3F QuadEstimatorEKFLane::EstimatedOmega()
+{
+  FinishPredict();
+  return QuadEstimatorEKF::EstimatedOmega();
+}
+
+bool QuadEstimatorEKFLane::GetStateVariances(float var[7])
+{
+  FinishPredict();
+  return QuadEstimatorEKF::GetStateVariances(var);
+}
+
+void QuadEstimatorEKFLane::SaveState(SLR::StateBuffer& s)
+{
+  FinishPredict();
+  QuadEstimatorEKF::SaveState(s);
+}
+
+bool QuadEstimatorEKFLane::LoadState(SLR::StateBuffer& s)
+{
+  _batch->Unstage(_lane);
+  return QuadEstimatorEKF::LoadState(s);
+}
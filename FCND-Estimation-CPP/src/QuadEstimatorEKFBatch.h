@@ -0,0 +1,105 @@
+#pragma once
+
+#include "QuadEstimatorEKF.h"
+#include <vector>
+
+// Runs QuadEstimatorEKF::Predict for many vehicles in one pass.
+// Each vehicle owns a lane. Its estimator (a QuadEstimatorEKFLane) stages the
+// filter and the Predict() inputs in the lane, and Flush() predicts all staged lanes
+// together. Lanes are stored structure-of-arrays, component k of lane l at
+// [k * capacity + l], and are predicted in blocks of 8, every step of the prediction
+// one loop over the block that the compiler turns into vector instructions
+// (the whole block per instruction with AVX2, half of it with SSE).
+// Not thread-safe: stage, flush and collect from one thread.
+class QuadEstimatorEKFBatch
+{
+public:
+  // lanes are predicted in blocks of this many
+  static const int BLOCK = 8;
+
+  QuadEstimatorEKFBatch(int numLanes);
+
+  int NumLanes() const { return _numLanes; }
+
+  // copies the filter's state, covariance, Q and attitude estimate into the lane,
+  // to be predicted forward by dt with accel at the next Flush()
+  void Stage(int lane, const QuadEstimatorEKF& ekf, float dt, V3F accel);
+  bool IsStaged(int lane) const { return _status[lane] == LANE_STAGED; }
+  bool IsPredicted(int lane) const { return _status[lane] == LANE_PREDICTED; }
+
+  // drops a staged lane, if its owner predicted it by itself after all
+  void Unstage(int lane);
+
+  // copies a predicted lane's state and covariance out and frees the lane
+  void Collect(int lane, QuadEstimatorEKF::StateVector& state, QuadEstimatorEKF::StateMatrix& cov);
+
+  // predicts every staged lane. same math as QuadEstimatorEKF::Predict
+  void Flush();
+
+protected:
+  enum { LANE_IDLE, LANE_STAGED, LANE_PREDICTED };
+
+  static const int N = QuadEstimatorEKF::QUAD_EKF_NUM_STATES;
+  static const int NUM_COV = N * (N + 1) / 2; // upper triangle
+
+  // index of element (i, j), i <= j, in the row-wise packed upper triangle
+  static int CovIndex(int i, int j) { return i * N - i * (i - 1) / 2 + (j - i); }
+
+  // component k of all lanes
+  float* Lanes(std::vector<float>& v, int k) { return &v[k * _capacity]; }
+
+  // predicts lanes first..first+BLOCK-1
+  void PredictBlock(int first);
+
+  int _numLanes, _capacity, _numStaged;
+  int _firstStaged, _lastStaged; // the lanes staged since the last Flush() are in between
+  std::vector<unsigned char> _status;
+
+  // staged filters and their predictions. Flush() predicts whole blocks, the
+  // result only depends on what was staged, so a lane that was predicted and not
+  // collected yet comes out the same
+  std::vector<float> _state, _predState; // N components
+  std::vector<float> _cov, _predCov;     // NUM_COV components
+  std::vector<float> _inputs;            // NUM_INPUTS components
+  enum { INPUT_ROLL, INPUT_PITCH, INPUT_DT, INPUT_AX, INPUT_AY, INPUT_AZ, INPUT_Q, NUM_INPUTS = INPUT_Q + N };
+};
+
+// A QuadEstimatorEKF whose Predict() runs in a QuadEstimatorEKFBatch.
+// Predict() only stages the prediction. The next call that needs the result
+// collects it from the batch, or runs the prediction itself if the batch
+// hasn't been flushed yet, so results don't depend on when (or whether)
+// the batch gets flushed.
+class QuadEstimatorEKFLane : public QuadEstimatorEKF
+{
+public:
+  QuadEstimatorEKFLane(string config, string name, shared_ptr<QuadEstimatorEKFBatch> batch, int lane);
+
+  virtual void Predict(float dt, V3F accel, V3F gyro);
+
+  virtual void UpdateFromIMU(V3F accel, V3F gyro);
+  virtual void UpdateFromGPS(V3F pos, V3F vel);
+  virtual void UpdateFromMag(float magYaw);
+
+  virtual void UpdateTrueError(V3F truePos, V3F trueVel, SLR::Quaternion<float> trueAtt);
+
+  virtual V3F EstimatedPosition();
+  virtual V3F EstimatedVelocity();
+  virtual Quaternion<float> EstimatedAttitude();
+  virtual V3F EstimatedOmega();
+  virtual bool GetStateVariances(float var[7]);
+
+  // with the staged prediction completed. LoadState() drops it
+  virtual void SaveState(SLR::StateBuffer& s);
+  virtual bool LoadState(SLR::StateBuffer& s);
+
+protected:
+  // completes a staged Predict()
+  void FinishPredict();
+
+  shared_ptr<QuadEstimatorEKFBatch> _batch;
+  int _lane;
+
+  // the staged Predict() call, for running it here if needed before the batch is flushed
+  float _stagedDt;
+  V3F _stagedAccel, _stagedGyro;
+};
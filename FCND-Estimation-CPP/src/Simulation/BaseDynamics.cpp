@@ -17,15 +17,17 @@ BaseDynamics::BaseDynamics(string name)
 {
   _name = name;
   Initialize();
+  AddFields();
 }
 
 int BaseDynamics::Initialize()
 {
   ParamsHandle config = SimpleConfig::GetInstance();
+  static const ConfigKey xBoundsKey("Sim.xBounds"), yBoundsKey("Sim.yBounds"), zBoundsKey("Sim.zBounds");
 
   // load in BaseDynamics-specific double-valued settings from the config in your inheritor
 	vector<float> tmp;
-	if (config->GetFloatVector("Sim.xBounds",tmp))
+	if (config->GetFloatVector(xBoundsKey, tmp))
 	{
 		xMin = tmp[0];
 		xMax = tmp[1];
@@ -36,7 +38,7 @@ int BaseDynamics::Initialize()
 		xMax = 10;
 	}
 
-	if (config->GetFloatVector("Sim.yBounds", tmp))
+	if (config->GetFloatVector(yBoundsKey, tmp))
 	{
 		yMin = tmp[0];
 		yMax = tmp[1];
@@ -47,7 +49,7 @@ int BaseDynamics::Initialize()
 		yMax = 10;
 	}
 
-	if (config->GetFloatVector("Sim.zBounds", tmp))
+	if (config->GetFloatVector(zBoundsKey, tmp))
 	{
 		zMin = tmp[0];
 		zMax = tmp[1];
@@ -70,6 +72,9 @@ void BaseDynamics::ResetState(V3F newPos, V3F newVel, Quaternion<float> newAtt,
   pos = newPos;
   vel = newVel;
   quat = newAtt;
+  // nothing has accelerated the vehicle yet. (otherwise the first IMU sample
+  // after a reset would see the previous run's last acceleration)
+  acc = V3F();
 }
 
 GlobalPose BaseDynamics::GenerateGP(void)
@@ -80,51 +85,49 @@ GlobalPose BaseDynamics::GenerateGP(void)
   return p;
 }
 
-bool BaseDynamics::GetData(const string& name, float& ret) const
+void BaseDynamics::SaveState(StateBuffer& s)
 {
-  if (name.find_first_of(".") == string::npos) return false;
-  string leftPart = LeftOf(name, '.');
-  string rightPart = RightOf(name, '.');
-  if (ToUpper(leftPart) == ToUpper(_name))
-  {
-#define GETTER_HELPER(A,B) if (SLR::ToUpper(rightPart) == SLR::ToUpper(A)){ ret=(B); return true; }
-    GETTER_HELPER("POS.X", pos.x);
-    GETTER_HELPER("POS.Y", pos.y);
-    GETTER_HELPER("POS.Z", pos.z);
-    GETTER_HELPER("VEL.X", vel.x);
-    GETTER_HELPER("VEL.Y", vel.y);
-    GETTER_HELPER("VEL.Z", vel.z);
-    GETTER_HELPER("YAW", quat.ToEulerYPR()[0]);
-    GETTER_HELPER("PITCH", quat.ToEulerYPR()[1]);
-    GETTER_HELPER("ROLL", quat.ToEulerYPR()[2]);
-    GETTER_HELPER("OMEGA.X", omega.x);
-    GETTER_HELPER("OMEGA.Y", omega.y);
-    GETTER_HELPER("OMEGA.Z", omega.z);
-		GETTER_HELPER("ACC.X", acc.x);
-		GETTER_HELPER("ACC.Y", acc.y);
-		GETTER_HELPER("ACC.Z", acc.z);
-#undef GETTER_HELPER
-  }
-  return false;
+  s.Put(pos);
+  s.Put(vel);
+  s.Put(acc);
+  s.Put(omega);
+  s.Put(old_omega);
+  s.Put(quat);
+  s.Put(_lastTrajPointTime);
 }
 
-vector<string> BaseDynamics::GetFields() const
+bool BaseDynamics::LoadState(StateBuffer& s)
 {
-  vector<string> ret;
-  ret.push_back(_name + ".Pos.X");
-  ret.push_back(_name + ".Pos.Y");
-  ret.push_back(_name + ".Pos.Z");
-  ret.push_back(_name + ".Vel.X");
-  ret.push_back(_name + ".Vel.Y");
-  ret.push_back(_name + ".Vel.Z");
-  ret.push_back(_name + ".Yaw");
-  ret.push_back(_name + ".Pitch");
-  ret.push_back(_name + ".Roll");
-  ret.push_back(_name + ".Omega.X");
-  ret.push_back(_name + ".Omega.Y");
-  ret.push_back(_name + ".Omega.Z");
-	ret.push_back(_name + ".Acc.X");
-	ret.push_back(_name + ".Acc.Y");
-	ret.push_back(_name + ".Acc.Z");
-  return ret;
+  s.Get(pos);
+  s.Get(vel);
+  s.Get(acc);
+  s.Get(omega);
+  s.Get(old_omega);
+  s.Get(quat);
+  s.Get(_lastTrajPointTime);
+
+  // the trail behind it is the one of the flight before
+  _followedPos.reset();
+  _followedAtt.reset();
+  return !s.Failed();
+}
+
+// Graphing variables, published once
+void BaseDynamics::AddFields()
+{
+  AddField(_name + ".Pos.X", &pos.x);
+  AddField(_name + ".Pos.Y", &pos.y);
+  AddField(_name + ".Pos.Z", &pos.z);
+  AddField(_name + ".Vel.X", &vel.x);
+  AddField(_name + ".Vel.Y", &vel.y);
+  AddField(_name + ".Vel.Z", &vel.z);
+  AddField(_name + ".Yaw", [this]() { return quat.ToEulerYPR()[0]; });
+  AddField(_name + ".Pitch", [this]() { return quat.ToEulerYPR()[1]; });
+  AddField(_name + ".Roll", [this]() { return quat.ToEulerYPR()[2]; });
+  AddField(_name + ".Omega.X", &omega.x);
+  AddField(_name + ".Omega.Y", &omega.y);
+  AddField(_name + ".Omega.Z", &omega.z);
+	AddField(_name + ".Acc.X", &acc.x);
+	AddField(_name + ".Acc.Y", &acc.y);
+	AddField(_name + ".Acc.Z", &acc.z);
 }
@@ -5,6 +5,7 @@
 #include "VehicleDatatypes.h"
 #include "DataSource.h"
 #include "Utility/FixedQueue.h"
+#include "Utility/StateBuffer.h"
 
 #ifdef _MSC_VER
 #pragma warning(push)
@@ -22,7 +23,7 @@ public:
 
 	virtual int Initialize();
 
-  virtual void Run(float dt, float simulationTime, int &idum,  // updates the simulation
+  virtual void Run(float dt, float simulationTime,  // updates the simulation
     V3F externalForceInGlobalFrame = V3F(),    // required to take net forces into account
     V3F externalMomentInBodyFrame = V3F())   // required to take net moments into account
   {}
@@ -43,8 +44,14 @@ public:
   void SetOmega(const V3F& o) { omega = o; }
 	void SetAttitude(const Quaternion<float>& q){quat = q;}
 
-  virtual bool GetData(const string& name, float& ret) const;
-  virtual vector<string> GetFields() const;  
+  // publishes the graphing variables
+  void AddFields();
+
+  // the state that changes while simulating, for snapshots (see Simulator::SaveSnapshot).
+  // LoadState() reads what SaveState() wrote and leaves the parameters as they are,
+  // false if s doesn't hold such a state
+  virtual void SaveState(SLR::StateBuffer& s);
+  virtual bool LoadState(SLR::StateBuffer& s);
 
 	virtual double GetRotDistInt() { return 0;};
 	virtual double GetXyzDistInt() {return 0;};
@@ -54,6 +61,8 @@ public:
 
   void ResetState(V3F pos=V3F(), V3F vel=V3F(), Quaternion<float> att=Quaternion<float>(), V3F omega=V3F());
 
+  const string& GetName() const { return _name; }
+
 	FixedQueue<V3F> _followedPos;
 	FixedQueue<Quaternion<float>> _followedAtt;
 
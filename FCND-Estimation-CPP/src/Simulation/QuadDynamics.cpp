@@ -8,20 +8,27 @@
 #include "ControllerFactory.h"
 
 #include "QuadEstimatorEKF.h"
+#include "QuadEstimatorEKFBatch.h"
+#include "QuadDynamicsBatch.h"
 #include "SimulatedGPS.h"
 #include "SimulatedIMU.h"
 #include "SimulatedMag.h"
+#include "SensorRecording.h"
 
 #ifdef _MSC_VER //  visual studio
 #pragma warning(disable: 4267 4244 4996)
 #endif
 
-#define ONBOARD_TS 0.002 // Controller update dt in [s]. TODO AS PARAM!
-
 QuadDynamics::QuadDynamics(string name) 
  : BaseDynamics(name)
 {
+  _estimatorLane = -1;
+  _dynamicsLane = -1;
+  _dynamicsStaged = false;
+  _dynamicsModelSet = false;
+  _controllerTask = 0;
   Initialize();
+  AddFields();
 }
 
 void QuadDynamics::Reset()
@@ -30,12 +37,106 @@ void QuadDynamics::Reset()
   Initialize();
 }
 
+void QuadDynamics::SeedRandomStreams(uint64_t key)
+{
+  _rng.Seed(key, 0);
+  for (unsigned int i = 0; i < sensors.size(); i++)
+  {
+    sensors[i]->_rng.Seed(key, i + 1);
+  }
+}
+
+void QuadDynamics::SaveState(StateBuffer& s)
+{
+  BaseDynamics::SaveState(s);
+  for (int i = 0; i < 4; i++)
+  {
+    s.Put(motorCmdsN(i));
+    s.Put(motorCmdsOld(i));
+  }
+  s.Put(curCmd);
+  s.Put(xyzDisturbance);
+  s.Put(rotDisturbance);
+  s.Put(_lastPosFollowErr);
+  s.Put(_rng);
+
+  vector<int64_t> counts;
+  _events.GetCounts(counts);
+  s.Put(_time);
+  s.Put((uint32_t)counts.size());
+  s.PutArray(counts.data(), (int)counts.size());
+
+  // whether there is one, then its state
+  s.Put((uint8_t)(controller ? 1 : 0));
+  if (controller) controller->SaveState(s);
+  s.Put((uint8_t)(estimator ? 1 : 0));
+  if (estimator) estimator->SaveState(s);
+  s.Put((uint32_t)sensors.size());
+  for (unsigned int i = 0; i < sensors.size(); i++)
+  {
+    sensors[i]->SaveState(s);
+  }
+}
+
+bool QuadDynamics::LoadState(StateBuffer& s)
+{
+  BaseDynamics::LoadState(s);
+  for (int i = 0; i < 4; i++)
+  {
+    s.Get(motorCmdsN(i));
+    s.Get(motorCmdsOld(i));
+  }
+  s.Get(curCmd);
+  s.Get(xyzDisturbance);
+  s.Get(rotDisturbance);
+  s.Get(_lastPosFollowErr);
+  s.Get(_rng);
+
+  uint32_t numTasks = 0;
+  s.Get(_time);
+  s.Get(numTasks);
+  if (s.Failed() || numTasks != (uint32_t)_events.NumTasks()) return false;
+  vector<int64_t> counts(numTasks);
+  s.GetArray(counts.data(), (int)numTasks);
+  _events.Restart(counts);
+
+  uint8_t hasController = 0, hasEstimator = 0;
+  s.Get(hasController);
+  if (hasController != (controller ? 1 : 0) || (controller && !controller->LoadState(s))) return false;
+  s.Get(hasEstimator);
+  if (hasEstimator != (estimator ? 1 : 0) || (estimator && !estimator->LoadState(s))) return false;
+
+  uint32_t numSensors = 0;
+  s.Get(numSensors);
+  if (numSensors != (uint32_t)sensors.size()) return false;
+  for (unsigned int i = 0; i < sensors.size(); i++)
+  {
+    if (!sensors[i]->LoadState(s)) return false;
+  }
+  return !s.Failed();
+}
+
+void QuadDynamics::SetEstimatorBatch(shared_ptr<QuadEstimatorEKFBatch> batch, int lane)
+{
+  _estimatorBatch = batch;
+  _estimatorLane = batch ? lane : -1;
+}
+
+void QuadDynamics::SetDynamicsBatch(shared_ptr<QuadDynamicsBatch> batch, int lane)
+{
+  _dynamicsBatch = batch;
+  _dynamicsLane = batch ? lane : -1;
+  _dynamicsStaged = false;
+  _dynamicsModelSet = false;
+}
+
 void QuadDynamics::ResetState(V3F pos, V3F vel, Quaternion<float> att, V3F omega)
 {
   BaseDynamics::ResetState(pos,vel,att,omega);
 
-  controllerUpdateInterval = (double)ONBOARD_TS;
-  timeSinceLastControllerUpdate = controllerUpdateInterval; // Force the simulation to start with a controller update
+  // starts the sensors, estimator and controller over, the controller right away
+  _time = 0;
+  _events.Restart();
 
 	xyzDisturbance = rotDisturbance = V3D();
 }
@@ -71,11 +172,40 @@ int QuadDynamics::Initialize()
 
   kappa = config->Get(_name + ".kappa", 0.01f);
 
-  gyroNoiseInt = config->Get("Sim.gyroNoiseInt", 0.f);
-  rotDisturbanceInt = config->Get("Sim.rotDisturbanceInt", 0.f);
-  xyzDisturbanceInt = config->Get("Sim.xyzDisturbanceInt", 0.f);
-  rotDisturbanceBW = config->Get("Sim.rotDisturbanceBW", 0.f);
-  xyzDisturbanceBW = config->Get("Sim.xyzDisturbanceBW", 0.f);
+  // the same for every vehicle
+  static const ConfigKey gyroNoiseIntKey("Sim.gyroNoiseInt");
+  static const ConfigKey rotDisturbanceIntKey("Sim.rotDisturbanceInt"), xyzDisturbanceIntKey("Sim.xyzDisturbanceInt");
+  static const ConfigKey rotDisturbanceBWKey("Sim.rotDisturbanceBW"), xyzDisturbanceBWKey("Sim.xyzDisturbanceBW");
+  gyroNoiseInt = config->Get(gyroNoiseIntKey, 0.f);
+  rotDisturbanceInt = config->Get(rotDisturbanceIntKey, 0.f);
+  xyzDisturbanceInt = config->Get(xyzDisturbanceIntKey, 0.f);
+  rotDisturbanceBW = config->Get(rotDisturbanceBWKey, 0.f);
+  xyzDisturbanceBW = config->Get(xyzDisturbanceBWKey, 0.f);
+
+  static const ConfigKey integratorKey("Sim.Integrator"), attitudeIntegratorKey("Sim.AttitudeIntegrator");
+  string integrator = ToUpper(config->Get(integratorKey, "Euler"));
+  if (integrator == "SEMIIMPLICITEULER")
+  {
+    _integrator = INTEGRATOR_SEMI_IMPLICIT_EULER;
+  }
+  else if (integrator == "RK4")
+  {
+    _integrator = INTEGRATOR_RK4;
+  }
+  else
+  {
+    if (integrator != "EULER")
+    {
+      SLR_WARNING1("Unknown Sim.Integrator %s, using Euler", integrator.c_str());
+    }
+    _integrator = INTEGRATOR_EULER;
+  }
+  string attitudeIntegrator = ToUpper(config->Get(attitudeIntegratorKey, "Fast"));
+  if (attitudeIntegrator != "FAST" && attitudeIntegrator != "EXPMAP")
+  {
+    SLR_WARNING1("Unknown Sim.AttitudeIntegrator %s, using Fast", attitudeIntegrator.c_str());
+  }
+  _expMapAttitude = attitudeIntegrator == "EXPMAP";
 
   minMotorThrust = config->Get(_name + "minMotorThrust", .1f);
   maxMotorThrust = config->Get(_name + ".maxMotorThrust", 4.5f);
@@ -84,7 +214,25 @@ int QuadDynamics::Initialize()
 
   _trajLogStepTime = config->Get(_name + ".trajectoryLogStepTime", 0.f);
 
-  _flightMode = config->Get(_name+".SimMode", "Full3D");
+  string flightMode = config->Get(_name+".SimMode", "Full3D");
+  if (flightMode == "AttitudeOnly")
+  {
+    _flightMode = FLIGHT_MODE_ATTITUDE_ONLY;
+  }
+  else if (flightMode == "PlanarXZ")
+  {
+    _flightMode = FLIGHT_MODE_PLANAR_XZ;
+  }
+  else
+  {
+    if (flightMode != "Full3D")
+    {
+      SLR_WARNING2("Unknown %s.SimMode %s, simulating Full3D", _name.c_str(), flightMode.c_str());
+    }
+    _flightMode = FLIGHT_MODE_FULL_3D;
+  }
+  CompileModel();
+
 	_useIdealEstimator = config->Get(_name + ".UseIdealEstimator", 1);
 
   ResetState(V3F());
@@ -105,7 +253,14 @@ int QuadDynamics::Initialize()
 
 	// CREATE ESTIMATOR
   string estConfig = config->Get(_name + ".Estimator", "QuadEstimatorEKF");
-  estimator.reset(new QuadEstimatorEKF(estConfig, _name));
+  if (_estimatorBatch)
+  {
+    estimator.reset(new QuadEstimatorEKFLane(estConfig, _name, _estimatorBatch, _estimatorLane));
+  }
+  else
+  {
+    estimator.reset(new QuadEstimatorEKF(estConfig, _name));
+  }
 
   _lastPosFollowErr = 0;
 
@@ -139,12 +294,43 @@ int QuadDynamics::Initialize()
 			sensors.push_back(simMag);
 		}
 	}
+  ScheduleEvents();
 
   return 1;
 }
 
+void QuadDynamics::ScheduleEvents()
+{
+  ParamsHandle config = SimpleConfig::GetInstance();
+
+  _events.Clear();
+  _imu.reset();
+  for (unsigned int i = 0; i < sensors.size(); i++)
+  {
+    shared_ptr<SimulatedQuadSensor> sensor = sensors[i];
+    float period = sensor->Period();
+    if (!(period > 0))
+    {
+      SLR_WARNING2("%s.dt of %s is not positive, the sensor is off", sensor->_config.c_str(), _name.c_str());
+    }
+    _events.Add(period, sensor->_phase, [this, sensor](double) { sensor->Update(*this, estimator); });
+
+    shared_ptr<SimulatedIMU> imu = dynamic_pointer_cast<SimulatedIMU>(sensor);
+    if (imu && !_imu)
+    {
+      _imu = imu;
+      float predictDT = config->Get(_name + ".PredictDT", period);
+      _events.Add(predictDT, config->Get(_name + ".PredictPhase", imu->_phase), [this, predictDT](double) { PredictEstimator(predictDT); });
+    }
+  }
 
-void QuadDynamics::Run(float dt, float simulationTime, int &idum, V3F externalForceInGlobalFrame, V3F externalMomentInBodyFrame)
+  controllerUpdateInterval = config->Get(_name + ".ControllerDT", 0.002f);
+  _controllerTask = _events.Add(controllerUpdateInterval, config->Get(_name + ".ControllerPhase", 0.f),
+    [this](double time) { UpdateController((float)time); });
+}
+
+
+void QuadDynamics::Run(float dt, float simulationTime, V3F externalForceInGlobalFrame, V3F externalMomentInBodyFrame)
 {
 	if (dt <= 0 || dt>0.05 || _isnan(dt))
 	{
@@ -154,68 +340,168 @@ void QuadDynamics::Run(float dt, float simulationTime, int &idum, V3F externalFo
 
   while(remainingTimeToSimulate > 0.000001) // Time intervals lower than that are just discarded (for speed of running)
   {
-    if(timeSinceLastControllerUpdate >= controllerUpdateInterval)
-    {
-            for (auto i = sensors.begin(); i != sensors.end(); i++)
-      {
-        (*i)->Update(*this, estimator, controllerUpdateInterval, idum);
-      }
-			if (estimator)
-			{
-				estimator->UpdateTrueError(Position(), Velocity(), quat);
-			}
-
-
-			// This is the update of the onboard controller -- runs timeout logic, sensor filtering, estimation, 
-			// controller, and produces a new set of motor commands
-			if (controller && _useIdealEstimator)
-			{
-				controller->UpdateEstimates(Position(), Velocity(), quat, Omega());
-			}
-			else if(controller && estimator)
-			{
-				controller->UpdateEstimates(estimator->EstimatedPosition(), estimator->EstimatedVelocity(), estimator->EstimatedAttitude(), estimator->EstimatedOmega());
-			}
-
-			if (controller)
-			{
-        curCmd = controller->RunControl(controllerUpdateInterval, simulationTime);
-        _lastPosFollowErr = controller->curTrajPoint.position.dist(Position());
-			}
-
-      if (simulationTime < 0.0000001){
-        motorCmdsOld(0) = curCmd.desiredThrustsN[0];
-        motorCmdsOld(1) = curCmd.desiredThrustsN[1];
-        motorCmdsOld(2) = curCmd.desiredThrustsN[2];
-        motorCmdsOld(3) = curCmd.desiredThrustsN[3];
-      }
-
-      timeSinceLastControllerUpdate = 0.0;
-    }
+    RunDueEvents();
+    remainingTimeToSimulate -= StepDynamics(remainingTimeToSimulate, simulationTime, externalForceInGlobalFrame, externalMomentInBodyFrame);
+  }
+}
+
+void QuadDynamics::RunDueEvents(bool beforeController)
+{
+  if (sensorRecorder)
+  {
+    sensorRecorder->SetTime(_time);
+  }
+  // what's due within Run()'s shortest step runs now
+  _events.RunDue(_time + 0.000001, beforeController ? _controllerTask : -1);
+}
+
+void QuadDynamics::PredictEstimator(float dt)
+{
+  if (!estimator || !_imu->_haveMeas) return;
+
+  if (sensorRecorder)
+  {
+    sensorRecorder->RecordPredict(dt, _imu->_accelMeas, _imu->_gyroMeas);
+  }
+  estimator->Predict(dt, _imu->_accelMeas, _imu->_gyroMeas);
+}
+
+void QuadDynamics::UpdateController(float simulationTime)
+{
+	if (sensorRecorder)
+	{
+		sensorRecorder->RecordTruth(Position(), Velocity(), quat);
+	}
+	if (estimator)
+	{
+		estimator->UpdateTrueError(Position(), Velocity(), quat);
+	}
+
+
+	// This is the update of the onboard controller -- runs timeout logic, sensor filtering, estimation, 
+	// controller, and produces a new set of motor commands
+	if (controller && _useIdealEstimator)
+	{
+		controller->UpdateEstimates(Position(), Velocity(), quat, Omega());
+	}
+	else if(controller && estimator)
+	{
+		controller->UpdateEstimates(estimator->EstimatedPosition(), estimator->EstimatedVelocity(), estimator->EstimatedAttitude(), estimator->EstimatedOmega());
+	}
+
+	if (controller)
+	{
+    curCmd = controller->RunControl(controllerUpdateInterval, simulationTime);
+    _lastPosFollowErr = controller->curTrajPoint.position.dist(Position());
+	}
+
+  if (simulationTime < 0.0000001){
+    motorCmdsOld(0) = curCmd.desiredThrustsN[0];
+    motorCmdsOld(1) = curCmd.desiredThrustsN[1];
+    motorCmdsOld(2) = curCmd.desiredThrustsN[2];
+    motorCmdsOld(3) = curCmd.desiredThrustsN[3];
+  }
+}
+
+double QuadDynamics::StepDynamics(double maxStep, float simulationTime, V3F externalForceInGlobalFrame, V3F externalMomentInBodyFrame)
+{
+  const double simStep = MIN(_events.NextTime() - _time, maxStep);
+  Dynamics(simStep, simulationTime, externalForceInGlobalFrame, externalMomentInBodyFrame);
+  _time += simStep;
+  return simStep;
+}
+
+double QuadDynamics::StageDynamics(double maxStep, float simulationTime, V3F externalForceInGlobalFrame, V3F externalMomentInBodyFrame)
+{
+  if (!_dynamicsBatch || !QuadDynamicsBatch::CanStep(*this))
+  {
+    return StepDynamics(maxStep, simulationTime, externalForceInGlobalFrame, externalMomentInBodyFrame);
+  }
 
-    const double simStep = MIN(controllerUpdateInterval - timeSinceLastControllerUpdate, remainingTimeToSimulate);
-    Dynamics(simStep, simulationTime, externalForceInGlobalFrame, externalMomentInBodyFrame, idum);
-    timeSinceLastControllerUpdate += simStep;
-    remainingTimeToSimulate -= simStep;
+  const double simStep = MIN(_events.NextTime() - _time, maxStep);
+  _stagedDt = (float)simStep;
+  _stagedSimTime = simulationTime;
+  _stagedForce = externalForceInGlobalFrame;
+  _stagedMoment = externalMomentInBodyFrame;
+  _stagedOldPos = StartDynamics();
+  if (!_dynamicsModelSet)
+  {
+    _dynamicsBatch->SetModel(_dynamicsLane, *this);
+    _dynamicsModelSet = true;
   }
+  _dynamicsBatch->Stage(_dynamicsLane, *this, _stagedDt, _stagedForce, _stagedMoment);
+  _dynamicsStaged = true;
+  _time += simStep;
+  return simStep;
 }
 
+void QuadDynamics::FinishDynamics()
+{
+  if (!_dynamicsStaged) return;
+  _dynamicsStaged = false;
+
+  if (_dynamicsBatch->IsStepped(_dynamicsLane))
+  {
+    _dynamicsBatch->Collect(_dynamicsLane, *this);
+  }
+  else
+  {
+    _dynamicsBatch->Unstage(_dynamicsLane);
+    StepEuler(_stagedDt, _stagedForce, _stagedMoment);
+  }
+  EndDynamics(_stagedOldPos, _stagedSimTime);
+}
 
-void QuadDynamics::Dynamics(float dt, float simTime, V3F external_force, V3F external_moment, int& idum)
+void QuadDynamics::Dynamics(float dt, float simTime, V3F external_force, V3F external_moment)
+{
+  V3F oldPos = StartDynamics();
+  if (_integrator == INTEGRATOR_RK4)
+  {
+    StepRK4(dt, external_force, external_moment);
+  }
+  else
+  {
+    StepEuler(dt, external_force, external_moment);
+  }
+  EndDynamics(oldPos, simTime);
+}
+
+V3F QuadDynamics::StartDynamics()
 {
   // NED/FRD reference frame
-  matrix::Vector<float,3> ext_moment;
-  ext_moment(0) = external_moment.x;
-  ext_moment(1) = external_moment.y;
-  ext_moment(2) = external_moment.z;
 
   // constrain the desired thrusts to reflect real-world constraints
   for (int i = 0; i < 4; i++)
   {
 		curCmd.desiredThrustsN[i] = CONSTRAIN(curCmd.desiredThrustsN[i], minMotorThrust, maxMotorThrust);
-    motorCmdsN(i) = curCmd.desiredThrustsN[i] + randomMotorForceMag * ran1_inRange(-1.f, 1.f, idum);
+    motorCmdsN(i) = curCmd.desiredThrustsN[i] + randomMotorForceMag * _rng.Uniform(-1.f, 1.f);
+  }
+
+  V3F oldPos;
+  if (_flightMode != FLIGHT_MODE_ATTITUDE_ONLY)
+  {
+    oldPos = pos;
+  }
+  return oldPos;
+}
+
+void QuadDynamics::EndDynamics(const V3F& oldPos, float simTime)
+{
+  RunRoomConstraints(oldPos);
+
+  motorCmdsOld = motorCmdsN;
+
+  if ((simTime - _lastTrajPointTime) > _trajLogStepTime)
+  {
+    _lastTrajPointTime = simTime;
+
+		_followedPos.push(pos);
+		_followedAtt.push(quat);
   }
+}
 
+void QuadDynamics::StepEuler(float dt, V3F external_force, V3F external_moment)
+{
   // Prop dynamics, props cannot change thrusts in a non continuous manner
   for (int m = 0; m < 4; m++){
     if (motorCmdsN(m) >= motorCmdsOld(m))
@@ -229,106 +515,151 @@ void QuadDynamics::Dynamics(float dt, float simTime, V3F external_force, V3F ext
   }
 
   float total_thrust = motorCmdsN(0) + motorCmdsN(1) + motorCmdsN(2) + motorCmdsN(3);
-  V3F oldPos;
   V3F force_body_frame(0.f,0.f,-total_thrust);
   float half_dt = dt/2;
   V3F force_inertial_frame = quat.Rotate_BtoI(force_body_frame);
   V3F gravity(0.f,0.f,9.81f);
 
-
-  matrix::Vector<float,3> omega_v;
-  omega_v(0) = omega.x;
-  omega_v(1) = omega.y;
-  omega_v(2) = omega.z;
-
-  matrix::Matrix<float,3,3> omega_skew;
-  omega_skew(0,0) = 0;
-  omega_skew(1,1) = 0;
-  omega_skew(2,2) = 0;
-  omega_skew(0,1) = -omega_v(2);
-  omega_skew(0,2) = omega_v(1);
-  omega_skew(1,0) = omega_v(2);
-  omega_skew(1,2) = -omega_v(0);
-  omega_skew(2,0) = -omega_v(1);
-  omega_skew(2,1) = omega_v(0);
-
-  // X shaped Quad Motor Matrix (NED Frame again)
-  matrix::Matrix<float,3,4> motor_matrix;
-  motor_matrix(0,0) = L/sqrt(2) + cy;
-  motor_matrix(0,1) = -(L/sqrt(2) - cy);
-  motor_matrix(0,2) = L/sqrt(2) + cy;
-  motor_matrix(0,3) = -(L/sqrt(2) - cy);
-  motor_matrix(1,0) = L/sqrt(2) - cx;
-  motor_matrix(1,1) = L/sqrt(2) - cx;
-  motor_matrix(1,2) = -(L/sqrt(2) + cx);
-  motor_matrix(1,3) = -(L/sqrt(2) + cx);
-  motor_matrix(2,0) = -kappa;
-  motor_matrix(2,1) = kappa;
-  motor_matrix(2,2) = kappa;
-  motor_matrix(2,3) = -kappa;
-
-  // Create Inertia matrix and inverse
-  matrix::SquareMatrix<float,3> inertia_matrix;
-  inertia_matrix.setZero();
-  inertia_matrix(0,0) = (float)Ixx;
-  inertia_matrix(1,1) = (float)Iyy;
-  inertia_matrix(2,2) = (float)Izz;
-  matrix::SquareMatrix<float,3> inv_inertia = matrix::inv(inertia_matrix);
-
-  matrix::Vector<float,3> Iw;
-  Iw = inertia_matrix*omega_v;
-  matrix::Vector<float,3> total_moment = motor_matrix * motorCmdsN + ext_moment;
+  // Euler's equation with the diagonal inertia: I * omega_dot = moment - omega x (I * omega)
+  matrix::Vector<float,3> motor_moment = _motorMatrix * motorCmdsN;
+  V3F total_moment = V3F(motor_moment(0), motor_moment(1), motor_moment(2)) + external_moment;
+  V3F omega_dot = _invInertia * (total_moment - omega.cross(_inertia * omega));
+  if (_flightMode == FLIGHT_MODE_PLANAR_XZ)
+  {
+    // or semi-implicit Euler would roll and yaw by them before they're zeroed below
+    omega_dot.x = omega_dot.z = 0;
+  }
 
   // Individual Flight Mode kinematic equations
-
-  if(_flightMode == "AttitudeOnly")
+  acc = (force_inertial_frame + external_force)/M + gravity;
+  switch (_flightMode)
   {
-    // Attitude only - no position changes
-    acc = (force_inertial_frame + external_force)/M + gravity;
+  case FLIGHT_MODE_FULL_3D:
     vel = vel + acc * dt;
-    quat = quat.IntegrateBodyRate_fast(omega.x, omega.y, omega.z, half_dt);
-    omega_v = omega_v + inv_inertia * (total_moment - omega_skew*Iw) * dt;
-  }
-  if(_flightMode == "PlanarXZ")
-  {
-    // Planar XZ
-    acc = (force_inertial_frame + external_force)/M + gravity;
+    pos = pos + vel * dt;
+    break;
+  case FLIGHT_MODE_PLANAR_XZ:
     acc.y = 0; // no acceleration in y direction
     vel = vel + acc * dt;
     vel.y = 0; // no velocity in y direction
-    oldPos = pos;
-    pos = oldPos + vel * dt;
-    pos.y = oldPos.y;
-    quat = quat.IntegrateBodyRate_fast(omega.x, omega.y, omega.z, half_dt);
-    omega_v = omega_v + inv_inertia * (total_moment - omega_skew*Iw) * dt;
-    omega_v(0) = 0; // Roll is not allowed
-    omega_v(2) = 0; // Yaw is also not allowed
+    pos = pos + vel * dt;
+    break;
+  case FLIGHT_MODE_ATTITUDE_ONLY:
+    // Attitude only - no position changes
+    vel = vel + acc * dt;
+    break;
   }
-  if(_flightMode == "Full3D")
+
+  // explicit Euler turns the attitude by the body rates at the start of the step,
+  // semi-implicit Euler by those at its end
+  if (_integrator == INTEGRATOR_SEMI_IMPLICIT_EULER)
+  {
+    omega = omega + omega_dot * dt;
+  }
+  if (_expMapAttitude)
+  {
+    // exact for constant body rates
+    quat.IntegrateBodyRate(V3D(omega.x, omega.y, omega.z), dt);
+    quat.Normalise();
+  }
+  else
   {
-    acc = (force_inertial_frame + external_force)/M + gravity;
-    vel = vel + acc * dt;
-    oldPos = pos;
-    pos = oldPos + vel * dt;
     quat = quat.IntegrateBodyRate_fast(omega.x, omega.y, omega.z, half_dt);
-    omega_v = omega_v + inv_inertia * (total_moment - omega_skew*Iw) * dt;
   }
+  if (_integrator == INTEGRATOR_EULER)
+  {
+    omega = omega + omega_dot * dt;
+  }
+  if (_flightMode == FLIGHT_MODE_PLANAR_XZ)
+  {
+    omega.x = 0; // Roll is not allowed
+    omega.z = 0; // Yaw is also not allowed
+  }
+}
 
-  omega.x = omega_v(0);
-  omega.y = omega_v(1);
-  omega.z = omega_v(2);
-
-  RunRoomConstraints(oldPos);
+void QuadDynamics::StepRK4(float dt, V3F external_force, V3F external_moment)
+{
+  // the commands are held over the step, so each motor's thrust follows
+  // cmd + (old - cmd) * exp(-t / tau) exactly. at the step's start, middle and end:
+  float thrust[3];
+  V3F moment[3];
+  for (int k = 0; k < 3; k++)
+  {
+    matrix::Vector<float, 4> motors;
+    for (int m = 0; m < 4; m++)
+    {
+      float tau = (float)(motorCmdsN(m) >= motorCmdsOld(m) ? tauaUp : tauaDown);
+      motors(m) = motorCmdsN(m) + (motorCmdsOld(m) - motorCmdsN(m)) * expf(-k * dt / 2 / tau);
+    }
+    thrust[k] = motors(0) + motors(1) + motors(2) + motors(3);
+    matrix::Vector<float, 3> motor_moment = _motorMatrix * motors;
+    moment[k] = V3F(motor_moment(0), motor_moment(1), motor_moment(2)) + external_moment;
+    if (k == 2)
+    {
+      motorCmdsN = motors;
+    }
+  }
 
-  motorCmdsOld = motorCmdsN;
+  // the state's rates of change, under the flight mode's constraints
+  auto accel = [&](const Quaternion<float>& att, int k)
+  {
+    V3F a = (att.Rotate_BtoI(V3F(0.f, 0.f, -thrust[k])) + external_force) / M + V3F(0.f, 0.f, 9.81f);
+    if (_flightMode == FLIGHT_MODE_PLANAR_XZ) a.y = 0;
+    return a;
+  };
+  auto omegaDot = [&](const V3F& w, int k)
+  {
+    V3F ret = _invInertia * (moment[k] - w.cross(_inertia * w));
+    if (_flightMode == FLIGHT_MODE_PLANAR_XZ) ret.x = ret.z = 0;
+    return ret;
+  };
+  auto attDot = [](const Quaternion<float>& att, const V3F& w)
+  {
+    // att * (0, w) / 2 with the Hamilton product, which is operator* the other way round
+    return Quaternion<float>(0, w.x / 2, w.y / 2, w.z / 2) * att;
+  };
+  auto addScaled = [](const Quaternion<float>& a, const Quaternion<float>& b, float s)
+  {
+    return Quaternion<float>(a[0] + b[0] * s, a[1] + b[1] * s, a[2] + b[2] * s, a[3] + b[3] * s).Normalise();
+  };
 
-  if ((simTime - _lastTrajPointTime) > _trajLogStepTime)
+  if (_flightMode == FLIGHT_MODE_PLANAR_XZ)
   {
-    _lastTrajPointTime = simTime;
+    vel.y = 0; // no velocity in y direction
+    omega.x = omega.z = 0; // no roll or yaw
+  }
 
-		_followedPos.push(pos);
-		_followedAtt.push(quat);
+  const V3F v1 = vel, a1 = accel(quat, 0), w1 = omega, wd1 = omegaDot(w1, 0);
+  const Quaternion<float> qd1 = attDot(quat, w1);
+
+  const V3F v2 = vel + a1 * (dt / 2), w2 = omega + wd1 * (dt / 2);
+  const Quaternion<float> q2 = addScaled(quat, qd1, dt / 2);
+  const V3F a2 = accel(q2, 1), wd2 = omegaDot(w2, 1);
+  const Quaternion<float> qd2 = attDot(q2, w2);
+
+  const V3F v3 = vel + a2 * (dt / 2), w3 = omega + wd2 * (dt / 2);
+  const Quaternion<float> q3 = addScaled(quat, qd2, dt / 2);
+  const V3F a3 = accel(q3, 1), wd3 = omegaDot(w3, 1);
+  const Quaternion<float> qd3 = attDot(q3, w3);
+
+  const V3F v4 = vel + a3 * dt, w4 = omega + wd3 * dt;
+  const Quaternion<float> q4 = addScaled(quat, qd3, dt);
+  const V3F a4 = accel(q4, 2), wd4 = omegaDot(w4, 2);
+  const Quaternion<float> qd4 = attDot(q4, w4);
+
+  const float k = dt / 6;
+  if (_flightMode != FLIGHT_MODE_ATTITUDE_ONLY)
+  {
+    pos = pos + (v1 + (v2 + v3) * 2.f + v4) * k;
   }
+  vel = vel + (a1 + (a2 + a3) * 2.f + a4) * k;
+  omega = omega + (wd1 + (wd2 + wd3) * 2.f + wd4) * k;
+  Quaternion<float> qd(qd1[0] + 2 * (qd2[0] + qd3[0]) + qd4[0], qd1[1] + 2 * (qd2[1] + qd3[1]) + qd4[1],
+    qd1[2] + 2 * (qd2[2] + qd3[2]) + qd4[2], qd1[3] + 2 * (qd2[3] + qd3[3]) + qd4[3]);
+  quat = addScaled(quat, qd, k);
+
+  // what the accelerometer feels now
+  acc = accel(quat, 2);
 }
 
 void QuadDynamics::RunRoomConstraints(const V3F& oldPos)
@@ -385,36 +716,47 @@ void QuadDynamics::TurnOffNonidealities()
 	//see initialized in QuadDynamics::Initialize
   cx = 0;
   cy = 0;
+  CompileModel();
 }
 
-bool QuadDynamics::GetData(const string& name, float& ret) const
+// the matrices Dynamics() needs, from the vehicle's geometry and mass properties
+void QuadDynamics::CompileModel()
 {
-  if (name.find_first_of(".") == string::npos) return false;
-  string leftPart = LeftOf(name, '.');
-  string rightPart = RightOf(name, '.');
-  if (ToUpper(leftPart) == ToUpper(_name))
-  {
-#define GETTER_HELPER(A,B) if (SLR::ToUpper(rightPart) == SLR::ToUpper(A)){ ret=(B); return true; }
-    // UDACITY CONVENTION
-    GETTER_HELPER("Thrust.A", motorCmdsN(0));
-    GETTER_HELPER("Thrust.B", motorCmdsN(1));
-    GETTER_HELPER("Thrust.C", motorCmdsN(2));
-    GETTER_HELPER("Thrust.D", motorCmdsN(3));
-    GETTER_HELPER("PosFollowErr", _lastPosFollowErr);
-#undef GETTER_HELPER
-    return BaseDynamics::GetData(name, ret);
-  }
-
-  return false;  
+  // X shaped Quad Motor Matrix (NED Frame again)
+  _motorMatrix(0,0) = L/sqrt(2) + cy;
+  _motorMatrix(0,1) = -(L/sqrt(2) - cy);
+  _motorMatrix(0,2) = L/sqrt(2) + cy;
+  _motorMatrix(0,3) = -(L/sqrt(2) - cy);
+  _motorMatrix(1,0) = L/sqrt(2) - cx;
+  _motorMatrix(1,1) = L/sqrt(2) - cx;
+  _motorMatrix(1,2) = -(L/sqrt(2) + cx);
+  _motorMatrix(1,3) = -(L/sqrt(2) + cx);
+  _motorMatrix(2,0) = -kappa;
+  _motorMatrix(2,1) = kappa;
+  _motorMatrix(2,2) = kappa;
+  _motorMatrix(2,3) = -kappa;
+
+  // Create Inertia matrix and inverse. diagonal, so only the diagonals are kept
+  matrix::SquareMatrix<float,3> inertia_matrix;
+  inertia_matrix.setZero();
+  inertia_matrix(0,0) = (float)Ixx;
+  inertia_matrix(1,1) = (float)Iyy;
+  inertia_matrix(2,2) = (float)Izz;
+  matrix::SquareMatrix<float,3> inv_inertia = matrix::inv(inertia_matrix);
+  _inertia = V3F(inertia_matrix(0,0), inertia_matrix(1,1), inertia_matrix(2,2));
+  _invInertia = V3F(inv_inertia(0,0), inv_inertia(1,1), inv_inertia(2,2));
+
+  // the dynamics batch's copy is out of date
+  _dynamicsModelSet = false;
 }
 
-vector<string> QuadDynamics::GetFields() const
+// Graphing variables, published once, in addition to BaseDynamics'
+void QuadDynamics::AddFields()
 {
-  vector<string> ret = BaseDynamics::GetFields();
-  ret.push_back(_name + ".Thrust.A");
-  ret.push_back(_name + ".Thrust.B");
-  ret.push_back(_name + ".Thrust.C");
-  ret.push_back(_name + ".Thrust.D");
-  ret.push_back(_name + ".PosFollowErr");
-  return ret;
+  // UDACITY CONVENTION
+  AddField(_name + ".Thrust.A", &motorCmdsN(0));
+  AddField(_name + ".Thrust.B", &motorCmdsN(1));
+  AddField(_name + ".Thrust.C", &motorCmdsN(2));
+  AddField(_name + ".Thrust.D", &motorCmdsN(3));
+  AddField(_name + ".PosFollowErr", &_lastPosFollowErr);
 }
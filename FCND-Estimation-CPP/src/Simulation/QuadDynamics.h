@@ -6,12 +6,18 @@
 #include <matrix/math.hpp>
 #include "Math/LowPassFilter.h"
 #include "Drawing/ColorUtils.h"
+#include "Math/Random.h"
+#include "Utility/EventScheduler.h"
 
 class QuadDynamics;
 typedef shared_ptr<QuadDynamics> QuadcopterHandle;
 
 class BaseQuadEstimator;
 class SimulatedQuadSensor;
+class SimulatedIMU;
+class QuadEstimatorEKFBatch;
+class QuadDynamicsBatch;
+class SensorRecorder;
 
 class QuadDynamics : public BaseDynamics
 {
@@ -28,13 +34,49 @@ public:
 	virtual ~QuadDynamics() {}; // destructor
 	virtual int Initialize();
 
-  virtual void Run(float dt, float simulationTime, int &idum,  // updates the simulation
+  virtual void Run(float dt, float simulationTime,  // updates the simulation
       V3F externalForceInGlobalFrame = V3F(),    // required to take net forces into account
       V3F externalMomentInBodyFrame = V3F());   // required to take net moments into account
+
+  // the pieces of one pass of Run()'s loop, for stepping several vehicles in lockstep
+  // (see Simulator::RunStepsBatched):
+  //   RunDueEvents();
+  //   remaining -= StepDynamics(remaining, t, ...);
+  // the sensors, estimator and controller each run on their own schedule (see
+  // ScheduleEvents()); RunDueEvents() runs the ones that are due, or, with
+  // beforeController, all but the controller
+  void RunDueEvents(bool beforeController = false);
+  void UpdateController(float simulationTime);
+  // simulates up to maxStep, stopping at the next event. returns the time simulated
+  double StepDynamics(double maxStep, float simulationTime, V3F externalForceInGlobalFrame, V3F externalMomentInBodyFrame);
+  // StepDynamics() in two halves, for stepping the vehicles' rigid bodies together in
+  // the dynamics batch: StageDynamics() stages the step in the vehicle's lane, and once the
+  // batch is flushed FinishDynamics() collects it. the state is stale in between.
+  // without a batch, or with a model the batch can't step, StageDynamics() simulates
+  // the step right away
+  double StageDynamics(double maxStep, float simulationTime, V3F externalForceInGlobalFrame, V3F externalMomentInBodyFrame);
+  void FinishDynamics();
                   
 	virtual void SetCommands(const VehicleCommand& cmd);	// update commands in the simulator coming from a command2 packet
 
-  virtual void Dynamics(float dt, float simTime, V3F external_force, V3F external_moment, int& idum);
+  virtual void Dynamics(float dt, float simTime, V3F external_force, V3F external_moment);
+
+  // restarts the vehicle's random streams from a RandomStream::MakeKey key:
+  // stream 0 drives the motor noise, stream 1+i the noise of sensors[i]
+  void SeedRandomStreams(uint64_t key);
+
+  // the vehicle's state, its clock and schedule, and the state of its controller,
+  // estimator and sensors, between Run() calls. loading it into a vehicle with another
+  // controller, estimator or set of sensors fails
+  virtual void SaveState(SLR::StateBuffer& s);
+  virtual bool LoadState(SLR::StateBuffer& s);
+
+  // from the next Initialize()/Reset() on, the estimator predicts in lane 'lane' of batch.
+  // null batch for a stand-alone estimator
+  void SetEstimatorBatch(shared_ptr<QuadEstimatorEKFBatch> batch, int lane);
+
+  // StageDynamics() steps the vehicle in lane 'lane' of batch. null batch to step by itself
+  void SetDynamicsBatch(shared_ptr<QuadDynamicsBatch> batch, int lane);
 
 	double GetRotDistInt() {return rotDisturbanceInt;};
 	double GetXyzDistInt() {return xyzDisturbanceInt;};
@@ -42,8 +84,8 @@ public:
 	double GetXyzDistBW() {return xyzDisturbanceBW;};
 	double GetGyroNoiseInt() {return gyroNoiseInt;};
 
-  virtual bool GetData(const string& name, float& ret) const;
-  virtual vector<string> GetFields() const;
+  // publishes the graphing variables
+  void AddFields();
 
   void Reset();
 
@@ -55,19 +97,29 @@ public:
 	void TurnOffNonidealities();
 
 	void RunRoomConstraints(const V3F& oldPos);
+
+  // rebuilds the vehicle model after its geometry or mass properties changed
+  void CompileModel();
   
 	VehicleCommand curCmd;
 
 	float GetArmLength() const { return L; }
 
+  // current thrust command of motor i [N]
+  float GetMotorThrust(int i) const { return motorCmdsN(i); }
+
   ControllerHandle controller;
   shared_ptr<BaseQuadEstimator> estimator;
   
   friend class Visualizer_GLUT;
+  friend class QuadDynamicsBatch;
 
   // sensors
   vector<shared_ptr<SimulatedQuadSensor> > sensors;
 
+  // if set, the sensors' measurements and the true state are recorded to it for replay
+  shared_ptr<SensorRecorder> sensorRecorder;
+
 protected:
   matrix::Vector<float, 4> motorCmdsN;
   matrix::Vector<float, 4> motorCmdsOld;
@@ -91,12 +143,63 @@ protected:
 
   float randomMotorForceMag;
 
-  double controllerUpdateInterval, timeSinceLastControllerUpdate;
+  double controllerUpdateInterval;
+
+  // the vehicle's clock since the last ResetState() [s], and what runs when
+  double _time;
+  SLR::EventScheduler _events;
+  int _controllerTask;
+  // sets up _events: the sensors, each every <sensor config>.dt starting at
+  // <sensor config>.Phase, the estimator's prediction with the latest IMU
+  // measurement every <name>.PredictDT (by default with every IMU measurement,
+  // right after it), and the controller every <name>.ControllerDT starting at
+  // <name>.ControllerPhase. due at the same time, they run in that order
+  void ScheduleEvents();
+  void PredictEstimator(float dt);
+  shared_ptr<SimulatedIMU> _imu; // the first IMU of sensors, if any
 
   float _lastPosFollowErr;
 
   V3F color;  
-  string _flightMode;
 	bool _useIdealEstimator; 
 
+  // which of the vehicle's motion is simulated, from <name>.SimMode
+  enum FlightMode { FLIGHT_MODE_FULL_3D, FLIGHT_MODE_PLANAR_XZ, FLIGHT_MODE_ATTITUDE_ONLY };
+  FlightMode _flightMode;
+
+  // the vehicle model, see CompileModel()
+  matrix::Matrix<float, 3, 4> _motorMatrix; // motor thrusts to body moments (X shaped, NED/FRD)
+  V3F _inertia, _invInertia; // diagonal of the inertia matrix and of its inverse
+
+  // how Dynamics() steps the state, from Sim.Integrator and Sim.AttitudeIntegrator
+  enum Integrator { INTEGRATOR_EULER, INTEGRATOR_SEMI_IMPLICIT_EULER, INTEGRATOR_RK4 };
+  Integrator _integrator;
+  bool _expMapAttitude; // Euler and SemiImplicitEuler only
+
+  // Dynamics() after the motor commands are set. StepEuler() lags the motors to first
+  // order, StepRK4() exactly, and holds the commands and external force and moment
+  // over the step
+  void StepEuler(float dt, V3F external_force, V3F external_moment);
+  void StepRK4(float dt, V3F external_force, V3F external_moment);
+
+  // the rest of Dynamics(): StartDynamics() sets the motor commands and returns the
+  // position to constrain the step from, EndDynamics() constrains it and logs
+  V3F StartDynamics();
+  void EndDynamics(const V3F& oldPos, float simTime);
+
+  // motor noise source, owned per vehicle so vehicles can be stepped independently of each other
+  RandomStream _rng;
+
+  shared_ptr<QuadEstimatorEKFBatch> _estimatorBatch;
+  int _estimatorLane;
+
+  shared_ptr<QuadDynamicsBatch> _dynamicsBatch;
+  int _dynamicsLane;
+  bool _dynamicsModelSet; // whether the lane has the model, CompileModel() clears it
+  // the staged step, for FinishDynamics() and for running it here if needed before
+  // the batch is flushed
+  bool _dynamicsStaged;
+  float _stagedDt, _stagedSimTime;
+  V3F _stagedOldPos, _stagedForce, _stagedMoment;
+
 };
@@ -0,0 +1,263 @@
+#include "Common.h"
+#include "QuadDynamicsBatch.h"
+#include "QuadDynamics.h"
+
+const int QuadDynamicsBatch::BLOCK;
+
+QuadDynamicsBatch::QuadDynamicsBatch(int numLanes)
+{
+  _numLanes = numLanes;
+  _capacity = (numLanes + BLOCK - 1) / BLOCK * BLOCK;
+  _numStaged = 0;
+  _firstStaged = _capacity;
+  _lastStaged = -1;
+  _status.assign(_capacity, LANE_IDLE);
+
+  // lanes that were never staged are stepped along with the rest, keep them finite
+  _state.assign(NUM_STATE * _capacity, 0.f);
+  _inputs.assign(NUM_INPUTS * _capacity, 0.f);
+  _outputs.assign(NUM_OUTPUTS * _capacity, 0.f);
+  for (int l = 0; l < _capacity; l++)
+  {
+    State(Q0, l) = 1.f;
+    Input(INPUT_MASS, l) = 1.f;
+  }
+}
+
+bool QuadDynamicsBatch::CanStep(const QuadDynamics& quad)
+{
+  return quad._integrator != QuadDynamics::INTEGRATOR_RK4 && !quad._expMapAttitude
+    && quad._flightMode == QuadDynamics::FLIGHT_MODE_FULL_3D;
+}
+
+void QuadDynamicsBatch::SetModel(int lane, const QuadDynamics& quad)
+{
+  Input(INPUT_TAU_UP, lane) = (float)quad.tauaUp;
+  Input(INPUT_TAU_DOWN, lane) = (float)quad.tauaDown;
+  Input(INPUT_MASS, lane) = quad.M;
+  for (int i = 0; i < 3; i++)
+  {
+    for (int m = 0; m < 4; m++)
+    {
+      Input(INPUT_MIX + 4 * i + m, lane) = quad._motorMatrix(i, m);
+    }
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    Input(INPUT_INERTIA + i, lane) = quad._inertia[i];
+    Input(INPUT_INV_INERTIA + i, lane) = quad._invInertia[i];
+  }
+  Input(INPUT_SEMI_IMPLICIT, lane) = quad._integrator == QuadDynamics::INTEGRATOR_SEMI_IMPLICIT_EULER ? 1.f : 0.f;
+}
+
+void QuadDynamicsBatch::Stage(int lane, const QuadDynamics& quad, float dt, V3F external_force, V3F external_moment)
+{
+  State(POS_X, lane) = quad.pos.x;
+  State(POS_Y, lane) = quad.pos.y;
+  State(POS_Z, lane) = quad.pos.z;
+  State(VEL_X, lane) = quad.vel.x;
+  State(VEL_Y, lane) = quad.vel.y;
+  State(VEL_Z, lane) = quad.vel.z;
+  for (int i = 0; i < 4; i++)
+  {
+    State(Q0 + i, lane) = quad.quat[i];
+  }
+  State(OMEGA_X, lane) = quad.omega.x;
+  State(OMEGA_Y, lane) = quad.omega.y;
+  State(OMEGA_Z, lane) = quad.omega.z;
+
+  Input(INPUT_DT, lane) = dt;
+  for (int m = 0; m < 4; m++)
+  {
+    Input(INPUT_CMD + m, lane) = quad.motorCmdsN(m);
+    Input(INPUT_OLD_CMD + m, lane) = quad.motorCmdsOld(m);
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    Input(INPUT_FORCE + i, lane) = external_force[i];
+    Input(INPUT_MOMENT + i, lane) = external_moment[i];
+  }
+
+  if (_status[lane] != LANE_STAGED) _numStaged++;
+  _status[lane] = LANE_STAGED;
+  _firstStaged = MIN(_firstStaged, lane);
+  _lastStaged = MAX(_lastStaged, lane);
+}
+
+void QuadDynamicsBatch::Unstage(int lane)
+{
+  if (_status[lane] == LANE_STAGED) _numStaged--;
+  _status[lane] = LANE_IDLE;
+}
+
+void QuadDynamicsBatch::Collect(int lane, QuadDynamics& quad)
+{
+  quad.pos = V3F(Output(POS_X, lane), Output(POS_Y, lane), Output(POS_Z, lane));
+  quad.vel = V3F(Output(VEL_X, lane), Output(VEL_Y, lane), Output(VEL_Z, lane));
+  for (int i = 0; i < 4; i++)
+  {
+    quad.quat[i] = Output(Q0 + i, lane);
+  }
+  quad.omega = V3F(Output(OMEGA_X, lane), Output(OMEGA_Y, lane), Output(OMEGA_Z, lane));
+  quad.acc = V3F(Output(ACC_X, lane), Output(ACC_Y, lane), Output(ACC_Z, lane));
+  for (int m = 0; m < 4; m++)
+  {
+    quad.motorCmdsN(m) = Output(THRUST + m, lane);
+  }
+  _status[lane] = LANE_IDLE;
+}
+
+void QuadDynamicsBatch::Flush()
+{
+  if (_numStaged == 0) return;
+
+  for (int first = _firstStaged / BLOCK * BLOCK; first <= _lastStaged; first += BLOCK)
+  {
+    bool anyStaged = false;
+    for (int l = first; l < first + BLOCK; l++)
+    {
+      if (_status[l] == LANE_STAGED)
+      {
+        anyStaged = true;
+        _status[l] = LANE_STEPPED;
+      }
+    }
+    if (anyStaged)
+    {
+      StepBlock(first);
+    }
+  }
+  _numStaged = 0;
+  _firstStaged = _capacity;
+  _lastStaged = -1;
+}
+
+// all loops over l have BLOCK iterations and only touch local arrays, which is
+// what the compiler needs to vectorize them without -O3. every expression is
+// StepEuler's, term by term and in the same order, so results match it exactly
+void QuadDynamicsBatch::StepBlock(int first)
+{
+  float in[NUM_INPUTS][BLOCK], x[NUM_STATE][BLOCK], out[NUM_OUTPUTS][BLOCK];
+  memcpy(in, &Input(0, first), sizeof(in));
+  memcpy(x, &State(0, first), sizeof(x));
+
+  const float* dt = in[INPUT_DT];
+
+  // motor lag, to first order
+  for (int m = 0; m < 4; m++)
+  {
+    const float* cmd = in[INPUT_CMD + m];
+    const float* old = in[INPUT_OLD_CMD + m];
+    float* thrust = out[THRUST + m];
+    for (int l = 0; l < BLOCK; l++)
+    {
+      float tau = cmd[l] >= old[l] ? in[INPUT_TAU_UP][l] : in[INPUT_TAU_DOWN][l];
+      thrust[l] = cmd[l] * (dt[l] / (dt[l] + tau)) + old[l] * (tau / (dt[l] + tau));
+    }
+  }
+
+  // thrust along -z body, rotated to inertial by Quaternion::Rotate_BtoI
+  float force[3][BLOCK];
+  for (int l = 0; l < BLOCK; l++)
+  {
+    const float fz = -(out[THRUST][l] + out[THRUST + 1][l] + out[THRUST + 2][l] + out[THRUST + 3][l]);
+    const float q0 = -x[Q0][l], q1 = x[Q1][l], q2 = x[Q2][l], q3 = x[Q3][l];
+    const float r0 = q0 * q0, r1 = q1 * q1, r2 = q2 * q2, r3 = q3 * q3;
+    force[0][l] = (r0 + r1 - r2 - r3) * 0.f + (2 * q1 * q2 + 2 * q0 * q3) * 0.f + (2 * q1 * q3 - 2 * q0 * q2) * fz;
+    force[1][l] = (2 * q1 * q2 - 2 * q0 * q3) * 0.f + (r0 - r1 + r2 - r3) * 0.f + (2 * q2 * q3 + 2 * q0 * q1) * fz;
+    force[2][l] = (2 * q1 * q3 + 2 * q0 * q2) * 0.f + (2 * q2 * q3 - 2 * q0 * q1) * 0.f + (r0 - r1 - r2 + r3) * fz;
+  }
+
+  // the mixer: body moments of the motor matrix times the thrusts, summed as matrix:: does
+  float moment[3][BLOCK];
+  for (int i = 0; i < 3; i++)
+  {
+    const float* mix = in[INPUT_MIX + 4 * i];
+    for (int l = 0; l < BLOCK; l++)
+    {
+      float s = 0;
+      s += mix[l] * out[THRUST][l];
+      s += mix[BLOCK + l] * out[THRUST + 1][l];
+      s += mix[2 * BLOCK + l] * out[THRUST + 2][l];
+      s += mix[3 * BLOCK + l] * out[THRUST + 3][l];
+      moment[i][l] = s + in[INPUT_MOMENT + i][l];
+    }
+  }
+
+  // Euler's equation with the diagonal inertia: I * omega_dot = moment - omega x (I * omega)
+  float omegaDot[3][BLOCK];
+  for (int l = 0; l < BLOCK; l++)
+  {
+    const float wx = x[OMEGA_X][l], wy = x[OMEGA_Y][l], wz = x[OMEGA_Z][l];
+    const float hx = in[INPUT_INERTIA][l] * wx, hy = in[INPUT_INERTIA + 1][l] * wy, hz = in[INPUT_INERTIA + 2][l] * wz;
+    omegaDot[0][l] = in[INPUT_INV_INERTIA][l] * (moment[0][l] - (wy * hz - wz * hy));
+    omegaDot[1][l] = in[INPUT_INV_INERTIA + 1][l] * (moment[1][l] - (wz * hx - wx * hz));
+    omegaDot[2][l] = in[INPUT_INV_INERTIA + 2][l] * (moment[2][l] - (wx * hy - wy * hx));
+  }
+
+  // translation
+  const float gravity[3] = { 0.f, 0.f, 9.81f };
+  for (int i = 0; i < 3; i++)
+  {
+    for (int l = 0; l < BLOCK; l++)
+    {
+      const float a = (force[i][l] + in[INPUT_FORCE + i][l]) / in[INPUT_MASS][l] + gravity[i];
+      out[ACC_X + i][l] = a;
+      out[VEL_X + i][l] = x[VEL_X + i][l] + a * dt[l];
+      out[POS_X + i][l] = x[POS_X + i][l] + out[VEL_X + i][l] * dt[l];
+    }
+  }
+
+  // rotation: the attitude turns by the body rates at the start of the step, or with
+  // SemiImplicitEuler by those at its end (Quaternion::IntegrateBodyRate_fast)
+  float w[3][BLOCK];
+  for (int i = 0; i < 3; i++)
+  {
+    for (int l = 0; l < BLOCK; l++)
+    {
+      out[OMEGA_X + i][l] = x[OMEGA_X + i][l] + omegaDot[i][l] * dt[l];
+      w[i][l] = in[INPUT_SEMI_IMPLICIT][l] != 0 ? out[OMEGA_X + i][l] : x[OMEGA_X + i][l];
+    }
+  }
+  float norm[BLOCK];
+  for (int l = 0; l < BLOCK; l++)
+  {
+    const float halfDt = dt[l] / 2;
+    const float p = w[0][l] * -halfDt, q = w[1][l] * -halfDt, r = w[2][l] * -halfDt;
+    const float q0 = x[Q0][l], q1 = x[Q1][l], q2 = x[Q2][l], q3 = x[Q3][l];
+    const float n0 = q0 - (-p * q1 - q * q2 - r * q3);
+    const float n1 = q1 - (p * q0 + r * q2 - q * q3);
+    const float n2 = q2 - (q * q0 - r * q1 + p * q3);
+    const float n3 = q3 - (r * q0 + q * q1 - p * q2);
+    out[Q0][l] = n0;
+    out[Q1][l] = n1;
+    out[Q2][l] = n2;
+    out[Q3][l] = n3;
+    norm[l] = n0 * n0 + n1 * n1 + n2 * n2 + n3 * n3;
+  }
+  // square roots by themselves: with errno, a loop calling sqrtf doesn't vectorize
+  for (int l = 0; l < BLOCK; l++)
+  {
+    norm[l] = sqrtf(norm[l]);
+  }
+  // Quaternion::Normalise, identity if it's zero. divided and picked in loops of their
+  // own, in one the compiler would move the division behind the test and not vectorize
+  float normalised[4][BLOCK];
+  for (int i = 0; i < 4; i++)
+  {
+    for (int l = 0; l < BLOCK; l++)
+    {
+      normalised[i][l] = out[Q0 + i][l] / norm[l];
+    }
+  }
+  for (int l = 0; l < BLOCK; l++)
+  {
+    const bool zero = norm[l] == 0;
+    out[Q0][l] = zero ? 1.f : normalised[0][l];
+    out[Q1][l] = zero ? 0.f : normalised[1][l];
+    out[Q2][l] = zero ? 0.f : normalised[2][l];
+    out[Q3][l] = zero ? 0.f : normalised[3][l];
+  }
+
+  memcpy(&Output(0, first), out, sizeof(out));
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Common.h"
+#include <vector>
+
+class QuadDynamics;
+
+// Steps the rigid bodies of many vehicles in one pass.
+// Each vehicle owns a lane, which keeps a copy of its model. QuadDynamics::StageDynamics()
+// stages its state and motor commands in the lane, Flush() steps all staged lanes
+// together and QuadDynamics::FinishDynamics() collects the result. Lanes are stepped
+// in blocks of 8 like QuadEstimatorEKFBatch's, every step of the motor lag, mixer,
+// forces, rotation and integration one loop over the block that the compiler turns
+// into vector instructions. Unlike there, lanes are stored block by block, each block
+// structure-of-arrays: every step stages and collects each lane, and this way a lane's
+// components are a few cache lines rather than one per component.
+// Only the default model is batched: Euler or SemiImplicitEuler with the Fast
+// attitude update, in full 3D (see CanStep()).
+// Not thread-safe: stage, flush and collect from one thread.
+class QuadDynamicsBatch
+{
+public:
+  // lanes are stepped in blocks of this many
+  static const int BLOCK = 8;
+
+  QuadDynamicsBatch(int numLanes);
+
+  int NumLanes() const { return _numLanes; }
+
+  // whether the batch can step quad's model
+  static bool CanStep(const QuadDynamics& quad);
+
+  // copies the vehicle's model into the lane, for the steps staged from then on
+  void SetModel(int lane, const QuadDynamics& quad);
+
+  // copies the vehicle's state and motor commands into the lane, to be stepped by
+  // dt with the external force and moment at the next Flush()
+  void Stage(int lane, const QuadDynamics& quad, float dt, V3F external_force, V3F external_moment);
+  bool IsStaged(int lane) const { return _status[lane] == LANE_STAGED; }
+  bool IsStepped(int lane) const { return _status[lane] == LANE_STEPPED; }
+
+  // drops a staged lane, if its owner stepped it by itself after all
+  void Unstage(int lane);
+
+  // copies a stepped lane's state and lagged motor thrusts out and frees the lane
+  void Collect(int lane, QuadDynamics& quad);
+
+  // steps every staged lane. same math as QuadDynamics::StepEuler
+  void Flush();
+
+protected:
+  enum { LANE_IDLE, LANE_STAGED, LANE_STEPPED };
+
+  // the state, and what a step leaves behind
+  enum { POS_X, POS_Y, POS_Z, VEL_X, VEL_Y, VEL_Z, Q0, Q1, Q2, Q3, OMEGA_X, OMEGA_Y, OMEGA_Z, NUM_STATE,
+    ACC_X = NUM_STATE, ACC_Y, ACC_Z, THRUST, NUM_OUTPUTS = THRUST + 4 };
+
+  // the step's inputs, then the model (see SetModel()). MIX is the motor matrix, row-major
+  enum { INPUT_DT, INPUT_CMD, INPUT_OLD_CMD = INPUT_CMD + 4, INPUT_FORCE = INPUT_OLD_CMD + 4,
+    INPUT_MOMENT = INPUT_FORCE + 3, INPUT_TAU_UP = INPUT_MOMENT + 3, INPUT_TAU_DOWN, INPUT_MASS, INPUT_MIX,
+    INPUT_INERTIA = INPUT_MIX + 12, INPUT_INV_INERTIA = INPUT_INERTIA + 3, INPUT_SEMI_IMPLICIT = INPUT_INV_INERTIA + 3,
+    NUM_INPUTS };
+
+  // component k of lane, in v of numComponents components per lane
+  float& Lane(std::vector<float>& v, int numComponents, int k, int lane) { return v[(lane / BLOCK * numComponents + k) * BLOCK + lane % BLOCK]; }
+  float& State(int k, int lane) { return Lane(_state, NUM_STATE, k, lane); }
+  float& Input(int k, int lane) { return Lane(_inputs, NUM_INPUTS, k, lane); }
+  float& Output(int k, int lane) { return Lane(_outputs, NUM_OUTPUTS, k, lane); }
+
+  // steps lanes first..first+BLOCK-1
+  void StepBlock(int first);
+
+  int _numLanes, _capacity, _numStaged;
+  int _firstStaged, _lastStaged; // the lanes staged since the last Flush() are in between
+  std::vector<unsigned char> _status;
+
+  // staged lanes and their results. Flush() steps whole blocks, the result only
+  // depends on what was staged, so a lane that was stepped and not collected yet
+  // comes out the same
+  std::vector<float> _state;   // NUM_STATE components
+  std::vector<float> _inputs;  // NUM_INPUTS components
+  std::vector<float> _outputs; // NUM_OUTPUTS components
+};
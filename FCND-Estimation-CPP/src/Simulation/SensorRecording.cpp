@@ -0,0 +1,140 @@
+#include "Common.h"
+#include "SensorRecording.h"
+#include "BaseQuadEstimator.h"
+
+using namespace SLR;
+
+const int SensorEvent::MAX_VALUES;
+
+namespace
+{
+  vector<BinaryLogColumn> RecordingColumns()
+  {
+    vector<BinaryLogColumn> ret;
+    ret.push_back(BinaryLogColumn("time", BINLOG_DOUBLE));
+    ret.push_back(BinaryLogColumn("event"));
+    for (int i = 0; i < SensorEvent::MAX_VALUES; i++)
+    {
+      char buf[10];
+      sprintf_s(buf, 10, "v%d", i);
+      ret.push_back(BinaryLogColumn(buf));
+    }
+    return ret;
+  }
+}
+
+SensorRecorder::SensorRecorder(const string& filename)
+  : _log(filename, RecordingColumns())
+{
+  _time = 0;
+}
+
+void SensorRecorder::Record(SensorEventType type, const float* v, int n)
+{
+  _log.Set(0, _time);
+  _log.Set(1, (float)type);
+  for (int i = 0; i < n; i++)
+  {
+    _log.Set(2 + i, v[i]);
+  }
+  _log.EndRow();
+}
+
+void SensorRecorder::RecordTruth(V3F pos, V3F vel, Quaternion<float> att)
+{
+  float v[10] = { pos.x, pos.y, pos.z, vel.x, vel.y, vel.z, att[0], att[1], att[2], att[3] };
+  Record(SENSOR_TRUTH, v, 10);
+}
+
+void SensorRecorder::RecordIMU(V3F accel, V3F gyro)
+{
+  float v[7] = { 0, accel.x, accel.y, accel.z, gyro.x, gyro.y, gyro.z };
+  Record(SENSOR_IMU, v, 7);
+}
+
+void SensorRecorder::RecordGPS(V3F pos, V3F vel)
+{
+  float v[6] = { pos.x, pos.y, pos.z, vel.x, vel.y, vel.z };
+  Record(SENSOR_GPS, v, 6);
+}
+
+void SensorRecorder::RecordMag(float yaw)
+{
+  Record(SENSOR_MAG, &yaw, 1);
+}
+
+void SensorRecorder::RecordPredict(float dt, V3F accel, V3F gyro)
+{
+  float v[7] = { dt, accel.x, accel.y, accel.z, gyro.x, gyro.y, gyro.z };
+  Record(SENSOR_PREDICT, v, 7);
+}
+
+bool SensorRecording::Load(const string& filename)
+{
+  _events.clear();
+
+  BinaryLogReader log(filename);
+  vector<BinaryLogColumn> expected = RecordingColumns();
+  bool ok = log.IsOpen() && log.NumColumns() == (int)expected.size();
+  for (int i = 0; ok && i < log.NumColumns(); i++)
+  {
+    ok = log.Column(i).name == expected[i].name;
+  }
+  if (!ok)
+  {
+    SLR_WARNING1("%s is not a sensor recording", filename.c_str());
+    return false;
+  }
+
+  while (log.ReadChunk())
+  {
+    for (int r = 0; r < log.NumRows(); r++)
+    {
+      SensorEvent e;
+      e.time = log.Value(0, r);
+      e.type = (SensorEventType)(int)log.Value(1, r);
+      for (int i = 0; i < SensorEvent::MAX_VALUES; i++)
+      {
+        e.v[i] = (float)log.Value(2 + i, r);
+      }
+      _events.push_back(e);
+    }
+  }
+  return true;
+}
+
+void SensorRecording::Replay(BaseQuadEstimator& estimator, const std::function<void(const SensorEvent&)>& afterEvent) const
+{
+  for (unsigned int i = 0; i < _events.size(); i++)
+  {
+    const SensorEvent& e = _events[i];
+    const float* v = e.v;
+    switch (e.type)
+    {
+    case SENSOR_TRUTH:
+      estimator.UpdateTrueError(V3F(v[0], v[1], v[2]), V3F(v[3], v[4], v[5]), Quaternion<float>(v[6], v[7], v[8], v[9]));
+      break;
+    case SENSOR_IMU:
+      estimator.UpdateFromIMU(V3F(v[1], v[2], v[3]), V3F(v[4], v[5], v[6]));
+      if (v[0] > 0)
+      {
+        estimator.Predict(v[0], V3F(v[1], v[2], v[3]), V3F(v[4], v[5], v[6]));
+      }
+      break;
+    case SENSOR_PREDICT:
+      estimator.Predict(v[0], V3F(v[1], v[2], v[3]), V3F(v[4], v[5], v[6]));
+      break;
+    case SENSOR_GPS:
+      estimator.UpdateFromGPS(V3F(v[0], v[1], v[2]), V3F(v[3], v[4], v[5]));
+      break;
+    case SENSOR_MAG:
+      estimator.UpdateFromMag(v[0]);
+      break;
+    }
+
+    if (afterEvent)
+    {
+      afterEvent(e);
+    }
+  }
+}
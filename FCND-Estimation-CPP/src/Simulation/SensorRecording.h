@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Utility/BinaryLog.h"
+#include "Math/Quaternion.h"
+#include <vector>
+#include <functional>
+
+using SLR::Quaternion;
+
+class BaseQuadEstimator;
+
+// What a vehicle's estimator was fed during a simulation: every sensor measurement,
+// and the true state it was scored against, in the order they happened.
+// Recorded with SensorRecorder, replayed into an estimator with SensorRecording::Replay,
+// which reproduces the estimator's run exactly without any dynamics or control.
+//
+// Stored as a binary log (see BinaryLog.h) with the columns
+//   time, event, v0..v9
+// where event is a SensorEventType and v the event's values:
+//   SENSOR_TRUTH   pos.xyz vel.xyz att.wxyz
+//   SENSOR_IMU     dt accel.xyz gyro.xyz
+//   SENSOR_GPS     pos.xyz vel.xyz
+//   SENSOR_MAG     yaw
+//   SENSOR_PREDICT dt accel.xyz gyro.xyz
+// Recordings from before the estimator predicted on its own schedule have no
+// SENSOR_PREDICT, their IMU events predict over dt. It's 0 in newer ones
+enum SensorEventType { SENSOR_TRUTH = 0, SENSOR_IMU = 1, SENSOR_GPS = 2, SENSOR_MAG = 3, SENSOR_PREDICT = 4 };
+
+struct SensorEvent
+{
+  static const int MAX_VALUES = 10;
+
+  double time;
+  SensorEventType type;
+  float v[MAX_VALUES];
+};
+
+// Written to by the vehicle and its sensors (see QuadDynamics::sensorRecorder).
+// The clock is the vehicle's, set by SetTime()
+class SensorRecorder
+{
+public:
+  SensorRecorder(const string& filename);
+
+  bool IsOpen() const { return _log.IsOpen(); }
+
+  // the time of the events recorded next
+  void SetTime(double time) { _time = time; }
+
+  void RecordTruth(V3F pos, V3F vel, Quaternion<float> att);
+  void RecordIMU(V3F accel, V3F gyro);
+  void RecordGPS(V3F pos, V3F vel);
+  void RecordMag(float yaw);
+  void RecordPredict(float dt, V3F accel, V3F gyro);
+
+protected:
+  void Record(SensorEventType type, const float* v, int n);
+
+  SLR::BinaryLogWriter _log;
+  double _time;
+};
+
+// A recording loaded into memory
+class SensorRecording
+{
+public:
+  // false if the file couldn't be read or isn't a sensor recording
+  bool Load(const string& filename);
+
+  // feeds every event to estimator, in the order recorded, the way the sensors and
+  // the vehicle would have. afterEvent, if given, is called after each
+  void Replay(BaseQuadEstimator& estimator,
+    const std::function<void(const SensorEvent&)>& afterEvent = std::function<void(const SensorEvent&)>()) const;
+
+  // simulated time covered
+  double Duration() const { return _events.empty() ? 0 : _events.back().time; }
+
+  const std::vector<SensorEvent>& Events() const { return _events; }
+
+protected:
+  std::vector<SensorEvent> _events;
+};
@@ -4,11 +4,12 @@
 #include "QuadDynamics.h"
 #include "Math/Random.h"
 #include "BaseQuadEstimator.h"
+#include "SensorRecording.h"
 
 class SimulatedGPS : public SimulatedQuadSensor
 { 
 public:
-  SimulatedGPS(string config, string name) : SimulatedQuadSensor(config, name) { Init(); }
+  SimulatedGPS(string config, string name) : SimulatedQuadSensor(config, name) { Init(); AddFields(); }
 
   virtual void Init()
   {
@@ -22,69 +23,62 @@ public:
     _posRandomWalk = V3F();
   }
 
-  // if it's time, generates a new sensor measurement, saves it internally (for graphing), and calls appropriate estimator update function
-  virtual void Update(QuadDynamics& quad, shared_ptr<BaseQuadEstimator> estimator, float dt, int& idum)
+  virtual float Period() const { return _gpsDT; }
+
+  // generates a new sensor measurement, saves it internally (for graphing), and calls appropriate estimator update function
+  virtual void Update(QuadDynamics& quad, shared_ptr<BaseQuadEstimator> estimator)
   {
-    _timeAccum += dt;
-    if (_timeAccum < _gpsDT)
-    {
-      return;
-    }
+    float noise[9];
+    _rng.FillGaussian(noise, 9);
 
-    _timeAccum = (_timeAccum - _gpsDT);
-    
     // position
-    _posRandomWalk += V3F(gasdev_f(idum), gasdev_f(idum), gasdev_f(idum)) * _posRandomWalkStd;
-    V3F posError = V3F(gasdev_f(idum), gasdev_f(idum), gasdev_f(idum)) * _posStd + _posRandomWalk;
+    _posRandomWalk += V3F(noise[0], noise[1], noise[2]) * _posRandomWalkStd;
+    V3F posError = V3F(noise[3], noise[4], noise[5]) * _posStd + _posRandomWalk;
     _posMeas = quad.Position() + posError;
 
     // velocity
-    V3F velError = V3F(gasdev_f(idum), gasdev_f(idum), gasdev_f(idum)) * _velStd;
+    V3F velError = V3F(noise[6], noise[7], noise[8]) * _velStd;
     _velMeas = quad.Velocity() + velError;
 
     _freshMeas = true;
 
+    if (quad.sensorRecorder)
+    {
+      quad.sensorRecorder->RecordGPS(_posMeas, _velMeas);
+    }
+
     if (estimator)
     {
       estimator->UpdateFromGPS(_posMeas, _velMeas);
     }
   };
 
-  // Access functions for graphing variables
-  // note that GetData will only return true if a fresh measurement was generated last Update()
-  virtual bool GetData(const string& name, float& ret) const 
+  virtual void SaveState(SLR::StateBuffer& s)
   {
-    if (!_freshMeas) return false;
-
-    if (name.find_first_of(".") == string::npos) return false;
-    string leftPart = LeftOf(name, '.');
-    string rightPart = RightOf(name, '.');
-
-    if (ToUpper(leftPart) == ToUpper(_name))
-    {
-#define GETTER_HELPER(A,B) if (SLR::ToUpper(rightPart) == SLR::ToUpper(A)){ ret=(B); return true; }
-      GETTER_HELPER("GPS.X", _posMeas.x);
-      GETTER_HELPER("GPS.Y", _posMeas.y);
-      GETTER_HELPER("GPS.Z", _posMeas.z);
-      GETTER_HELPER("GPS.VX", _velMeas.x);
-      GETTER_HELPER("GPS.VY", _velMeas.y);
-      GETTER_HELPER("GPS.VZ", _velMeas.z);
-#undef GETTER_HELPER
-    }
-    return false; 
-  };
+    SimulatedQuadSensor::SaveState(s);
+    s.Put(_posMeas);
+    s.Put(_velMeas);
+    s.Put(_posRandomWalk);
+  }
+  virtual bool LoadState(SLR::StateBuffer& s)
+  {
+    SimulatedQuadSensor::LoadState(s);
+    s.Get(_posMeas);
+    s.Get(_velMeas);
+    s.Get(_posRandomWalk);
+    return !s.Failed();
+  }
 
-  virtual vector<string> GetFields() const 
-  { 
-    vector<string> ret = SimulatedQuadSensor::GetFields();
-    ret.push_back(_name + ".GPS.x");
-    ret.push_back(_name + ".GPS.y");
-    ret.push_back(_name + ".GPS.z");
-    ret.push_back(_name + ".GPS.vx");
-    ret.push_back(_name + ".GPS.vy");
-    ret.push_back(_name + ".GPS.vz");
-    return ret;
-  };
+  // graphing variables, published once. they only have data if a fresh measurement was generated last Update()
+  void AddFields()
+  {
+    AddField(_name + ".GPS.x", &_posMeas.x, &_freshMeas);
+    AddField(_name + ".GPS.y", &_posMeas.y, &_freshMeas);
+    AddField(_name + ".GPS.z", &_posMeas.z, &_freshMeas);
+    AddField(_name + ".GPS.vx", &_velMeas.x, &_freshMeas);
+    AddField(_name + ".GPS.vy", &_velMeas.y, &_freshMeas);
+    AddField(_name + ".GPS.vz", &_velMeas.z, &_freshMeas);
+  }
 
   V3F _posMeas, _velMeas;
   V3F _posRandomWalk;
@@ -4,11 +4,12 @@
 #include "QuadDynamics.h"
 #include "Math/Random.h"
 #include "BaseQuadEstimator.h"
+#include "SensorRecording.h"
 
 class SimulatedMag : public SimulatedQuadSensor
 { 
 public:
-  SimulatedMag(string config, string name) : SimulatedQuadSensor(config, name) { Init(); }
+  SimulatedMag(string config, string name) : SimulatedQuadSensor(config, name) { Init(); AddFields(); }
 
   virtual void Init()
   {
@@ -19,56 +20,47 @@ public:
 		_magYaw = 0;
   }
 
-  // if it's time, generates a new sensor measurement, saves it internally (for graphing), and calls appropriate estimator update function
-  virtual void Update(QuadDynamics& quad, shared_ptr<BaseQuadEstimator> estimator, float dt, int& idum)
-  {
-    _timeAccum += dt;
-    if (_timeAccum < _measDT)
-    {
-      return;
-    }
+  virtual float Period() const { return _measDT; }
 
-    _timeAccum = (_timeAccum - _measDT);
-    
+  // generates a new sensor measurement, saves it internally (for graphing), and calls appropriate estimator update function
+  virtual void Update(QuadDynamics& quad, shared_ptr<BaseQuadEstimator> estimator)
+  {
     // position
-    float magError = gasdev_f(idum) * _magStd;
+    float magError = _rng.Gaussian() * _magStd;
     _magYaw = quad.Attitude().Yaw() + magError;
 		if (_magYaw > F_PI) _magYaw -= 2.f*F_PI;
 		if (_magYaw < -F_PI) _magYaw += 2.f*F_PI;
 
     _freshMeas = true;
 
+    if (quad.sensorRecorder)
+    {
+      quad.sensorRecorder->RecordMag(_magYaw);
+    }
+
     if (estimator)
     {
       estimator->UpdateFromMag(_magYaw);
     }
   };
 
-  // Access functions for graphing variables
-  // note that GetData will only return true if a fresh measurement was generated last Update()
-  virtual bool GetData(const string& name, float& ret) const 
+  virtual void SaveState(SLR::StateBuffer& s)
   {
-    if (!_freshMeas) return false;
-
-    if (name.find_first_of(".") == string::npos) return false;
-    string leftPart = LeftOf(name, '.');
-    string rightPart = RightOf(name, '.');
-
-    if (ToUpper(leftPart) == ToUpper(_name))
-    {
-#define GETTER_HELPER(A,B) if (SLR::ToUpper(rightPart) == SLR::ToUpper(A)){ ret=(B); return true; }
-      GETTER_HELPER("magYaw", _magYaw);
-#undef GETTER_HELPER
-    }
-    return false; 
-  };
+    SimulatedQuadSensor::SaveState(s);
+    s.Put(_magYaw);
+  }
+  virtual bool LoadState(SLR::StateBuffer& s)
+  {
+    SimulatedQuadSensor::LoadState(s);
+    s.Get(_magYaw);
+    return !s.Failed();
+  }
 
-  virtual vector<string> GetFields() const 
-  { 
-    vector<string> ret = SimulatedQuadSensor::GetFields();
-    ret.push_back(_name + ".MagYaw");
-    return ret;
-  };
+  // graphing variables, published once. they only have data if a fresh measurement was generated last Update()
+  void AddFields()
+  {
+    AddField(_name + ".MagYaw", &_magYaw, &_freshMeas);
+  }
 
 	float _magYaw;	// last yaw measurement from magnetometer
 	float _magStd;	// std deviation of noise for magnetometer measurements
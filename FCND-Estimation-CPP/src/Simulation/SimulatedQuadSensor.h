@@ -1,5 +1,9 @@
 #pragma once
 
+#include "Math/Random.h"
+#include "Utility/SimpleConfig.h"
+#include "Utility/StateBuffer.h"
+
 class BaseQuadEstimator;
 
 class SimulatedQuadSensor : public DataSource
@@ -10,20 +14,38 @@ public:
   virtual void Init() 
   {
     _freshMeas = false;
-    _timeAccum = 0;
+    _phase = SimpleConfig::GetInstance()->Get(_config + ".Phase", 0.f);
   };
+
+  // time between measurements [s]. the vehicle takes one every Period(), starting at _phase
+  virtual float Period() const = 0;
   
-  // if it's time, generates a new sensor measurement, saves it internally (for graphing), and calls appropriate estimator update function
-  virtual void Update(QuadDynamics& quadDynamics, shared_ptr<BaseQuadEstimator> estimator, float dt, int& idum) {};
+  // generates a new sensor measurement, saves it internally (for graphing), and calls appropriate estimator update function.
+  // called every Period()
+  virtual void Update(QuadDynamics& quadDynamics, shared_ptr<BaseQuadEstimator> estimator) {};
 
-  // Access functions for graphing variables
-  // note that GetData will only return true if a fresh measurement was generated last Update()
-  virtual bool GetData(const string& name, float& ret) const { return false; };
-  virtual vector<string> GetFields() const { return vector<string>(); };
+  // graphing variables are published with _freshMeas as their fresh flag, so they only
+  // have data if a fresh measurement was generated last Update()
   virtual void FinalizeDataFrame() { _freshMeas = false; }
 
+  // the measurement and noise state, for snapshots (see BaseDynamics::SaveState)
+  virtual void SaveState(SLR::StateBuffer& s)
+  {
+    s.Put(_freshMeas);
+    s.Put(_rng);
+  }
+  virtual bool LoadState(SLR::StateBuffer& s)
+  {
+    s.Get(_freshMeas);
+    s.Get(_rng);
+    return !s.Failed();
+  }
+
   string _config, _name;
   bool _freshMeas;
-  float _timeAccum;
+  float _phase; // time of the first measurement [s], from <config>.Phase
+
+  // measurement noise source, seeded by the owning vehicle
+  RandomStream _rng;
 };
 
@@ -1,32 +1,461 @@
 #include "Common.h"
 #include "Simulator.h"
 #include "Utility/SimpleConfig.h"
-#include "Simulation/BaseDynamics.h"
+#include "Utility/StringUtils.h"
+#include "QuadEstimatorEKFBatch.h"
+#include "QuadDynamicsBatch.h"
+#include "SensorRecording.h"
+#include <algorithm>
 using namespace SLR;
 
+// vehicles batched together: vehicle i has lane i % BATCH_GROUP_SIZE of the batches of
+// group i / BATCH_GROUP_SIZE. small enough for a group's vehicles to stay in cache
+// through RunStepsBatched, and the groups are what it spreads over the worker threads
+static const int BATCH_GROUP_SIZE = 8 * QuadDynamicsBatch::BLOCK;
+
+// batches with a lane for each of numVehicles vehicles, group by group, kept if they already are
+template <typename Batch> static void SizeBatches(vector<shared_ptr<Batch> >& batches, int numVehicles)
+{
+	int numLanes = 0;
+	for (unsigned int i = 0; i < batches.size(); i++)
+	{
+		numLanes += batches[i]->NumLanes();
+	}
+	if (!batches.empty() && numLanes == numVehicles)
+	{
+		return;
+	}
+
+	batches.clear();
+	for (int first = 0; first < numVehicles; first += BATCH_GROUP_SIZE)
+	{
+		batches.push_back(shared_ptr<Batch>(new Batch(MIN(BATCH_GROUP_SIZE, numVehicles - first))));
+	}
+}
+
 Simulator::Simulator()
 {
-	Reset();
+	_simTime = 0;
+	_dtSim = 0.001f;
+	_endTime = -1;
+	_repeat = false;
+	_simCount = 0;
+	_numThreads = 1;
+	_workersNumThreads = 1;
+	_runNumber = 0;
+	_firstVehicle = 0;
 }
 
-void Simulator::Reset()
+void Simulator::LoadScenario(const string& scenarioFile, int firstVehicle, int numVehicles)
 {
 	ParamsHandle config = SimpleConfig::GetInstance();
+	_scenarioFile = scenarioFile;
+	config->Reset(scenarioFile);
+
+	_firstVehicle = firstVehicle;
+	_vehicles = CreateVehicles(firstVehicle, numVehicles);
+}
+
+void Simulator::Reset(int runNumber)
+{
+	_simCount++;
+	ParamsHandle config = SimpleConfig::GetInstance();
+
+	printf("Simulation #%d (%s)\n", _simCount, _scenarioFile.c_str());
+
+	_simTime = 0;
 
-	// TODO: parameters
+	config->Reset(_scenarioFile);
+	_dtSim = config->Get("Sim.Timestep", 0.005f);
+	_endTime = config->Get("Sim.EndTime", -1.f);
+	_repeat = ToUpper(config->Get("Sim.RunMode", "Continuous")) == "REPEAT";
 
+	// 1 = step vehicles serially, 0 = one thread per core
+	_numThreads = config->Get("Sim.NumThreads", 1);
+
+	_runNumber = runNumber >= 0 ? runNumber : config->Get("Sim.RunNumber", 0);
+
+	// kept across resets while the vehicle count matches
+	if (config->Get("Sim.BatchEstimators", 0) == 0)
+	{
+		_estimatorBatches.clear();
+	}
+	else
+	{
+		SizeBatches(_estimatorBatches, (int)_vehicles.size());
+	}
+	if (config->Get("Sim.BatchDynamics", 0) == 0)
+	{
+		_dynamicsBatches.clear();
+	}
+	else
+	{
+		SizeBatches(_dynamicsBatches, (int)_vehicles.size());
+	}
+
+	for (unsigned int i = 0; i < _vehicles.size(); i++)
+	{
+		int group = (int)i / BATCH_GROUP_SIZE, lane = (int)i % BATCH_GROUP_SIZE;
+		_vehicles[i]->SetEstimatorBatch(_estimatorBatches.empty() ? shared_ptr<QuadEstimatorEKFBatch>() : _estimatorBatches[group], lane);
+		_vehicles[i]->SetDynamicsBatch(_dynamicsBatches.empty() ? shared_ptr<QuadDynamicsBatch>() : _dynamicsBatches[group], lane);
+		_vehicles[i]->Reset();
+
+		// the previous run's recording is closed before the file is reopened
+		_vehicles[i]->sensorRecorder.reset();
+		if (_sensorRecordFile != "")
+		{
+			_vehicles[i]->sensorRecorder.reset(new SensorRecorder(SensorRecordFile(_vehicles[i]->GetName())));
+		}
+	}
+	SeedRandomStreams();
+}
+
+void Simulator::SeedRandomStreams()
+{
+	// noise streams are a function of scenario, vehicle and run number only, so
+	// the result doesn't depend on stepping order or on the other vehicles, or on
+	// whether they are simulated at all
+	// (keyed on the bare file name, so ../config/X.txt and config/X.txt agree)
+	string scenarioName = _scenarioFile.substr(_scenarioFile.find_last_of("/\\") + 1);
+	scenarioName = scenarioName.substr(0, scenarioName.rfind('.'));
 	for (unsigned int i = 0; i < _vehicles.size(); i++)
 	{
-		_vehicles[i]->Initialize();
+		_vehicles[i]->SeedRandomStreams(RandomStream::MakeKey(scenarioName, _firstVehicle + (int)i, _runNumber));
 	}
 }
 
-void Simulator::Run(float dt)
+string Simulator::SensorRecordFile(const string& vehicleName) const
 {
-	// todo: step in maximally acceptable time steps
+	size_t dot = _sensorRecordFile.find_last_of('.');
+	size_t slash = _sensorRecordFile.find_last_of("/\\");
+	if (dot == string::npos || (slash != string::npos && dot < slash))
+	{
+		return _sensorRecordFile + "_" + vehicleName;
+	}
+	return _sensorRecordFile.substr(0, dot) + "_" + vehicleName + _sensorRecordFile.substr(dot);
+}
+
+void Simulator::Run(V3F externalForce, V3F externalMoment)
+{
+	RunSteps(1, externalForce, externalMoment);
+}
+
+void Simulator::RunSteps(int numSteps, V3F externalForce, V3F externalMoment)
+{
+	if (!_estimatorBatches.empty() || !_dynamicsBatches.empty())
+	{
+		RunStepsBatched(numSteps, externalForce, externalMoment);
+		PublishTelemetry();
+		return;
+	}
+
+	float startTime = _simTime;
+	float dt = _dtSim;
+
+	auto stepVehicle = [&](int i)
+	{
+		float t = startTime;
+		for (int step = 0; step < numSteps; step++)
+		{
+			_vehicles[i]->Run(dt, t, externalForce, externalMoment);
+			t += dt;
+		}
+	};
+
+	RunTasks((int)_vehicles.size(), stepVehicle);
+
+	for (int step = 0; step < numSteps; step++)
+	{
+		_simTime += _dtSim;
+	}
+
+	PublishTelemetry();
 }
 
-void Simulator::AddVehicle(shared_ptr<BaseDynamics> vehicle)
+void Simulator::RunStepsBatched(int numSteps, V3F externalForce, V3F externalMoment)
 {
-	_vehicles.push_back(vehicle);
+	// QuadDynamics::Run, one loop pass at a time for a group of vehicles. The predictions
+	// of every vehicle whose estimator is due run together, before the controllers, and
+	// the rigid bodies step together after them. The groups have batches of their own and
+	// don't depend on each other, so each runs all steps by itself, while its vehicles are
+	// in cache, and the groups run on the worker threads
+	vector<double> remaining(_vehicles.size()), stepped(_vehicles.size());
+	auto stepGroup = [&](int group)
+	{
+		const int first = group * BATCH_GROUP_SIZE;
+		const int last = MIN(first + BATCH_GROUP_SIZE, (int)_vehicles.size());
+		QuadEstimatorEKFBatch* estimatorBatch = _estimatorBatches.empty() ? NULL : _estimatorBatches[group].get();
+		QuadDynamicsBatch* dynamicsBatch = _dynamicsBatches.empty() ? NULL : _dynamicsBatches[group].get();
+		float t = _simTime;
+		for (int step = 0; step < numSteps; step++)
+		{
+			std::fill(remaining.begin() + first, remaining.begin() + last, (double)_dtSim);
+
+			bool anyLeft = true;
+			while (anyLeft)
+			{
+				for (int i = first; i < last; i++)
+				{
+					if (remaining[i] > 0.000001)
+					{
+						_vehicles[i]->RunDueEvents(true);
+					}
+				}
+
+				// the vehicles have staged their estimators' predictions
+				if (estimatorBatch)
+				{
+					estimatorBatch->Flush();
+				}
+
+				for (int i = first; i < last; i++)
+				{
+					if (remaining[i] <= 0.000001) continue;
+					_vehicles[i]->RunDueEvents();
+					stepped[i] = _vehicles[i]->StageDynamics(remaining[i], t, externalForce, externalMoment);
+				}
+
+				if (dynamicsBatch)
+				{
+					dynamicsBatch->Flush();
+				}
+
+				anyLeft = false;
+				for (int i = first; i < last; i++)
+				{
+					if (remaining[i] <= 0.000001) continue;
+					_vehicles[i]->FinishDynamics();
+					remaining[i] -= stepped[i];
+					anyLeft = anyLeft || remaining[i] > 0.000001;
+				}
+			}
+
+			t += _dtSim;
+		}
+	};
+	RunTasks(((int)_vehicles.size() + BATCH_GROUP_SIZE - 1) / BATCH_GROUP_SIZE, stepGroup);
+
+	for (int step = 0; step < numSteps; step++)
+	{
+		_simTime += _dtSim;
+	}
 }
+
+void Simulator::RunTasks(int numTasks, const std::function<void(int)>& fn)
+{
+	if (_numThreads != 1 && numTasks > 1)
+	{
+		if (!_workers || _workersNumThreads != _numThreads)
+		{
+			_workers.reset(new WorkerPool(_numThreads));
+			_workersNumThreads = _numThreads;
+		}
+		_workers->Run(numTasks, fn);
+	}
+	else
+	{
+		for (int i = 0; i < numTasks; i++)
+		{
+			fn(i);
+		}
+	}
+}
+
+void Simulator::PublishTelemetry()
+{
+	if (!_telemetry) return;
+
+	for (unsigned int i = 0; i < _vehicles.size(); i++)
+	{
+		TelemetryFrame f;
+		GetTelemetryFrame((int)i, f);
+		_telemetry->Publish(f);
+	}
+}
+
+void Simulator::GetTelemetryFrame(int i, TelemetryFrame& f)
+{
+	QuadDynamics& quad = *_vehicles[i];
+	memset(&f, 0, sizeof(f));
+	f.time = _simTime;
+	f.vehicle = _firstVehicle + i;
+
+	V3F pos = quad.Position(), vel = quad.Velocity(), omega = quad.Omega();
+	Quaternion<float> att = quad.Attitude();
+	for (int j = 0; j < 3; j++)
+	{
+		f.pos[j] = pos[j];
+		f.vel[j] = vel[j];
+		f.omega[j] = omega[j];
+	}
+	for (int j = 0; j < 4; j++)
+	{
+		f.att[j] = att[j];
+		f.thrust[j] = quad.GetMotorThrust(j);
+	}
+
+	if (quad.estimator)
+	{
+		V3F estPos = quad.estimator->EstimatedPosition(), estVel = quad.estimator->EstimatedVelocity();
+		Quaternion<float> estAtt = quad.estimator->EstimatedAttitude();
+		for (int j = 0; j < 3; j++)
+		{
+			f.estPos[j] = estPos[j];
+			f.estVel[j] = estVel[j];
+		}
+		for (int j = 0; j < 4; j++)
+		{
+			f.estAtt[j] = estAtt[j];
+		}
+		quad.estimator->GetStateVariances(f.estVar);
+	}
+}
+
+// "SNP1", then the clock and per vehicle its name, the size of its state and the state
+static const uint32_t SNAPSHOT_MAGIC = 0x31504e53;
+
+void Simulator::SaveSnapshot(StateBuffer& snapshot)
+{
+	snapshot.Put(SNAPSHOT_MAGIC);
+	snapshot.Put(_simTime);
+	snapshot.Put((uint32_t)_vehicles.size());
+
+	StateBuffer vehicle;
+	for (unsigned int i = 0; i < _vehicles.size(); i++)
+	{
+		vehicle.Clear();
+		_vehicles[i]->SaveState(vehicle);
+		snapshot.PutString(_vehicles[i]->GetName());
+		snapshot.Put((uint32_t)vehicle.Size());
+		snapshot.PutArray(vehicle.Data(), (int)vehicle.Size());
+	}
+}
+
+bool Simulator::RestoreSnapshot(StateBuffer& snapshot, bool reseed)
+{
+	// checked whole before any vehicle is touched, so one that doesn't fit changes nothing
+	float simTime = 0;
+	if (!ReadSnapshotHeader(snapshot, simTime))
+	{
+		return false;
+	}
+	for (unsigned int i = 0; i < _vehicles.size(); i++)
+	{
+		uint32_t size = 0;
+		if (!ReadSnapshotVehicle(snapshot, i, size))
+		{
+			return false;
+		}
+		if (!snapshot.Skip(size))
+		{
+			SLR_WARNING1("The snapshot of %s is cut short", _vehicles[i]->GetName().c_str());
+			return false;
+		}
+	}
+
+	// whether a state is of the same controller, estimator and sensors only shows when
+	// loading it, so the current states go back if one isn't
+	StateBuffer backup;
+	for (unsigned int i = 0; i < _vehicles.size(); i++)
+	{
+		_vehicles[i]->SaveState(backup);
+	}
+
+	ReadSnapshotHeader(snapshot, simTime);
+	for (unsigned int i = 0; i < _vehicles.size(); i++)
+	{
+		uint32_t size = 0;
+		ReadSnapshotVehicle(snapshot, i, size);
+		size_t start = snapshot.ReadPos();
+		if (!_vehicles[i]->LoadState(snapshot) || snapshot.ReadPos() - start != size)
+		{
+			SLR_WARNING1("The snapshot of %s is of another controller, estimator or set of sensors", _vehicles[i]->GetName().c_str());
+			for (unsigned int j = 0; j <= i; j++)
+			{
+				_vehicles[j]->LoadState(backup);
+			}
+			return false;
+		}
+	}
+
+	_simTime = simTime;
+	if (reseed)
+	{
+		SeedRandomStreams();
+	}
+	return true;
+}
+
+bool Simulator::ReadSnapshotHeader(StateBuffer& snapshot, float& simTime)
+{
+	snapshot.Rewind();
+	uint32_t magic = 0, numVehicles = 0;
+	snapshot.Get(magic);
+	snapshot.Get(simTime);
+	snapshot.Get(numVehicles);
+	if (snapshot.Failed() || magic != SNAPSHOT_MAGIC)
+	{
+		SLR_WARNING0("Not a simulation snapshot");
+		return false;
+	}
+	if (numVehicles != (uint32_t)_vehicles.size())
+	{
+		SLR_WARNING2("The snapshot has %d vehicles, the scenario %d", (int)numVehicles, (int)_vehicles.size());
+		return false;
+	}
+	return true;
+}
+
+bool Simulator::ReadSnapshotVehicle(StateBuffer& snapshot, int i, uint32_t& size)
+{
+	string name;
+	snapshot.GetString(name);
+	snapshot.Get(size);
+	if (snapshot.Failed() || name != _vehicles[i]->GetName())
+	{
+		SLR_WARNING2("Vehicle %d of the snapshot isn't %s", i + 1, _vehicles[i]->GetName().c_str());
+		return false;
+	}
+	return true;
+}
+
+bool Simulator::EndTimeReached() const
+{
+	return _endTime > 0 && _simTime >= _endTime;
+}
+
+vector<string> Simulator::ScenarioVehicleNames()
+{
+	vector<string> ret;
+
+	ParamsHandle config = SimpleConfig::GetInstance();
+	int i = 1;
+	while (1)
+	{
+		char buf[100];
+		sprintf_s(buf, 100, "Sim.Vehicle%d", i);
+		if (config->Exists(buf))
+		{
+			ret.push_back(config->Get(buf, "Quad"));
+		}
+		else
+		{
+			break;
+		}
+		i++;
+	}
+	return ret;
+}
+
+vector<QuadcopterHandle> Simulator::CreateVehicles(int firstVehicle, int numVehicles)
+{
+	vector<QuadcopterHandle> ret;
+
+	vector<string> names = ScenarioVehicleNames();
+	int last = numVehicles < 0 ? (int)names.size() : MIN(firstVehicle + numVehicles, (int)names.size());
+	for (int i = firstVehicle; i < last; i++)
+	{
+		ret.push_back(QuadDynamics::Create(names[i], i));
+	}
+	return ret;
+}
\ No newline at end of file
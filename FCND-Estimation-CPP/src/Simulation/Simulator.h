@@ -1,22 +1,114 @@
 #pragma once
 
 #include <vector>
+#include "Simulation/QuadDynamics.h"
+#include "Utility/WorkerPool.h"
+#include "Utility/TelemetryBus.h"
+#include "Utility/StateBuffer.h"
 
 using namespace std;
 
-class BaseDynamics;
+class QuadEstimatorEKFBatch;
+class QuadDynamicsBatch;
 
+// Owns the simulated vehicles and the simulation clock for one scenario.
+// Contains no drawing or windowing code so the GLUT app and the headless
+// runner step the simulation identically.
 class Simulator
 {
 public:
 	Simulator();
 
-	void Reset();
+	// reads the scenario config and creates the vehicles listed as Sim.Vehicle1..N.
+	// with numVehicles >= 0 only Sim.Vehicle<firstVehicle+1>..<firstVehicle+numVehicles> are
+	// created, and they are simulated exactly as they would be along with all the others
+	void LoadScenario(const string& scenarioFile, int firstVehicle = 0, int numVehicles = -1);
 
-	void Run(float dt);
+	// names of the vehicles listed as Sim.Vehicle1..N in the loaded config
+	static vector<string> ScenarioVehicleNames();
 
-	void AddVehicle(shared_ptr<BaseDynamics> vehicle);
+	// re-reads the scenario config, re-initializes every vehicle and rewinds the clock.
+	// runNumber selects the noise realization, -1 uses Sim.RunNumber
+	void Reset(int runNumber = -1);
 
-	vector<shared_ptr<BaseDynamics> > _vehicles;
+	// advances every vehicle by one Sim.Timestep
+	void Run(V3F externalForce = V3F(), V3F externalMoment = V3F());
+
+	// advances every vehicle by numSteps Sim.Timesteps. Vehicles are independent
+	// between frames, so with Sim.NumThreads != 1 each one runs its steps on a
+	// worker thread; results are identical to the serial path.
+	// With Sim.BatchEstimators = 1 the vehicles are stepped in lockstep instead (see RunStepsBatched)
+	void RunSteps(int numSteps, V3F externalForce = V3F(), V3F externalMoment = V3F());
+
+	// true once the clock has reached a positive Sim.EndTime
+	bool EndTimeReached() const;
+
+	// appends the state of the whole simulation between RunSteps() calls to snapshot:
+	// the clock and every vehicle's state (see QuadDynamics::SaveState)
+	void SaveSnapshot(SLR::StateBuffer& snapshot);
+
+	// goes back to a snapshot of the same vehicles, in a few microseconds per vehicle.
+	// the parameters stay as the last Reset() read them, so a snapshot can be restored
+	// into a variation of its scenario (gains, noise, disturbances) as long as the vehicles'
+	// controllers, estimators and sensors are the same. the random streams are restored too,
+	// so the run goes on exactly as the saved one did, unless reseed, which seeds them for
+	// _runNumber instead to branch off with other noise.
+	// false if the snapshot doesn't fit, and then the simulation is as it was
+	bool RestoreSnapshot(SLR::StateBuffer& snapshot, bool reseed = false);
+
+	// if set, RunSteps publishes one frame per vehicle on it after every call.
+	// publishing only copies the frame into the bus, the consumers do any I/O on their own threads
+	shared_ptr<SLR::TelemetryBus> _telemetry;
+
+	// if set, every Reset() starts recording each vehicle's sensor measurements and true
+	// state (see SensorRecording.h) to <file name>_<vehicle name>.<extension>
+	string _sensorRecordFile;
+
+	// _sensorRecordFile for the vehicle called name
+	string SensorRecordFile(const string& vehicleName) const;
+
+	// frame of vehicle i, as published on _telemetry
+	void GetTelemetryFrame(int i, SLR::TelemetryFrame& f);
+
+	vector<QuadcopterHandle> _vehicles;
+	int _firstVehicle; // the scenario's index of _vehicles[0]
 	float _simTime;
-};
\ No newline at end of file
+	float _dtSim;
+	float _endTime;
+	bool _repeat;
+	int _simCount;
+	int _runNumber; // noise realization of the current run
+	int _numThreads; // Sim.NumThreads, may be overridden after Reset()
+	string _scenarioFile;
+
+protected:
+	vector<QuadcopterHandle> CreateVehicles(int firstVehicle, int numVehicles);
+
+	// RunSteps with the vehicles' EKFs predicting in _estimatorBatches and their rigid
+	// bodies stepping in _dynamicsBatches, either of them optional, group by group: all
+	// vehicles of the group run their due sensors and predictions, its estimator batch
+	// predicts for all of them at once, they run their controllers and stage their steps,
+	// and its dynamics batch steps them at once. The groups run on the worker threads.
+	// Results are identical to RunSteps without the batches
+	void RunStepsBatched(int numSteps, V3F externalForce, V3F externalMoment);
+
+	// RestoreSnapshot's reading of the snapshot's start, and of vehicle i's name and state
+	// size after it. false, with a warning, if they aren't of this scenario
+	bool ReadSnapshotHeader(SLR::StateBuffer& snapshot, float& simTime);
+	bool ReadSnapshotVehicle(SLR::StateBuffer& snapshot, int i, uint32_t& size);
+
+	void PublishTelemetry();
+
+	// seeds every vehicle's random streams for _runNumber
+	void SeedRandomStreams();
+
+	// fn(0)..fn(numTasks-1), on _workers unless _numThreads is 1
+	void RunTasks(int numTasks, const std::function<void(int)>& fn);
+
+	// one per group of vehicles, each vehicle a lane (see BATCH_GROUP_SIZE)
+	vector<shared_ptr<QuadEstimatorEKFBatch> > _estimatorBatches;
+	vector<shared_ptr<QuadDynamicsBatch> > _dynamicsBatches;
+
+	shared_ptr<SLR::WorkerPool> _workers;
+	int _workersNumThreads; // _numThreads the pool was created for
+};
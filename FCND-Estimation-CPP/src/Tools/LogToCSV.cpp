@@ -0,0 +1,41 @@
+// Converts binary logs (graph logs from LogToFile, data logs from Sim.DataLogFile)
+// to CSV text: a header line of column names, then one line per row, with
+// NaN where a variable had no new data.
+//
+// usage: LogToCSV <log.bin> [<out.csv>]
+// without an output file, writes next to the log with a .txt extension,
+// e.g. ../config/log/Graph1.bin -> ../config/log/Graph1.txt
+// exit code: 0 on success, 1 if a file couldn't be read or written
+
+#include "Common.h"
+#include "Utility/BinaryLog.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2 || argc > 3)
+  {
+    printf("usage: LogToCSV <log.bin> [<out.csv>]\n");
+    return 1;
+  }
+
+  string in = argv[1];
+  string out;
+  if (argc == 3)
+  {
+    out = argv[2];
+  }
+  else
+  {
+    size_t dot = in.find_last_of('.');
+    size_t slash = in.find_last_of("/\\");
+    out = (dot != string::npos && (slash == string::npos || dot > slash)) ? in.substr(0, dot) : in;
+    out += ".txt";
+  }
+
+  if (!SLR::ConvertBinaryLogToCSV(in, out))
+  {
+    return 1;
+  }
+  printf("%s -> %s\n", in.c_str(), out.c_str());
+  return 0;
+}
@@ -0,0 +1,39 @@
+// Converts text trajectory files (config/traj/*.txt) to the binary trajectory
+// format (see src/TrajectoryFile.h), which is memory-mapped instead of parsed
+// when a scenario loads it. Point the controller config at the .bin file, e.g.
+//   QuadControlParams.Trajectory = traj/FigureEight.bin
+//
+// usage: TrajToBin <traj.txt> [<traj.txt> ...]
+// writes each next to its text file with a .bin extension,
+// e.g. ../config/traj/FigureEight.txt -> ../config/traj/FigureEight.bin
+// exit code: 0 on success, 1 if a file couldn't be read or written
+
+#include "Common.h"
+#include "TrajectoryFile.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+  {
+    printf("usage: TrajToBin <traj.txt> [<traj.txt> ...]\n");
+    return 1;
+  }
+
+  int ret = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    string in = argv[i];
+    size_t dot = in.find_last_of('.');
+    size_t slash = in.find_last_of("/\\");
+    string out = (dot != string::npos && (slash == string::npos || dot > slash)) ? in.substr(0, dot) : in;
+    out += ".bin";
+
+    if (!ConvertTrajectoryToBinary(in, out))
+    {
+      ret = 1;
+      continue;
+    }
+    printf("%s -> %s\n", in.c_str(), out.c_str());
+  }
+  return ret;
+}
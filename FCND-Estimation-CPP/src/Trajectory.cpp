@@ -2,16 +2,41 @@
 #include "Trajectory.h"
 #include "Utility/SimpleConfig.h"
 #include "Utility/StringUtils.h"
+#include "Utility/FileStamp.h"
+#include <mutex>
+#include <map>
+#include <algorithm>
 
 using namespace SLR;
 
+namespace
+{
+  struct TrajectoryFile
+  {
+    FileStamp stamp;
+    shared_ptr<TrajectoryPoints> points;
+    shared_ptr<const TrajectorySpline> spline;
+  };
+
+  // points drawn per spline segment
+  const int SPLINE_DRAW_POINTS = 20;
+
+  // every trajectory file read so far, by name
+  std::mutex s_filesMutex;
+  map<string, TrajectoryFile> s_files;
+}
+
 Trajectory::Trajectory() 
 {
   _log_file = NULL;
+  _curTrajPoint = 0;
+  _traj.reset(new TrajectoryPoints());
 }
 
 Trajectory::Trajectory(const string& filename) 
 {
+  _log_file = NULL;
+  _curTrajPoint = 0;
   ReadFile(filename);
 }
 
@@ -26,31 +51,16 @@ Trajectory::~Trajectory()
 
 bool Trajectory::ReadFile(const string& filename)
 {
-  traj.clear();
-
-  FILE* f = fopen(filename.c_str(), "r");
-  if (!f)
+  _curTrajPoint = 0;
+  if (!LoadFile(filename))
   {
     return false;
   }
 
-  char buf[512];
-  buf[511] = 0; // null char
-
-  // read line by line...
-  while (fgets(buf, 510, f))
-  {
-    string s(buf);
-
-    ParseLine(filename, s);
-  }
-
-  fclose(f);
-
   // Handle empty trajectory files
   // check the length of the trajectory vector
   // if there are no points in the trajectory file, then use the initial position as the only trajectory point
-  if (traj.size() == 0)
+  if (!_spline && _traj->size() == 0)
   {
     ParamsHandle config = SimpleConfig::GetInstance();
     TrajectoryPoint traj_pt;
@@ -61,41 +71,93 @@ bool Trajectory::ReadFile(const string& filename)
     V3F ypr = config->Get("Quad.InitialYPR", V3F());
     traj_pt.attitude = Quaternion<float>::FromEulerYPR(ypr[0], ypr[1], ypr[2]);
 
-    traj.push_back(traj_pt);
+    // depends on the config, so not shared
+    _traj.reset(new TrajectoryPoints());
+    _traj->push_back(traj_pt);
   }
 
   return true;
 }
 
-void Trajectory::ParseLine(const string& filename, const string& s)
+bool Trajectory::LoadFile(const string& filename)
 {
-  std::size_t firstNonWS = s.find_first_not_of("\n\t ");
+  _traj.reset(new TrajectoryPoints());
+  _spline.reset();
+  _splinePoints.reset();
+
+  std::lock_guard<std::mutex> lock(s_filesMutex);
 
-  // Ignore comments
-  if (firstNonWS == std::string::npos || s[firstNonWS] == '#' || firstNonWS == '/')
+  // stamped before reading, so that a change made while reading counts as a change
+  FileStamp stamp = FileStamp::Of(filename);
+  auto cached = s_files.find(filename);
+  if (cached != s_files.end() && cached->second.stamp == stamp)
   {
-    return;
+    _traj = cached->second.points;
+    _spline = cached->second.spline;
+    return true;
+  }
+
+  shared_ptr<TrajectoryPoints> points = TrajectoryPoints::Map(filename);
+  bool isSpline = false;
+  shared_ptr<const TrajectorySpline> spline;
+  if (!points)
+  {
+    spline = TrajectorySpline::Read(filename, isSpline);
+  }
+  if (isSpline && !spline)
+  {
+    s_files.erase(filename);
+    return false;
+  }
+
+  if (spline)
+  {
+    // no points of its own, see Points()
+    points.reset(new TrajectoryPoints());
   }
+  else if (!points)
+  {
+    FILE* f = fopen(filename.c_str(), "r");
+    if (!f)
+    {
+      s_files.erase(filename);
+      return false;
+    }
 
-  TrajectoryPoint traj_pt;
+    points.reset(new TrajectoryPoints());
 
-  V3F ypr; // Helper variable to read in yaw, pitch and roll
-  sscanf(s.c_str(), "%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f", &traj_pt.time, 
-		&traj_pt.position.x, &traj_pt.position.y, &traj_pt.position.z, 
-		&traj_pt.velocity.x, &traj_pt.velocity.y, &traj_pt.velocity.z, 
-		&ypr[0], &ypr[1], &ypr[2], &traj_pt.omega.x, &traj_pt.omega.y, &traj_pt.omega.z);
+    char buf[512];
+    buf[511] = 0; // null char
 
-  // Convert yaw, pitch, and roll to an attitude quaternion
-  traj_pt.attitude = Quaternion<float>::FromEulerYPR(ypr[0], ypr[1], ypr[2]);
+    // read line by line...
+    TrajectoryPoint traj_pt;
+    while (fgets(buf, 510, f))
+    {
+      // Add the trajectory point to the vector of all trajectory points
+      if (ParseTrajectoryLine(buf, traj_pt))
+      {
+        points->push_back(traj_pt);
+      }
+    }
+
+    fclose(f);
+  }
 
-  // Add the trajectory point to the vector of all trajectory points
-  traj.push_back(traj_pt);
+  TrajectoryFile& entry = s_files[filename];
+  entry.stamp = stamp;
+  entry.points = points;
+  entry.spline = spline;
+  _traj = points;
+  _spline = spline;
+  return true;
 }
 
 void Trajectory::Clear()
 {
   _curTrajPoint = 0;
-  traj.clear();
+  _traj.reset(new TrajectoryPoints());
+  _spline.reset();
+  _splinePoints.reset();
 
   // close and reopen the log file
   if (_log_file)
@@ -128,7 +190,17 @@ void Trajectory::SetLogFile(const string& filename)
 
 void Trajectory::AddTrajectoryPoint(TrajectoryPoint traj_pt)
 {
-  traj.push_back(traj_pt);
+  if (_spline)
+  {
+    _curTrajPoint = 0;
+    _spline.reset();
+    _splinePoints.reset();
+  }
+  if (_traj.use_count() > 1)
+  {
+    _traj.reset(new TrajectoryPoints(*_traj));
+  }
+  _traj->push_back(traj_pt);
 
   // If there is a log file, write the point to file
   if (_log_file)
@@ -137,45 +209,103 @@ void Trajectory::AddTrajectoryPoint(TrajectoryPoint traj_pt)
   }
 }
 
+const TrajectoryPoints& Trajectory::Points() const
+{
+  if (!_spline)
+  {
+    return *_traj;
+  }
+  if (!_splinePoints)
+  {
+    _splinePoints.reset(new TrajectoryPoints());
+    _spline->Sample(SPLINE_DRAW_POINTS, *_splinePoints);
+  }
+  return *_splinePoints;
+}
+
+int Trajectory::GetCurTrajectoryPoint() const
+{
+  // a spline's current segment starts at its waypoint
+  return _spline ? _curTrajPoint * SPLINE_DRAW_POINTS : _curTrajPoint;
+}
+
 TrajectoryPoint Trajectory::NextTrajectoryPoint(float time)
 {
+  if (_spline)
+  {
+    return _spline->Evaluate(time, _curTrajPoint);
+  }
+
+  const TrajectoryPoints& traj = *_traj;
   if (traj.empty()) return TrajectoryPoint();
 
-  // Loop through the trajectory vector and get the next trajectory point
-  for (int i = (int)traj.size()-1; i >= 0; i--)
+  // get the next trajectory point
+  int i = FindPointBefore(time);
+  if (i < 0)
   {
-    if(traj.at(i).time < time)
+    // if requested 0 or negative time
+    _curTrajPoint = 0;
+    return traj[0];
+  }
+
+  _curTrajPoint = i;
+  if (i == (int)traj.size() - 1)
+  {
+    // we're at the end of the trajectory
+    return traj[i];
+  }
+
+  // interpolation
+  float dt = traj[i + 1].time - traj[i].time;
+  float alpha = (time - traj[i].time) / dt;
+  float beta = 1.f - alpha;
+  TrajectoryPoint ret;
+  ret.position = traj[i].position*beta + traj[i + 1].position*alpha;
+  ret.velocity = traj[i].velocity*beta + traj[i + 1].velocity*alpha;
+  ret.accel = traj[i].accel*beta + traj[i + 1].accel*alpha;
+  ret.omega = traj[i].omega*beta + traj[i + 1].omega*alpha;
+  Quaternion<float> att = traj[i].attitude;
+  ret.attitude = att.Interpolate_SLERP(traj[i + 1].attitude, alpha);
+  ret.time = time;
+  return ret;
+}
+
+// the last point before time, -1 if none
+int Trajectory::FindPointBefore(float time)
+{
+  const TrajectoryPoints& traj = *_traj;
+  const int n = (int)traj.size();
+
+  if (!traj.TimesSorted())
+  {
+    for (int i = n - 1; i >= 0; i--)
     {
-      _curTrajPoint = i;
-			// interpolation
-			if (i == (int)traj.size() - 1)
-			{
-				// we're at the end of the trajectory
-				return traj.at(i);
-			}
-			else 
-			{
-				float dt = traj.at(i + 1).time - traj.at(i).time;
-				float alpha = (time - traj.at(i).time) / dt;
-				float beta = 1.f - alpha;
-				TrajectoryPoint ret;
-				ret.position = traj.at(i).position*beta + traj.at(i + 1).position*alpha;
-				ret.velocity = traj.at(i).velocity*beta + traj.at(i + 1).velocity*alpha;
-				ret.accel = traj.at(i).accel*beta + traj.at(i + 1).accel*alpha;
-				ret.omega = traj.at(i).omega*beta + traj.at(i + 1).omega*alpha;
-				ret.attitude = traj.at(i).attitude.Interpolate_SLERP(traj.at(i + 1).attitude, alpha);
-				ret.time = time;
-				return ret;
-			}
-
-			// no interpolation
-      return traj.at(i);
+      if (traj[i].time < time) return i;
     }
+    return -1;
   }
 
-	// if requested 0 or negative time
-  _curTrajPoint = 0;
-  return traj[0];
+  auto timeBefore = [](const TrajectoryPoint& pt, float t) { return pt.time < t; };
+
+  // time mostly moves forward by less than a point per call, so start from where the
+  // last call ended up
+  int i = CONSTRAIN(_curTrajPoint, 0, n - 1);
+  if (!(traj[i].time < time))
+  {
+    // went back: search what's before
+    return (int)(std::lower_bound(traj.begin(), traj.begin() + i, time, timeBefore) - traj.begin()) - 1;
+  }
+
+  for (int steps = 0; i + 1 < n && traj[i + 1].time < time; steps++)
+  {
+    if (steps == 4)
+    {
+      // jumped ahead: search what's after
+      return (int)(std::lower_bound(traj.begin() + i + 1, traj.end(), time, timeBefore) - traj.begin()) - 1;
+    }
+    i++;
+  }
+  return i;
 }
 
 void Trajectory::WriteTrajectoryPointToFile(FILE* f, TrajectoryPoint traj_pt)
@@ -3,7 +3,10 @@
 #include "Math/Quaternion.h"
 #include "Utility/FixedQueue.h"
 #include "VehicleDatatypes.h"
+#include "TrajectoryFile.h"
+#include "TrajectorySpline.h"
 #include <vector>
+#include <memory>
 
 using namespace SLR;
 
@@ -14,18 +17,30 @@ public:
   Trajectory();
   Trajectory(const string& filename);
   ~Trajectory();
+  // reads a text or binary trajectory file (see TrajectoryFile.h), or a spline file
+  // (see TrajectorySpline.h). what's read is shared with every other Trajectory that
+  // read the same file, and is only read again once the file changes on disk
   bool ReadFile(const string& filename);
-  void ParseLine(const string& filename, const string& s);
   void Clear();
   void SetLogFile(const string& filename);
+  // replaces a spline, if one was read
   void AddTrajectoryPoint(TrajectoryPoint traj_pt);
   TrajectoryPoint NextTrajectoryPoint(float time);
   void WriteTrajectoryPointToFile(FILE* f, TrajectoryPoint traj_pt);
 
-  vector<TrajectoryPoint> traj; // vector containing the trajectory points
+  // a spline's are points along it, evaluated on the first call
+  const TrajectoryPoints& Points() const;
 
-  int GetCurTrajectoryPoint() const { return _curTrajPoint; }
+  int GetCurTrajectoryPoint() const;
 private:
+  bool LoadFile(const string& filename);
+  int FindPointBefore(float time);
+
+  // the trajectory points. copied before being added to if shared
+  shared_ptr<TrajectoryPoints> _traj;
+  // or the spline, with _curTrajPoint its current segment
+  shared_ptr<const TrajectorySpline> _spline;
+  mutable shared_ptr<TrajectoryPoints> _splinePoints;
   string _log_filename;
   FILE* _log_file;
   int _curTrajPoint;
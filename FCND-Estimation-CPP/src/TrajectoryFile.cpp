@@ -0,0 +1,209 @@
+#include "Common.h"
+#include "TrajectoryFile.h"
+#include <type_traits>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+
+static const char TRAJ_MAGIC[8] = { 'S', 'L', 'R', 'T', 'R', 'A', 'J', '1' };
+static const uint32_t TRAJ_TIMES_SORTED = 1;
+
+struct TrajectoryFileHeader
+{
+  char magic[8];
+  uint32_t recordSize;
+  uint32_t flags;
+  uint64_t numPoints;
+};
+
+// records are TrajectoryPoints as they are in memory, so mapped ones can be used in place
+static_assert(std::is_standard_layout<TrajectoryPoint>::value, "TrajectoryPoint must be standard layout to be mapped");
+static_assert(sizeof(TrajectoryPoint) == 17 * sizeof(float)
+  && offsetof(TrajectoryPoint, position) == 1 * sizeof(float)
+  && offsetof(TrajectoryPoint, velocity) == 4 * sizeof(float)
+  && offsetof(TrajectoryPoint, omega) == 7 * sizeof(float)
+  && offsetof(TrajectoryPoint, accel) == 10 * sizeof(float)
+  && offsetof(TrajectoryPoint, attitude) == 13 * sizeof(float),
+  "TrajectoryPoint no longer matches the binary trajectory record");
+static_assert(sizeof(TrajectoryFileHeader) == 24, "binary trajectory header must be packed");
+
+bool ParseTrajectoryLine(const string& s, TrajectoryPoint& traj_pt)
+{
+  std::size_t firstNonWS = s.find_first_not_of("\n\t ");
+
+  // Ignore comments
+  if (firstNonWS == std::string::npos || s[firstNonWS] == '#' || firstNonWS == '/')
+  {
+    return false;
+  }
+
+  traj_pt = TrajectoryPoint();
+
+  V3F ypr; // Helper variable to read in yaw, pitch and roll
+  sscanf(s.c_str(), "%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f", &traj_pt.time, 
+		&traj_pt.position.x, &traj_pt.position.y, &traj_pt.position.z, 
+		&traj_pt.velocity.x, &traj_pt.velocity.y, &traj_pt.velocity.z, 
+		&ypr[0], &ypr[1], &ypr[2], &traj_pt.omega.x, &traj_pt.omega.y, &traj_pt.omega.z);
+
+  // Convert yaw, pitch, and roll to an attitude quaternion
+  traj_pt.attitude = Quaternion<float>::FromEulerYPR(ypr[0], ypr[1], ypr[2]);
+  return true;
+}
+
+bool ConvertTrajectoryToBinary(const string& textFile, const string& binaryFile)
+{
+  FILE* f = fopen(textFile.c_str(), "r");
+  if (!f)
+  {
+    SLR_WARNING1("Could not open %s", textFile.c_str());
+    return false;
+  }
+
+  TrajectoryFileWriter out(binaryFile);
+  if (!out.IsOpen())
+  {
+    fclose(f);
+    return false;
+  }
+
+  char buf[512];
+  buf[511] = 0; // null char
+  TrajectoryPoint pt;
+  while (fgets(buf, 510, f))
+  {
+    if (ParseTrajectoryLine(buf, pt))
+    {
+      out.Add(pt);
+    }
+  }
+  fclose(f);
+
+  return out.Close();
+}
+
+TrajectoryPoints::TrajectoryPoints()
+{
+  _data = NULL;
+  _size = 0;
+  _timesSorted = true;
+}
+
+TrajectoryPoints::TrajectoryPoints(const TrajectoryPoints& b)
+  : _points(b.begin(), b.end())
+{
+  _data = _points.empty() ? NULL : &_points[0];
+  _size = _points.size();
+  _timesSorted = b._timesSorted;
+}
+
+shared_ptr<TrajectoryPoints> TrajectoryPoints::Map(const string& filename)
+{
+  shared_ptr<MappedFile> file(new MappedFile(filename));
+  TrajectoryFileHeader header;
+  if (!file->IsOpen() || file->Size() < sizeof(header))
+  {
+    return shared_ptr<TrajectoryPoints>();
+  }
+
+  memcpy(&header, file->Data(), sizeof(header));
+  if (memcmp(header.magic, TRAJ_MAGIC, sizeof(TRAJ_MAGIC)) != 0)
+  {
+    return shared_ptr<TrajectoryPoints>();
+  }
+  if (header.recordSize != sizeof(TrajectoryPoint)
+    || header.numPoints > (file->Size() - sizeof(header)) / sizeof(TrajectoryPoint))
+  {
+    SLR_WARNING1("%s is not a valid binary trajectory", filename.c_str());
+    return shared_ptr<TrajectoryPoints>();
+  }
+
+  shared_ptr<TrajectoryPoints> ret(new TrajectoryPoints());
+  ret->_file = file;
+  ret->_data = (const TrajectoryPoint*)(file->Data() + sizeof(header));
+  ret->_size = (size_t)header.numPoints;
+  ret->_timesSorted = (header.flags & TRAJ_TIMES_SORTED) != 0;
+  return ret;
+}
+
+void TrajectoryPoints::push_back(const TrajectoryPoint& pt)
+{
+  if (_file)
+  {
+    _points.assign(begin(), end());
+    _file.reset();
+  }
+
+  _timesSorted = _timesSorted && (_points.empty() || !(pt.time < _points.back().time));
+  _points.push_back(pt);
+  _data = &_points[0];
+  _size = _points.size();
+}
+
+TrajectoryFileWriter::TrajectoryFileWriter(const string& filename)
+  : _filename(filename)
+{
+  _numPoints = 0;
+  _timesSorted = true;
+  _failed = false;
+  _lastTime = 0;
+
+  _file = fopen((_filename + ".tmp").c_str(), "wb");
+  if (!_file)
+  {
+    SLR_WARNING1("Could not open %s.tmp", _filename.c_str());
+    return;
+  }
+
+  // the point count and flags are filled in by Close()
+  TrajectoryFileHeader header;
+  memset(&header, 0, sizeof(header));
+  _failed = fwrite(&header, sizeof(header), 1, _file) != 1;
+}
+
+TrajectoryFileWriter::~TrajectoryFileWriter()
+{
+  Close();
+}
+
+void TrajectoryFileWriter::Add(const TrajectoryPoint& pt)
+{
+  if (!_file) return;
+
+  _timesSorted = _timesSorted && (_numPoints == 0 || !(pt.time < _lastTime));
+  _lastTime = pt.time;
+  _numPoints++;
+  _failed = _failed || fwrite(&pt, sizeof(pt), 1, _file) != 1;
+}
+
+bool TrajectoryFileWriter::Close()
+{
+  if (!_file) return false;
+
+  TrajectoryFileHeader header;
+  memcpy(header.magic, TRAJ_MAGIC, sizeof(TRAJ_MAGIC));
+  header.recordSize = sizeof(TrajectoryPoint);
+  header.flags = _timesSorted ? TRAJ_TIMES_SORTED : 0;
+  header.numPoints = _numPoints;
+  _failed = _failed || fseek(_file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, _file) != 1;
+  _failed = (fclose(_file) != 0) || _failed;
+  _file = NULL;
+
+  string tmp = _filename + ".tmp";
+  if (_failed)
+  {
+    SLR_WARNING1("Could not write %s", tmp.c_str());
+    remove(tmp.c_str());
+    return false;
+  }
+
+#ifdef _WIN32
+  // rename doesn't replace files on windows
+  remove(_filename.c_str());
+#endif
+  if (rename(tmp.c_str(), _filename.c_str()) != 0)
+  {
+    SLR_WARNING2("Could not move %s to %s", tmp.c_str(), _filename.c_str());
+    return false;
+  }
+  return true;
+}
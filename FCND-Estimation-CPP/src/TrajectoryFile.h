@@ -0,0 +1,86 @@
+#pragma once
+
+#include "VehicleDatatypes.h"
+#include "Utility/MappedFile.h"
+#include <vector>
+#include <memory>
+
+using namespace SLR;
+
+// Trajectory files, read by Trajectory::ReadFile, come in two formats.
+//
+// Text: one point per line,
+//   time, x, y, z, vx, vy, vz, yaw, pitch, roll, omega x, omega y, omega z
+// with '#' comment lines. Columns left off are zero.
+//
+// Binary, for trajectories too long to parse on every load: a header, then one
+// fixed-size record per point, memory-mapped when read and shared by every vehicle
+// (and process) flying it.
+//   header := "SLRTRAJ1" uint32 recordSize uint32 flags uint64 numPoints
+//   record := float time, position.xyz, velocity.xyz, omega.xyz, accel.xyz, attitude.wxyz
+// flags bit 0 is set if the times never decrease. Numbers are in the byte order of the
+// machine that wrote the file (little-endian on every platform the simulator builds for).
+// Write with TrajectoryFileWriter, or convert text files with the TrajToBin tool.
+
+// parses a line of a text trajectory file. false for comments and blank lines
+bool ParseTrajectoryLine(const string& line, TrajectoryPoint& pt);
+
+// converts a text trajectory file to a binary one, streaming, so any length works
+bool ConvertTrajectoryToBinary(const string& textFile, const string& binaryFile);
+
+// A trajectory's points: either held in memory, or the records of a mapped binary file
+class TrajectoryPoints
+{
+public:
+  TrajectoryPoints();
+  // always copies into memory
+  TrajectoryPoints(const TrajectoryPoints& b);
+
+  // maps a binary trajectory file. NULL if it can't be read or isn't one
+  static shared_ptr<TrajectoryPoints> Map(const string& filename);
+
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  const TrajectoryPoint& operator[](size_t i) const { return _data[i]; }
+  const TrajectoryPoint& back() const { return _data[_size - 1]; }
+  const TrajectoryPoint* begin() const { return _data; }
+  const TrajectoryPoint* end() const { return _data + _size; }
+
+  // whether the times never decrease
+  bool TimesSorted() const { return _timesSorted; }
+
+  // copies mapped points into memory first
+  void push_back(const TrajectoryPoint& pt);
+
+private:
+  TrajectoryPoints& operator=(const TrajectoryPoints&);
+
+  std::vector<TrajectoryPoint> _points; // in memory
+  shared_ptr<MappedFile> _file; // or mapped
+  const TrajectoryPoint* _data;
+  size_t _size;
+  bool _timesSorted;
+};
+
+// Writes a binary trajectory file point by point, without holding on to them.
+// The points go to <filename>.tmp, which replaces filename once complete, so
+// a file something has mapped is never changed under it
+class TrajectoryFileWriter
+{
+public:
+  TrajectoryFileWriter(const string& filename);
+  // closes
+  ~TrajectoryFileWriter();
+
+  bool IsOpen() const { return _file != NULL; }
+  void Add(const TrajectoryPoint& pt);
+  // completes the file. false if it couldn't be written
+  bool Close();
+
+private:
+  string _filename;
+  FILE* _file;
+  uint64_t _numPoints;
+  bool _timesSorted, _failed;
+  float _lastTime;
+};
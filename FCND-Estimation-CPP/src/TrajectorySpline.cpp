@@ -0,0 +1,240 @@
+#include "Common.h"
+#include "TrajectorySpline.h"
+#include "Utility/StringUtils.h"
+#include "Math/Constants.h"
+#include "Math/Angles.h"
+#include <stdio.h>
+
+using namespace SLR;
+
+namespace
+{
+  // the attitude and body rates that fly accel, and yaw, with jerk and yawRate their
+  // rates of change. thrust is along -z body, so body z is along gravity - accel,
+  // and the rates are how body z and x turn
+  void FlatAttitude(V3F accel, V3F jerk, float yaw, float yawRate, Quaternion<float>& att, V3F& omega)
+  {
+    V3F f = V3F(0, 0, (float)CONST_GRAVITY) - accel;
+    float fMag = f.mag();
+    V3F b3 = f / MAX(fMag, 1e-6f);
+    V3F yC(-sinf(yaw), cosf(yaw), 0);
+    V3F u = yC.cross(b3);
+    float uMag = u.mag();
+    if (fMag < 1e-3f || uMag < 1e-3f)
+    {
+      // free fall or on its side: no attitude flies it
+      att = Quaternion<float>::FromEulerYPR(yaw, 0, 0);
+      omega = V3F(0, 0, yawRate);
+      return;
+    }
+
+    V3F b1 = u / uMag;
+    V3F b2 = b3.cross(b1);
+    att = Quaternion<float>::FromEulerYPR(yaw, asinf(CONSTRAIN(-b1.z, -1.f, 1.f)), atan2f(b2.z, b3.z));
+
+    V3F b3Dot = (-jerk - b3 * b3.dot(-jerk)) / fMag;
+    V3F xC(cosf(yaw), sinf(yaw), 0);
+    V3F uDot = (xC * -yawRate).cross(b3) + yC.cross(b3Dot);
+    V3F b1Dot = (uDot - b1 * b1.dot(uDot)) / uMag;
+    omega.x = -b2.dot(b3Dot);
+    omega.y = b1.dot(b3Dot);
+    omega.z = b2.dot(b1Dot);
+  }
+}
+
+shared_ptr<TrajectorySpline> TrajectorySpline::Read(const string& filename, bool& isSpline)
+{
+  isSpline = false;
+  FILE* f = fopen(filename.c_str(), "r");
+  if (!f)
+  {
+    return shared_ptr<TrajectorySpline>();
+  }
+
+  char buf[512];
+  buf[511] = 0; // null char
+
+  vector<TrajectoryPoint> waypoints;
+  int lineNum = 0;
+  while (fgets(buf, 510, f))
+  {
+    lineNum++;
+    string line = Trim(buf);
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+
+    if (!isSpline)
+    {
+      // not a spline file, don't read any further
+      if (ToUpper(line) != "SPLINE") break;
+      isSpline = true;
+      continue;
+    }
+
+    TrajectoryPoint pt;
+    float yaw = 0;
+    if (sscanf(line.c_str(), "%f,%f,%f,%f,%f", &pt.time, &pt.position.x, &pt.position.y, &pt.position.z, &yaw) < 4)
+    {
+      SLR_WARNING2("%s line %d is not a waypoint", filename.c_str(), lineNum);
+      continue;
+    }
+    pt.attitude = Quaternion<float>::FromEulerYPR(yaw, 0, 0);
+    waypoints.push_back(pt);
+  }
+  fclose(f);
+
+  shared_ptr<TrajectorySpline> ret;
+  if (isSpline)
+  {
+    ret.reset(new TrajectorySpline());
+    if (!ret->Build(waypoints))
+    {
+      SLR_WARNING1("%s needs at least two waypoints, in increasing time", filename.c_str());
+      ret.reset();
+    }
+  }
+  return ret;
+}
+
+bool TrajectorySpline::Build(const vector<TrajectoryPoint>& waypoints)
+{
+  _segments.clear();
+
+  const int n = (int)waypoints.size();
+  if (n < 2) return false;
+  for (int i = 0; i + 1 < n; i++)
+  {
+    if (!(waypoints[i + 1].time > waypoints[i].time)) return false;
+  }
+
+  vector<double> h(n - 1);
+  vector<double> y[NUM_AXES];
+  for (int i = 0; i < n; i++)
+  {
+    if (i + 1 < n) h[i] = waypoints[i + 1].time - waypoints[i].time;
+    y[AXIS_X].push_back(waypoints[i].position.x);
+    y[AXIS_Y].push_back(waypoints[i].position.y);
+    y[AXIS_Z].push_back(waypoints[i].position.z);
+    double yaw = waypoints[i].attitude.Yaw();
+    if (i > 0)
+    {
+      // the short way round from the previous waypoint
+      yaw = y[AXIS_YAW][i - 1] + AngleNormF((float)(yaw - y[AXIS_YAW][i - 1]));
+    }
+    y[AXIS_YAW].push_back(yaw);
+  }
+
+  // the second derivatives M at the waypoints: continuous acceleration makes each
+  // inner one h[i-1]*M[i-1] + 2*(h[i-1]+h[i])*M[i] + h[i]*M[i+1] = 6*(slope[i] - slope[i-1]),
+  // and starting and ending at rest gives the outer two. tridiagonal, and the same for
+  // every axis, so eliminated once (Thomas algorithm)
+  vector<double> diag(n), upper(n), M[NUM_AXES];
+  for (int a = 0; a < NUM_AXES; a++)
+  {
+    M[a].resize(n);
+    for (int i = 0; i < n; i++)
+    {
+      double slopeBefore = i > 0 ? (y[a][i] - y[a][i - 1]) / h[i - 1] : 0;
+      double slopeAfter = i + 1 < n ? (y[a][i + 1] - y[a][i]) / h[i] : 0;
+      M[a][i] = 6 * (slopeAfter - slopeBefore);
+    }
+  }
+  for (int i = 0; i < n; i++)
+  {
+    double lower = i > 0 ? h[i - 1] : 0;
+    diag[i] = 2 * ((i > 0 ? h[i - 1] : 0) + (i + 1 < n ? h[i] : 0));
+    upper[i] = i + 1 < n ? h[i] : 0;
+    if (i > 0)
+    {
+      double m = lower / diag[i - 1];
+      diag[i] -= m * upper[i - 1];
+      for (int a = 0; a < NUM_AXES; a++)
+      {
+        M[a][i] -= m * M[a][i - 1];
+      }
+    }
+  }
+  for (int a = 0; a < NUM_AXES; a++)
+  {
+    for (int i = n - 1; i >= 0; i--)
+    {
+      M[a][i] = (M[a][i] - (i + 1 < n ? upper[i] * M[a][i + 1] : 0)) / diag[i];
+    }
+  }
+
+  _segments.resize(n - 1);
+  for (int i = 0; i + 1 < n; i++)
+  {
+    Segment& s = _segments[i];
+    s.t0 = waypoints[i].time;
+    s.duration = (float)h[i];
+    for (int a = 0; a < NUM_AXES; a++)
+    {
+      s.c[a][0] = (float)y[a][i];
+      s.c[a][1] = (float)((y[a][i + 1] - y[a][i]) / h[i] - h[i] * (2 * M[a][i] + M[a][i + 1]) / 6);
+      s.c[a][2] = (float)(M[a][i] / 2);
+      s.c[a][3] = (float)((M[a][i + 1] - M[a][i]) / (6 * h[i]));
+    }
+  }
+  return true;
+}
+
+TrajectoryPoint TrajectorySpline::Evaluate(float time, int& segment) const
+{
+  segment = FindSegment(time, segment);
+  const Segment& s = _segments[segment];
+
+  // hovering outside the waypoints' times
+  bool moving = time > StartTime() && time < EndTime();
+  float t = CONSTRAIN(time - s.t0, 0.f, s.duration);
+
+  float pos[NUM_AXES], vel[NUM_AXES], acc[NUM_AXES], jerk[NUM_AXES];
+  for (int a = 0; a < NUM_AXES; a++)
+  {
+    const float* c = s.c[a];
+    pos[a] = c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+    vel[a] = moving ? c[1] + t * (2 * c[2] + t * 3 * c[3]) : 0;
+    acc[a] = moving ? 2 * c[2] + t * 6 * c[3] : 0;
+    jerk[a] = moving ? 6 * c[3] : 0;
+  }
+
+  TrajectoryPoint ret;
+  ret.time = time;
+  ret.position = V3F(pos[AXIS_X], pos[AXIS_Y], pos[AXIS_Z]);
+  ret.velocity = V3F(vel[AXIS_X], vel[AXIS_Y], vel[AXIS_Z]);
+  ret.accel = V3F(acc[AXIS_X], acc[AXIS_Y], acc[AXIS_Z]);
+  FlatAttitude(ret.accel, V3F(jerk[AXIS_X], jerk[AXIS_Y], jerk[AXIS_Z]), pos[AXIS_YAW], vel[AXIS_YAW], ret.attitude, ret.omega);
+  return ret;
+}
+
+// the segment time is in, the first/last one if before/after all of them
+int TrajectorySpline::FindSegment(float time, int segment) const
+{
+  // a handful of segments, and time mostly staying within one: walk from the last
+  const int n = (int)_segments.size();
+  segment = CONSTRAIN(segment, 0, n - 1);
+  while (segment > 0 && time < _segments[segment].t0)
+  {
+    segment--;
+  }
+  while (segment + 1 < n && !(time < _segments[segment + 1].t0))
+  {
+    segment++;
+  }
+  return segment;
+}
+
+void TrajectorySpline::Sample(int pointsPerSegment, TrajectoryPoints& out) const
+{
+  int segment = 0;
+  for (unsigned int i = 0; i < _segments.size(); i++)
+  {
+    for (int k = 0; k < pointsPerSegment; k++)
+    {
+      out.push_back(Evaluate(_segments[i].t0 + _segments[i].duration * k / pointsPerSegment, segment));
+    }
+  }
+  out.push_back(Evaluate(EndTime(), segment));
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "VehicleDatatypes.h"
+#include "TrajectoryFile.h"
+#include <vector>
+#include <memory>
+
+using namespace SLR;
+
+// A trajectory given by a handful of waypoints instead of a point per tick: a cubic
+// spline through them in each of x, y, z and yaw, twice continuously differentiable,
+// starting and ending at rest. The cubic is the curve through the waypoints with the
+// least squared acceleration, so it's also the gentlest on thrust.
+//
+// Every point along it is exact, velocity, acceleration and attitude included, and
+// so are the body rates: from the jerk and yaw rate, by differential flatness. The
+// controller feeds velocity and acceleration forward, and the body rates as far as
+// its ffPQR says (see QuadControl::RunControl).
+//
+// Spline files, read by Trajectory::ReadFile, are text files whose first line that
+// isn't a comment is SPLINE, followed by one waypoint per line,
+//   time, x, y, z, yaw
+// with '#' comment lines. Times have to increase, yaw may be left off (zero).
+class TrajectorySpline
+{
+public:
+  // reads a spline file. NULL if it can't be read, isn't one, or has too few
+  // waypoints. isSpline tells the last apart from the others
+  static shared_ptr<TrajectorySpline> Read(const string& filename, bool& isSpline);
+
+  // false if there are fewer than two waypoints or their times don't increase.
+  // waypoint yaws are taken the short way round
+  bool Build(const vector<TrajectoryPoint>& waypoints);
+
+  // the trajectory at time. before the start and after the end it hovers at the first
+  // and last waypoint. segment is where to start looking, and is left at the segment
+  // time is in, so a caller stepping through time in order finds it right away
+  TrajectoryPoint Evaluate(float time, int& segment) const;
+
+  int NumSegments() const { return (int)_segments.size(); }
+  float StartTime() const { return _segments.front().t0; }
+  float EndTime() const { return _segments.back().t0 + _segments.back().duration; }
+
+  // evaluates pointsPerSegment points along each segment, and the last waypoint,
+  // to draw it. the first point of segment i is at i * pointsPerSegment
+  void Sample(int pointsPerSegment, TrajectoryPoints& out) const;
+
+private:
+  enum { AXIS_X = 0, AXIS_Y, AXIS_Z, AXIS_YAW, NUM_AXES };
+
+  struct Segment
+  {
+    float t0, duration;
+    // per axis, value = c[0] + c[1]*t + c[2]*t^2 + c[3]*t^3 with t the time into the segment
+    float c[NUM_AXES][4];
+  };
+
+  int FindSegment(float time, int segment) const;
+
+  vector<Segment> _segments;
+};
@@ -0,0 +1,286 @@
+#include "Common.h"
+#include "BinaryLog.h"
+#include <limits>
+
+namespace SLR{
+
+static const char BINLOG_MAGIC[8] = { 'S', 'L', 'R', 'L', 'O', 'G', '1', '\n' };
+
+static size_t BinaryLogTypeSize(BinaryLogType t)
+{
+	return t == BINLOG_DOUBLE ? sizeof(double) : sizeof(float);
+}
+
+// column offsets within a chunk of numRows rows
+static void ComputeOffsets(const std::vector<BinaryLogColumn>& columns, size_t numRows,
+	std::vector<size_t>& offset, std::vector<size_t>& size, size_t& total)
+{
+	offset.resize(columns.size());
+	size.resize(columns.size());
+	total = 0;
+	for (unsigned int i = 0; i < columns.size(); i++)
+	{
+		size[i] = BinaryLogTypeSize(columns[i].type);
+		offset[i] = total;
+		total += size[i] * numRows;
+	}
+}
+
+BinaryLogWriter::BinaryLogWriter(const string& filename, const std::vector<BinaryLogColumn>& columns, int rowsPerChunk)
+	: _columns(columns)
+{
+	_rowsPerChunk = MAX(rowsPerChunk, 1);
+	_quit = false;
+
+	size_t chunkSize;
+	ComputeOffsets(_columns, _rowsPerChunk, _columnOffset, _columnSize, chunkSize);
+	_chunk = NewChunk();
+
+	_file = fopen(filename.c_str(), "wb");
+	if (!_file)
+	{
+		SLR_WARNING1("Could not open log %s", filename.c_str());
+		return;
+	}
+
+	fwrite(BINLOG_MAGIC, 1, sizeof(BINLOG_MAGIC), _file);
+	uint32_t numColumns = (uint32_t)_columns.size();
+	fwrite(&numColumns, sizeof(numColumns), 1, _file);
+	for (unsigned int i = 0; i < _columns.size(); i++)
+	{
+		uint8_t type = (uint8_t)_columns[i].type;
+		uint16_t nameLength = (uint16_t)MIN(_columns[i].name.size(), (size_t)0xFFFF);
+		fwrite(&type, sizeof(type), 1, _file);
+		fwrite(&nameLength, sizeof(nameLength), 1, _file);
+		fwrite(_columns[i].name.c_str(), 1, nameLength, _file);
+	}
+
+	_thread = std::thread(&BinaryLogWriter::WriterThread, this);
+}
+
+BinaryLogWriter::~BinaryLogWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_chunk->numRows > 0)
+		{
+			_full.push_back(_chunk);
+			_chunk = NULL;
+		}
+		_quit = true;
+	}
+	_chunkReady.notify_one();
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+
+	delete _chunk;
+	for (unsigned int i = 0; i < _full.size(); i++) delete _full[i];
+	for (unsigned int i = 0; i < _spare.size(); i++) delete _spare[i];
+
+	if (_file)
+	{
+		fclose(_file);
+	}
+}
+
+BinaryLogWriter::Chunk* BinaryLogWriter::NewChunk()
+{
+	Chunk* c = NULL;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (!_spare.empty())
+		{
+			c = _spare.back();
+			_spare.pop_back();
+		}
+	}
+	if (!c)
+	{
+		c = new Chunk();
+		c->data.resize(_columnOffset.empty() ? 0 : _columnOffset.back() + _columnSize.back() * _rowsPerChunk);
+	}
+
+	// every value starts out missing
+	const float nanF = std::numeric_limits<float>::quiet_NaN();
+	const double nanD = std::numeric_limits<double>::quiet_NaN();
+	for (unsigned int i = 0; i < _columns.size(); i++)
+	{
+		uint8_t* p = &c->data[_columnOffset[i]];
+		for (int r = 0; r < _rowsPerChunk; r++, p += _columnSize[i])
+		{
+			if (_columns[i].type == BINLOG_DOUBLE) memcpy(p, &nanD, sizeof(nanD));
+			else memcpy(p, &nanF, sizeof(nanF));
+		}
+	}
+	c->numRows = 0;
+	return c;
+}
+
+void BinaryLogWriter::EndRow()
+{
+	_chunk->numRows++;
+	if (_chunk->numRows < _rowsPerChunk)
+	{
+		return;
+	}
+
+	if (!_file)
+	{
+		// nowhere to write it, just keep the calls cheap
+		_chunk->numRows = 0;
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_full.push_back(_chunk);
+	}
+	_chunkReady.notify_one();
+	_chunk = NewChunk();
+}
+
+void BinaryLogWriter::WriterThread()
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	for (;;)
+	{
+		_chunkReady.wait(lock, [this] { return _quit || !_full.empty(); });
+		if (_full.empty())
+		{
+			// quit, and everything has been written
+			break;
+		}
+
+		Chunk* c = _full.front();
+		_full.pop_front();
+		lock.unlock();
+
+		uint32_t numRows = (uint32_t)c->numRows;
+		fwrite(&numRows, sizeof(numRows), 1, _file);
+		for (unsigned int i = 0; i < _columns.size(); i++)
+		{
+			fwrite(&c->data[_columnOffset[i]], _columnSize[i], numRows, _file);
+		}
+
+		lock.lock();
+		_spare.push_back(c);
+	}
+	fflush(_file);
+}
+
+BinaryLogReader::BinaryLogReader(const string& filename)
+{
+	_numRows = 0;
+	_file = fopen(filename.c_str(), "rb");
+	if (!_file)
+	{
+		return;
+	}
+
+	char magic[sizeof(BINLOG_MAGIC)];
+	uint32_t numColumns = 0;
+	bool ok = fread(magic, 1, sizeof(magic), _file) == sizeof(magic)
+		&& memcmp(magic, BINLOG_MAGIC, sizeof(magic)) == 0
+		&& fread(&numColumns, sizeof(numColumns), 1, _file) == 1;
+
+	for (uint32_t i = 0; ok && i < numColumns; i++)
+	{
+		uint8_t type;
+		uint16_t nameLength;
+		ok = fread(&type, sizeof(type), 1, _file) == 1 && type <= BINLOG_DOUBLE
+			&& fread(&nameLength, sizeof(nameLength), 1, _file) == 1;
+		if (!ok) break;
+
+		string name(nameLength, ' ');
+		ok = nameLength == 0 || fread(&name[0], 1, nameLength, _file) == nameLength;
+		_columns.push_back(BinaryLogColumn(name, (BinaryLogType)type));
+	}
+
+	if (!ok)
+	{
+		SLR_WARNING1("%s is not a binary log", filename.c_str());
+		fclose(_file);
+		_file = NULL;
+		_columns.clear();
+	}
+}
+
+BinaryLogReader::~BinaryLogReader()
+{
+	if (_file)
+	{
+		fclose(_file);
+	}
+}
+
+int BinaryLogReader::FindColumn(const string& name) const
+{
+	for (unsigned int i = 0; i < _columns.size(); i++)
+	{
+		if (_columns[i].name == name) return (int)i;
+	}
+	return -1;
+}
+
+bool BinaryLogReader::ReadChunk()
+{
+	_numRows = 0;
+	uint32_t numRows;
+	if (!_file || fread(&numRows, sizeof(numRows), 1, _file) != 1)
+	{
+		return false;
+	}
+
+	size_t size;
+	ComputeOffsets(_columns, numRows, _columnOffset, _columnSize, size);
+	_data.resize(size);
+	if (size > 0 && fread(&_data[0], 1, size, _file) != size)
+	{
+		// truncated, e.g. the simulator was killed while writing
+		return false;
+	}
+	_numRows = (int)numRows;
+	return true;
+}
+
+bool ConvertBinaryLogToCSV(const string& logFile, const string& csvFile)
+{
+	BinaryLogReader log(logFile);
+	if (!log.IsOpen())
+	{
+		SLR_WARNING1("Could not read log %s", logFile.c_str());
+		return false;
+	}
+
+	FILE* f = fopen(csvFile.c_str(), "w");
+	if (!f)
+	{
+		SLR_WARNING1("Could not open %s", csvFile.c_str());
+		return false;
+	}
+
+	for (int i = 0; i < log.NumColumns(); i++)
+	{
+		fprintf(f, i == 0 ? "%s" : ", %s", log.Column(i).name.c_str());
+	}
+	fprintf(f, "\n");
+
+	while (log.ReadChunk())
+	{
+		for (int r = 0; r < log.NumRows(); r++)
+		{
+			for (int i = 0; i < log.NumColumns(); i++)
+			{
+				fprintf(f, i == 0 ? "%f" : ",%f", log.Value(i, r));
+			}
+			fprintf(f, "\n");
+		}
+	}
+
+	fclose(f);
+	return true;
+}
+
+} // namespace SLR
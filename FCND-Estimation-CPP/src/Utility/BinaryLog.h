@@ -0,0 +1,134 @@
+#pragma once
+
+#include "../Common.h"
+#include <vector>
+#include <deque>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace SLR{
+
+// Columnar binary log, used for the graph and data logs in place of text files.
+//
+//   file   := header chunk*
+//   header := "SLRLOG1\n" uint32 numColumns column[numColumns]
+//   column := uint8 type (0 = float, 1 = double) uint16 nameLength char name[nameLength]
+//   chunk  := uint32 numRows, then for each column in order numRows values of its type
+//
+// Numbers are stored in the byte order of the machine that wrote the log (little-endian
+// on every platform the simulator builds for). A missing value is stored as NaN.
+// Use BinaryLogReader or LogToCSV to read it back.
+enum BinaryLogType { BINLOG_FLOAT = 0, BINLOG_DOUBLE = 1 };
+
+struct BinaryLogColumn
+{
+	BinaryLogColumn(const string& n = "", BinaryLogType t = BINLOG_FLOAT) : name(n), type(t) {}
+	string name;
+	BinaryLogType type;
+};
+
+// Fills rows into a chunk in memory and hands full chunks to a writer thread,
+// so adding a row is a few stores and never waits on the disk
+class BinaryLogWriter{
+public:
+	BinaryLogWriter(const string& filename, const std::vector<BinaryLogColumn>& columns, int rowsPerChunk = 4096);
+	// writes out everything logged so far
+	~BinaryLogWriter();
+
+	bool IsOpen() const { return _file != NULL; }
+	int NumColumns() const { return (int)_columns.size(); }
+
+	// sets a value of the current row. columns that aren't set are logged as NaN
+	void Set(int column, double value)
+	{
+		uint8_t* p = &_chunk->data[_columnOffset[column] + _chunk->numRows * _columnSize[column]];
+		if (_columns[column].type == BINLOG_DOUBLE)
+		{
+			memcpy(p, &value, sizeof(double));
+		}
+		else
+		{
+			float f = (float)value;
+			memcpy(p, &f, sizeof(float));
+		}
+	}
+
+	// completes the current row and starts the next one
+	void EndRow();
+
+protected:
+	// copy constructor and assignment are disallowed
+	BinaryLogWriter(const BinaryLogWriter&);
+	BinaryLogWriter& operator=(const BinaryLogWriter&);
+
+	struct Chunk{
+		std::vector<uint8_t> data;
+		int numRows;
+	};
+
+	Chunk* NewChunk();
+	void WriterThread();
+
+	FILE* _file;
+	std::vector<BinaryLogColumn> _columns;
+	std::vector<size_t> _columnOffset, _columnSize;
+	int _rowsPerChunk;
+
+	Chunk* _chunk; // being filled
+
+	std::thread _thread;
+	std::mutex _mutex;
+	std::condition_variable _chunkReady;
+	std::deque<Chunk*> _full;   // waiting to be written
+	std::vector<Chunk*> _spare; // written, for reuse
+	bool _quit;
+};
+
+// Reads a BinaryLogWriter file one chunk at a time
+class BinaryLogReader{
+public:
+	BinaryLogReader(const string& filename);
+	~BinaryLogReader();
+
+	// false if the file couldn't be opened or isn't a binary log
+	bool IsOpen() const { return _file != NULL; }
+
+	int NumColumns() const { return (int)_columns.size(); }
+	const BinaryLogColumn& Column(int i) const { return _columns[i]; }
+	// index of the first column called name, -1 if there is none
+	int FindColumn(const string& name) const;
+
+	// loads the next chunk. false at the end of the log
+	bool ReadChunk();
+
+	// rows in the chunk loaded last
+	int NumRows() const { return _numRows; }
+	double Value(int column, int row) const
+	{
+		const uint8_t* p = &_data[_columnOffset[column] + row * _columnSize[column]];
+		if (_columns[column].type == BINLOG_DOUBLE)
+		{
+			double d;
+			memcpy(&d, p, sizeof(double));
+			return d;
+		}
+		float f;
+		memcpy(&f, p, sizeof(float));
+		return f;
+	}
+
+protected:
+	FILE* _file;
+	std::vector<BinaryLogColumn> _columns;
+	std::vector<size_t> _columnOffset, _columnSize;
+	std::vector<uint8_t> _data;
+	int _numRows;
+};
+
+// writes a binary log out as CSV text: a header line of column names, then
+// one line per row. returns false if either file couldn't be opened
+bool ConvertBinaryLogToCSV(const string& logFile, const string& csvFile);
+
+} // namespace SLR
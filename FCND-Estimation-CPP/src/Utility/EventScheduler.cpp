@@ -0,0 +1,96 @@
+#include "Common.h"
+#include "EventScheduler.h"
+#include <limits>
+
+namespace SLR{
+
+int EventScheduler::Add(double period, double phase, const Task& task)
+{
+	Entry e;
+	e.period = (int64_t)floor(period * _ticksPerSecond + 0.5);
+	e.phase = (int64_t)floor(phase * _ticksPerSecond + 0.5);
+	e.count = 0;
+	e.task = task;
+	_tasks.push_back(e);
+
+	Schedule((int)_tasks.size() - 1);
+	return (int)_tasks.size() - 1;
+}
+
+void EventScheduler::Clear()
+{
+	_tasks.clear();
+	_queue = std::priority_queue<Due>();
+}
+
+void EventScheduler::Restart()
+{
+	_queue = std::priority_queue<Due>();
+	for (unsigned int i = 0; i < _tasks.size(); i++)
+	{
+		_tasks[i].count = 0;
+		Schedule((int)i);
+	}
+}
+
+void EventScheduler::GetCounts(std::vector<int64_t>& counts) const
+{
+	counts.resize(_tasks.size());
+	for (unsigned int i = 0; i < _tasks.size(); i++)
+	{
+		counts[i] = _tasks[i].count;
+	}
+}
+
+void EventScheduler::Restart(const std::vector<int64_t>& counts)
+{
+	_queue = std::priority_queue<Due>();
+	for (unsigned int i = 0; i < _tasks.size(); i++)
+	{
+		_tasks[i].count = i < counts.size() ? counts[i] : 0;
+		Schedule((int)i);
+	}
+}
+
+// queues the task's next run
+void EventScheduler::Schedule(int task)
+{
+	if (_tasks[task].period <= 0) return;
+
+	Due d;
+	d.tick = _tasks[task].DueTick();
+	d.task = task;
+	_queue.push(d);
+}
+
+double EventScheduler::NextTime() const
+{
+	return _queue.empty() ? std::numeric_limits<double>::infinity() : Time(_queue.top().tick);
+}
+
+void EventScheduler::RunDue(double time, int numTasks)
+{
+	while (!_queue.empty() && Time(_queue.top().tick) <= time)
+	{
+		Due d = _queue.top();
+		_queue.pop();
+		if (numTasks >= 0 && d.task >= numTasks)
+		{
+			_held.push_back(d);
+			continue;
+		}
+
+		Entry& e = _tasks[d.task];
+		e.count++;
+		Schedule(d.task);
+		e.task(Time(d.tick));
+	}
+
+	for (unsigned int i = 0; i < _held.size(); i++)
+	{
+		_queue.push(_held[i]);
+	}
+	_held.clear();
+}
+
+} // namespace SLR
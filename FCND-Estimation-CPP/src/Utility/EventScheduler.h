@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../Common.h"
+#include <vector>
+#include <queue>
+#include <functional>
+
+namespace SLR{
+
+// Periodic tasks run in time order, each with its own period and phase: a task
+// runs at phase, phase + period, phase + 2 * period, ... RunDue() runs only the
+// tasks that are due, so nothing polls.
+// Times are counted in whole ticks (microseconds by default), so they don't drift
+// however long it runs, and tasks meant to run together do: in seconds, 3 * 0.1
+// isn't 150 * 0.002. Tasks due at the same tick run in the order they were added
+class EventScheduler{
+public:
+	// called with the time the task was due. tasks mustn't add or clear tasks
+	typedef std::function<void(double time)> Task;
+
+	EventScheduler(double ticksPerSecond = 1e6) : _ticksPerSecond(ticksPerSecond) {}
+
+	// returns the task's index, the order it runs in among tasks due at the same time.
+	// period and phase are rounded to ticks. a task with a period under a tick never runs
+	int Add(double period, double phase, const Task& task);
+	void Clear();
+
+	int NumTasks() const { return (int)_tasks.size(); }
+
+	// starts every task over, due next at its phase
+	void Restart();
+
+	// how many times each task has run since Restart(), and Restart() from such counts
+	// instead, to resume a saved schedule of the same tasks
+	void GetCounts(std::vector<int64_t>& counts) const;
+	void Restart(const std::vector<int64_t>& counts);
+
+	// when the next task is due, infinity if there are none
+	double NextTime() const;
+
+	// runs the tasks due by time, in order. with numTasks >= 0 only the first numTasks
+	// tasks run, the others are left due for a later call
+	void RunDue(double time, int numTasks = -1);
+
+protected:
+	// copy constructor and assignment are disallowed, the tasks usually point back at the owner
+	EventScheduler(const EventScheduler&);
+	EventScheduler& operator=(const EventScheduler&);
+
+	struct Entry
+	{
+		int64_t period, phase; // [ticks]
+		int64_t count; // times run since Restart()
+		Task task;
+		int64_t DueTick() const { return phase + period * count; }
+	};
+
+	struct Due
+	{
+		int64_t tick;
+		int task;
+		// std::priority_queue keeps the largest on top: the earliest, lowest index task
+		bool operator<(const Due& b) const { return tick > b.tick || (tick == b.tick && task > b.task); }
+	};
+
+	double Time(int64_t tick) const { return tick / _ticksPerSecond; }
+	void Schedule(int task);
+
+	double _ticksPerSecond;
+	std::vector<Entry> _tasks;
+	std::priority_queue<Due> _queue;
+	std::vector<Due> _held; // scratch for RunDue
+};
+
+} // namespace SLR
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <cstdint>
+#include <string>
+
+namespace SLR
+{
+
+// A file's modification and status change times, inode and size, to tell whether what
+// was read from it earlier is still what's on disk. The times are in ns where the
+// platform has them, so a rewrite within the same second still shows, and the inode and
+// change time catch a file replaced by another with the same mtime and size, as editors
+// that save by renaming do. Two stamps of a missing file compare equal, so a file that
+// still doesn't exist is unchanged too
+struct FileStamp
+{
+  bool exists;
+  int64_t mtime; // ns
+  int64_t ctime; // ns
+  uint64_t inode;
+  int64_t size;
+
+  FileStamp() : exists(false), mtime(0), ctime(0), inode(0), size(0) {}
+
+  static FileStamp Of(const std::string& filename)
+  {
+    FileStamp ret;
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_stat64(filename.c_str(), &st) == 0)
+#else
+    struct stat st;
+    if (stat(filename.c_str(), &st) == 0)
+#endif
+    {
+      ret.exists = true;
+#if defined(__APPLE__)
+      ret.mtime = Ns(st.st_mtimespec.tv_sec, st.st_mtimespec.tv_nsec);
+      ret.ctime = Ns(st.st_ctimespec.tv_sec, st.st_ctimespec.tv_nsec);
+#elif defined(__linux__)
+      ret.mtime = Ns(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+      ret.ctime = Ns(st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+#else
+      ret.mtime = Ns(st.st_mtime, 0);
+      ret.ctime = Ns(st.st_ctime, 0);
+#endif
+      ret.inode = (uint64_t)st.st_ino;
+      ret.size = (int64_t)st.st_size;
+    }
+    return ret;
+  }
+
+  bool operator==(const FileStamp& b) const
+  {
+    return exists == b.exists && mtime == b.mtime && ctime == b.ctime && inode == b.inode && size == b.size;
+  }
+  bool operator!=(const FileStamp& b) const { return !(*this == b); }
+
+private:
+  static int64_t Ns(int64_t sec, int64_t nsec) { return sec * 1000000000 + nsec; }
+};
+
+} // namespace SLR
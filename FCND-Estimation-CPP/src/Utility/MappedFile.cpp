@@ -0,0 +1,88 @@
+#include "Common.h"
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace SLR{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string& filename)
+{
+	_data = NULL;
+	_size = 0;
+	_mapping = NULL;
+	_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		_file = NULL;
+		return;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+	{
+		return;
+	}
+
+	_mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (_mapping)
+	{
+		_data = (const uint8_t*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+		_size = _data ? (size_t)size.QuadPart : 0;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (_data) UnmapViewOfFile(_data);
+	if (_mapping) CloseHandle(_mapping);
+	if (_file) CloseHandle(_file);
+}
+
+#else
+
+MappedFile::MappedFile(const string& filename)
+{
+	_data = NULL;
+	_size = 0;
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+
+	// an empty file can't be mapped, and has nothing in it anyway
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		if (p != MAP_FAILED)
+		{
+			_data = (const uint8_t*)p;
+			_size = (size_t)st.st_size;
+		}
+	}
+
+	// the mapping keeps the file open
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (_data)
+	{
+		munmap((void*)_data, _size);
+	}
+}
+
+#endif
+
+} // namespace SLR
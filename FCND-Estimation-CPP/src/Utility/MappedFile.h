@@ -0,0 +1,32 @@
+#pragma once
+
+#include "../Common.h"
+
+namespace SLR{
+
+// A whole file mapped read-only into memory. Pages are read from disk as they're
+// first touched, and are shared by everything (in any process) that maps the same file.
+// A file that is mapped shouldn't be written to in place: write a new one and rename
+// it over the old one instead
+class MappedFile{
+public:
+	MappedFile(const string& filename);
+	~MappedFile();
+
+	bool IsOpen() const { return _data != NULL; }
+	const uint8_t* Data() const { return _data; }
+	size_t Size() const { return _size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const uint8_t* _data;
+	size_t _size;
+#ifdef _WIN32
+	void* _file;
+	void* _mapping;
+#endif
+};
+
+} // namespace SLR
@@ -1,9 +1,12 @@
 #include "Common.h"
 #include "SimpleConfig.h"
 #include "Utility/StringUtils.h"
+#include "Utility/FileStamp.h"
 
 #include <vector>
 #include <string>
+#include <set>
+#include <cerrno>
 using namespace std;
 
 #define MAX_INCLUDE_DEPTH 5
@@ -13,8 +16,51 @@ namespace SLR
 	
 shared_ptr<SimpleConfig> SimpleConfig::s_config;
 
+namespace
+{
+  inline char UpperChar(char c)
+  {
+    return (c >= 'a' && c <= 'z') ? (char)(c - ('a' - 'A')) : c;
+  }
+
+  // what std::stof accepts, without the exceptions
+  bool ParseFloat(const string& s, float& ret)
+  {
+    const char* str = s.c_str();
+    char* end;
+    errno = 0;
+    float tmp = strtof(str, &end);
+    if (end == str || errno == ERANGE) return false;
+    ret = tmp;
+    return true;
+  }
+}
+
+size_t SimpleConfig::NoCaseHash::operator()(const string& s) const
+{
+  // FNV-1a
+  size_t h = 2166136261u;
+  for (size_t i = 0; i < s.size(); i++)
+  {
+    h = (h ^ (unsigned char)UpperChar(s[i])) * 16777619u;
+  }
+  return h;
+}
+
+bool SimpleConfig::NoCaseEqual::operator()(const string& a, const string& b) const
+{
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++)
+  {
+    if (UpperChar(a[i]) != UpperChar(b[i])) return false;
+  }
+  return true;
+}
+
 SimpleConfig::SimpleConfig()
 {
+  _generation = 0;
+  _resolvedGeneration = 0;
 	Reset("");
 }
 
@@ -31,13 +77,43 @@ void SimpleConfig::Reset(string rootParam)
 {
   // todo: go to the right directory
   // load all the files in the directory?
+
+  // nothing to do if it's what is already loaded, e.g. for repeated runs of a scenario
+  if (rootParam != "" && rootParam == _rootFile && FilesUnchanged())
+  {
+    return;
+  }
+
   _params.clear();
+  _paramIndex.clear();
+  _namespaceBases.clear();
+  _clock = 0;
+  _generation++;
+  _rootFile = rootParam;
+  _filesRead.clear();
   if (rootParam != "")
   {
     ReadFile(rootParam);
   }
 }
 
+void SimpleConfig::Set(const string& param, const string& value)
+{
+  SetParam(ToUpper(Trim(param)), Trim(value));
+}
+
+bool SimpleConfig::FilesUnchanged() const
+{
+  for (unsigned int i = 0; i < _filesRead.size(); i++)
+  {
+    if (FileStamp::Of(_filesRead[i].first) != _filesRead[i].second)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
 void SimpleConfig::ReadFile(const string& filename, int depth)
 {
   if (depth > MAX_INCLUDE_DEPTH)
@@ -46,6 +122,9 @@ void SimpleConfig::ReadFile(const string& filename, int depth)
     return;
   }
 
+  // stamped before reading, so that a change made while reading counts as a change
+  _filesRead.push_back(std::make_pair(filename, FileStamp::Of(filename)));
+
   FILE* f = fopen(filename.c_str(), "r");
   if (!f)
   {
@@ -109,7 +188,7 @@ void SimpleConfig::ParseLine(const string& filename, const string& line, int lin
     {
       string baseNamespace = Trim(RightOf(curNamespace, ':'));
       curNamespace = Trim(LeftOf(curNamespace, ':'));
-      CopyNamespaceParams(baseNamespace, curNamespace);
+      InheritNamespace(baseNamespace, curNamespace);
     }
     return;
   }
@@ -153,7 +232,7 @@ void SimpleConfig::ParseLine(const string& filename, const string& line, int lin
     // find highest integer X such that paramName.X exists
     string s = paramName + ".1";
     int i = 1;
-    while (_params.find(s) != _params.end())
+    while (Find(s) != NULL)
     {
       char buf[10];
       i++;
@@ -163,111 +242,261 @@ void SimpleConfig::ParseLine(const string& filename, const string& line, int lin
     paramName = s;
   }
 
-  _params[paramName] = rightPart;
+  SetParam(paramName, rightPart);
 }
 
-void SimpleConfig::CopyNamespaceParams(const string& fromNamespace, const string& toNamespace)
+void SimpleConfig::SetParam(const string& name, const string& value)
 {
-  string searchString = ToUpper(fromNamespace + ".");
-  // very lazy implementation
-  map<string, string> pCopy = _params;
-  for (map<string,string>::iterator i = pCopy.begin(); i != pCopy.end(); i++)
+  // a new value never overwrites the old one, which namespaces that inherited it
+  // before now still see
+  int previous = -1;
+  auto i = _paramIndex.find(name);
+  if (i == _paramIndex.end())
   {
-		if (i->first.compare(0, searchString.length(), searchString) == 0)
-		{
-			string tmp = i->first.substr(searchString.size());
-			tmp = toNamespace + "." + tmp;
-			// only copy over parameters that don't already exist
-			if (_params.find(tmp) == _params.end())
-			{
-				_params[tmp] = i->second;
-			}
-    }
-
+    i = _paramIndex.insert(std::make_pair(name, 0)).first;
+  }
+  else
+  {
+    previous = i->second;
+  }
+  i->second = (int)_params.size();
+  _params.push_back(Param());
+  _generation++;
+
+  Param& p = _params.back();
+  p.name = name;
+  p.value = value;
+  p.previous = previous;
+  p.order = _clock++;
+
+  // parse now, so the Gets don't have to, with the rules they always had
+  p.isFloat = ParseFloat(value, p.floatValue);
+
+  p.isV3F = false;
+  std::size_t comma1 = value.find_first_of(",");
+  std::size_t comma2 = value.find_last_of(",");
+  if (comma1 != comma2 && comma1 != string::npos && comma2 != string::npos)
+  {
+    float a = 0, b = 0, c = 0;
+    p.isV3F = ParseFloat(value.substr(0, comma1), a)
+      && ParseFloat(value.substr(comma1 + 1, comma2 - comma1 - 1), b)
+      && ParseFloat(value.substr(comma2 + 1), c);
+    if (p.isV3F) p.v3fValue = V3F(a, b, c);
   }
 
-}
-
-void SimpleConfig::PrintAll()
-{
-  for(auto i=_params.begin(); i!=_params.end(); i++)
+  vector<string> spl = SLR::Split(value, ',');
+  p.floatVectorValue.resize(spl.size());
+  p.isFloatVector = true;
+  for (unsigned j = 0; j < spl.size() && p.isFloatVector; j++)
   {
-    printf("%s=%s\n",i->first.c_str(),i->second.c_str());
+    p.isFloatVector = ParseFloat(spl[j], p.floatVectorValue[j]);
   }
+  if (!p.isFloatVector) p.floatVectorValue.clear();
 }
 
-bool SimpleConfig::Exists(const string& param)
+void SimpleConfig::InheritNamespace(const string& fromNamespace, const string& toNamespace)
 {
-  return _params.find(ToUpper(param)) != _params.end();
+  // nothing is copied, lookups in toNamespace fall back on fromNamespace (see Find)
+  NamespaceBase base;
+  base.name = fromNamespace;
+  base.order = _clock++;
+  _namespaceBases[toNamespace].push_back(base);
 }
 
-bool SimpleConfig::GetFloat(const string& param, float& ret)
+void SimpleConfig::PrintAll()
 {
-  auto i = _params.find(ToUpper(param));
-  if(i==_params.end()) return false;
-  try
+  // every name that resolves, including the ones only inherited
+  std::set<string> names;
+  for (auto i = _paramIndex.begin(); i != _paramIndex.end(); i++)
   {
-      ret = std::stof(i->second);
-      return true;
+    names.insert(i->first);
   }
-  catch(...)
+  for (size_t numNames = 0; numNames != names.size(); )
   {
-      return false;
+    numNames = names.size();
+    for (auto ns = _namespaceBases.begin(); ns != _namespaceBases.end(); ns++)
+    {
+      for (unsigned int b = 0; b < ns->second.size(); b++)
+      {
+        string prefix = ToUpper(ns->second[b].name) + ".";
+        for (auto i = names.lower_bound(prefix); i != names.end() && i->compare(0, prefix.size(), prefix) == 0; i++)
+        {
+          names.insert(ToUpper(ns->first) + "." + i->substr(prefix.size()));
+        }
+      }
+    }
   }
-}
 
-bool SimpleConfig::GetString(const string& param, string& ret)
-{
-  auto i = _params.find(ToUpper(param));
-  if(i==_params.end()) return false;
-  ret = i->second;
-  return true;
+  for (auto i = names.begin(); i != names.end(); i++)
+  {
+    const Param* p = Find(*i);
+    if (p)
+    {
+      printf("%s=%s\n", i->c_str(), p->value.c_str());
+    }
+  }
 }
 
-bool SimpleConfig::GetV3F(const string& param, V3F& ret)
+const SimpleConfig::Param* SimpleConfig::Find(const string& param) const
 {
-  auto i = _params.find(ToUpper(param));
-  if(i==_params.end()) return false;
-  string s = i->second;
-  std::size_t comma1 = s.find_first_of(",");
-  std::size_t comma2 = s.find_last_of(",");
-  if(comma1==comma2 || comma1==string::npos || comma2==string::npos) return false;
-  string a = s.substr(0,comma1);
-  string b = s.substr(comma1+1,comma2-comma1-1);
-  string c = s.substr(comma2+1);
-  try
+  auto i = _paramIndex.find(param);
+  if (i != _paramIndex.end() || _namespaceBases.empty())
+  {
+    return i == _paramIndex.end() ? NULL : &_params[i->second];
+  }
+
+  // inherited, or not set at all. resolving that builds names, so remember it
+  if (_resolvedGeneration != _generation)
   {
-      ret = V3F(std::stof(a),std::stof(b),std::stof(c));
-      return true;
+    _resolved.clear();
+    _resolvedGeneration = _generation;
   }
-  catch(...)
+  auto r = _resolved.find(param);
+  if (r == _resolved.end())
   {
-      return false;
+    const Param* p = Find(param, _clock);
+    r = _resolved.insert(std::make_pair(param, p ? (int)(p - &_params[0]) : -1)).first;
   }
+  return r->second < 0 ? NULL : &_params[r->second];
 }
 
-bool SimpleConfig::GetFloatVector(const string& param, vector<float>& ret)
+// param as it was when _clock was at before
+const SimpleConfig::Param* SimpleConfig::Find(const string& param, unsigned int before) const
 {
-  auto i = _params.find(ToUpper(param));
-  if (i == _params.end()) return false;
-  string s = i->second;
-  vector<string> spl = SLR::Split(s, ',');
-  ret.clear();
-  for (unsigned i = 0; i < spl.size(); i++)
+  auto i = _paramIndex.find(param);
+  if (i != _paramIndex.end())
   {
-    try
+    int index = i->second;
+    while (index >= 0 && _params[index].order >= before)
     {
-      float tmp = std::stof(spl[i]);
-      ret.push_back(tmp);
+      index = _params[index].previous;
     }
-    catch (...)
+    if (index >= 0)
     {
-      return false;
+      return &_params[index];
+    }
+  }
+
+  if (_namespaceBases.empty())
+  {
+    return NULL;
+  }
+
+  // not set in its namespace: try what that inherits from, innermost namespace first
+  for (size_t dot = param.rfind('.'); dot != string::npos && dot > 0; dot = param.rfind('.', dot - 1))
+  {
+    auto ns = _namespaceBases.find(param.substr(0, dot));
+    if (ns == _namespaceBases.end())
+    {
+      continue;
     }
+    for (unsigned int b = 0; b < ns->second.size(); b++)
+    {
+      const NamespaceBase& base = ns->second[b];
+      if (base.order >= before)
+      {
+        // inherited later than that
+        continue;
+      }
+      const Param* p = Find(base.name + param.substr(dot), base.order);
+      if (p)
+      {
+        return p;
+      }
+    }
+  }
+  return NULL;
+}
+
+const SimpleConfig::Param* SimpleConfig::Find(const ConfigKey& param)
+{
+  if (param._generation != _generation)
+  {
+    const Param* p = Find(param._name);
+    param._index = p ? (int)(p - &_params[0]) : -1;
+    param._generation = _generation;
   }
+  return param._index < 0 ? NULL : &_params[param._index];
+}
+
+bool SimpleConfig::Exists(const string& param)
+{
+  return Find(param) != NULL;
+}
+
+bool SimpleConfig::GetFloat(const string& param, float& ret)
+{
+  return ReadFloat(Find(param), ret);
+}
+
+bool SimpleConfig::GetString(const string& param, string& ret)
+{
+  return ReadString(Find(param), ret);
+}
+
+bool SimpleConfig::GetV3F(const string& param, V3F& ret)
+{
+  return ReadV3F(Find(param), ret);
+}
+
+bool SimpleConfig::GetFloatVector(const string& param, vector<float>& ret)
+{
+  return ReadFloatVector(Find(param), ret);
+}
+
+bool SimpleConfig::Exists(const ConfigKey& param)
+{
+  return Find(param) != NULL;
+}
+
+bool SimpleConfig::GetFloat(const ConfigKey& param, float& ret)
+{
+  return ReadFloat(Find(param), ret);
+}
+
+bool SimpleConfig::GetString(const ConfigKey& param, string& ret)
+{
+  return ReadString(Find(param), ret);
+}
+
+bool SimpleConfig::GetV3F(const ConfigKey& param, V3F& ret)
+{
+  return ReadV3F(Find(param), ret);
+}
+
+bool SimpleConfig::GetFloatVector(const ConfigKey& param, vector<float>& ret)
+{
+  return ReadFloatVector(Find(param), ret);
+}
+
+bool SimpleConfig::ReadFloat(const Param* p, float& ret)
+{
+  if (!p || !p->isFloat) return false;
+  ret = p->floatValue;
+  return true;
+}
+
+bool SimpleConfig::ReadString(const Param* p, string& ret)
+{
+  if (!p) return false;
+  ret = p->value;
+  return true;
+}
+
+bool SimpleConfig::ReadV3F(const Param* p, V3F& ret)
+{
+  if (!p || !p->isV3F) return false;
+  ret = p->v3fValue;
   return true;
 }
 
+bool SimpleConfig::ReadFloatVector(const Param* p, vector<float>& ret)
+{
+  if (!p) return false;
+  ret = p->floatVectorValue;
+  return p->isFloatVector;
+}
+
 float SimpleConfig::Get(const string& param, float defaultRet)
 {
   this->GetFloat(param,defaultRet);
@@ -286,6 +515,24 @@ V3F SimpleConfig::Get(const string& param, V3F defaultRet)
   return defaultRet;
 }
 
+float SimpleConfig::Get(const ConfigKey& param, float defaultRet)
+{
+  this->GetFloat(param, defaultRet);
+  return defaultRet;
+}
+
+string SimpleConfig::Get(const ConfigKey& param, string defaultRet)
+{
+  this->GetString(param, defaultRet);
+  return defaultRet;
+}
+
+V3F SimpleConfig::Get(const ConfigKey& param, V3F defaultRet)
+{
+  this->GetV3F(param, defaultRet);
+  return defaultRet;
+}
+
 
 
 
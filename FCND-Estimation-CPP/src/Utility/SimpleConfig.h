@@ -2,10 +2,13 @@
 
 #include <map>
 #include <vector>
+#include <unordered_map>
 #include "matrix/math.hpp"
 using std::vector;
 using std::map;
 
+#include "Utility/FileStamp.h"
+
 #include "Eigen/Dense"
 using Eigen::MatrixXf;
 using Eigen::VectorXf;
@@ -16,6 +19,25 @@ namespace SLR{
 class SimpleConfig;
 typedef shared_ptr<SimpleConfig> ParamsHandle;
 
+// A parameter name that remembers where the config keeps its value, so that Gets
+// with it skip the lookup after the first one. For names that are read over and
+// over, e.g. on every reset:
+//   static const ConfigKey timestepKey("Sim.Timestep");
+//   _dtSim = config->Get(timestepKey, 0.005f);
+// Re-resolves by itself after the config is reset. Like the config, not thread-safe
+class ConfigKey
+{
+public:
+  explicit ConfigKey(const string& name) : _name(name), _index(-1), _generation(0) {}
+  const string& Name() const { return _name; }
+
+protected:
+  friend class SimpleConfig;
+  string _name;
+  mutable int _index;
+  mutable unsigned int _generation;
+};
+
 
 class SimpleConfig
 {
@@ -24,13 +46,27 @@ class SimpleConfig
 
 public:
 	static ParamsHandle GetInstance();
+
+  // loads the config rootParam and the files it includes, replacing what was loaded.
+  // if that's rootParam already and none of its files have changed on disk since,
+  // keeps what's loaded instead, so resetting a scenario doesn't re-read anything
 	void Reset(string rootParam);
+
+  // sets param to value as if the loaded files had, until they're read again
+  void Set(const string& param, const string& value);
   
+  // parameter names are not case-sensitive
   bool Exists(const string& param);
   bool GetFloat(const string& param, float& ret);
   bool GetString(const string& param, string& ret);
   bool GetV3F(const string& param, V3F& ret);
   bool GetFloatVector(const string& param, vector<float>& ret);
+
+  bool Exists(const ConfigKey& param);
+  bool GetFloat(const ConfigKey& param, float& ret);
+  bool GetString(const ConfigKey& param, string& ret);
+  bool GetV3F(const ConfigKey& param, V3F& ret);
+  bool GetFloatVector(const ConfigKey& param, vector<float>& ret);
   
   template<size_t N>
   inline bool GetFloatVector(const string& param, matrix::Vector<float, N>& ret)
@@ -45,6 +81,19 @@ public:
     return true;
   }
 
+  template<int N>
+  inline bool GetFloatVector(const string& param, Eigen::Matrix<float, N, 1>& ret)
+  {
+    vector<float> tmp;
+    if (!GetFloatVector(param, tmp)) return false;
+    if (tmp.size() != (size_t)N) return false;
+    for (int i = 0; i < N; i++)
+    {
+      ret(i) = tmp[i];
+    }
+    return true;
+  }
+
 	inline bool GetFloatVector(const string& param, VectorXf& ret)
 	{
 		vector<float> tmp;
@@ -62,13 +111,72 @@ public:
   string Get(const string& param, string defaultRet);
   V3F Get(const string& param, V3F defaultRet);
 
+  float Get(const ConfigKey& param, float defaultRet);
+  string Get(const ConfigKey& param, string defaultRet);
+  V3F Get(const ConfigKey& param, V3F defaultRet);
+
   void PrintAll();
 
 protected:
 	static shared_ptr<SimpleConfig> s_config;
-  map<string,string> _params;
+
+  // a parameter's value, and what it parses to, worked out once when it is set
+  struct Param
+  {
+    string name; // upper case
+    string value;
+    int previous; // index of the value this one replaced, -1 if none
+    unsigned int order; // when it was set, see _clock
+    bool isFloat, isV3F, isFloatVector;
+    float floatValue;
+    V3F v3fValue;
+    vector<float> floatVectorValue;
+  };
+
+  // case-insensitive hashing, so lookups don't need an upper-cased copy of the name
+  struct NoCaseHash { size_t operator()(const string& s) const; };
+  struct NoCaseEqual { bool operator()(const string& a, const string& b) const; };
+
+  // every value set, in order. a name's earlier values are kept for inheriting namespaces
+  vector<Param> _params;
+  // each name's current value
+  std::unordered_map<string, int, NoCaseHash, NoCaseEqual> _paramIndex;
+
+  // [Derived : Base] namespaces: what they inherit from, and when they did. A name in
+  // Derived that isn't set resolves to Base's value as of then
+  struct NamespaceBase
+  {
+    string name;
+    unsigned int order;
+  };
+  std::unordered_map<string, vector<NamespaceBase>, NoCaseHash, NoCaseEqual> _namespaceBases;
+
+  // counts values set and namespaces inherited, in the order they were
+  unsigned int _clock;
+
+  // names that aren't set in their own namespace, and what they resolved to (-1: nothing)
+  // as of _generation _resolvedGeneration
+  mutable std::unordered_map<string, int, NoCaseHash, NoCaseEqual> _resolved;
+  mutable unsigned int _resolvedGeneration;
+  // changes whenever a name is added or removed, invalidating ConfigKeys' cached indices
+  unsigned int _generation;
+
+  // what's loaded: the root file, and every file read for it as it was when read
+  string _rootFile;
+  vector<std::pair<string, FileStamp> > _filesRead;
+  bool FilesUnchanged() const;
+
+  const Param* Find(const string& param) const;
+  const Param* Find(const string& param, unsigned int before) const;
+  const Param* Find(const ConfigKey& param);
+  void SetParam(const string& name, const string& value);
+  static bool ReadFloat(const Param* p, float& ret);
+  static bool ReadString(const Param* p, string& ret);
+  static bool ReadV3F(const Param* p, V3F& ret);
+  static bool ReadFloatVector(const Param* p, vector<float>& ret);
+
   void ParseLine(const string& filename, const string& ln, int lineNum, string& curNamespace, int depth);
-  void CopyNamespaceParams(const string& fromNamespace, const string& toNamespace);
+  void InheritNamespace(const string& fromNamespace, const string& toNamespace);
 };
 
 
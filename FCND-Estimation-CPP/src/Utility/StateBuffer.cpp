@@ -0,0 +1,37 @@
+#include "Common.h"
+#include "StateBuffer.h"
+
+namespace SLR{
+
+bool StateBuffer::Save(const string& filename) const
+{
+	FILE* f = fopen(filename.c_str(), "wb");
+	if (!f)
+	{
+		return false;
+	}
+	bool ok = fwrite(Data(), 1, _data.size(), f) == _data.size();
+	ok = fclose(f) == 0 && ok;
+	return ok;
+}
+
+bool StateBuffer::Load(const string& filename)
+{
+	Clear();
+	FILE* f = fopen(filename.c_str(), "rb");
+	if (!f)
+	{
+		return false;
+	}
+	uint8_t buf[65536];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+	{
+		_data.insert(_data.end(), buf, buf + n);
+	}
+	bool ok = !ferror(f);
+	fclose(f);
+	return ok;
+}
+
+} // namespace SLR
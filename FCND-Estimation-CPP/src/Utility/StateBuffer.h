@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../Common.h"
+#include <vector>
+#include <string.h>
+
+namespace SLR{
+
+// Simulation state as plain bytes, for snapshots (see Simulator::SaveSnapshot).
+// Put() appends values, Get() reads them back in the same order. Only for values that
+// can be copied byte-wise. Numbers are stored in the byte order of the machine, like
+// BinaryLog's. Reading past the end fails the buffer, which stays failed until
+// Rewind(), so a reader can check once after reading everything
+class StateBuffer{
+public:
+	StateBuffer() : _readPos(0), _failed(false) {}
+
+	void Clear() { _data.clear(); Rewind(); }
+	size_t Size() const { return _data.size(); }
+	const uint8_t* Data() const { return _data.empty() ? NULL : &_data[0]; }
+
+	template <typename T> void Put(const T& v) { PutBytes(&v, sizeof(T)); }
+	template <typename T> void PutArray(const T* v, int n) { PutBytes(v, sizeof(T) * n); }
+	void PutString(const string& s)
+	{
+		Put((uint32_t)s.size());
+		PutBytes(s.data(), s.size());
+	}
+
+	template <typename T> bool Get(T& v) { return GetBytes(&v, sizeof(T)); }
+	template <typename T> bool GetArray(T* v, int n) { return GetBytes(v, sizeof(T) * n); }
+	bool GetString(string& s)
+	{
+		uint32_t n = 0;
+		if (!Get(n) || n > _data.size() - _readPos)
+		{
+			_failed = true;
+			return false;
+		}
+		s.assign((const char*)&_data[_readPos], n);
+		_readPos += n;
+		return true;
+	}
+
+	// reads on n bytes later, as Get would after reading them
+	bool Skip(size_t n)
+	{
+		if (_failed || n > _data.size() - _readPos)
+		{
+			_failed = true;
+			return false;
+		}
+		_readPos += n;
+		return true;
+	}
+
+	// reads from the beginning again
+	void Rewind() { _readPos = 0; _failed = false; }
+	size_t ReadPos() const { return _readPos; }
+	bool Failed() const { return _failed; }
+
+	// the whole buffer to and from a file. false if it can't be written or read
+	bool Save(const string& filename) const;
+	bool Load(const string& filename);
+
+protected:
+	void PutBytes(const void* p, size_t n)
+	{
+		if (n == 0) return;
+		_data.insert(_data.end(), (const uint8_t*)p, (const uint8_t*)p + n);
+	}
+
+	bool GetBytes(void* p, size_t n)
+	{
+		if (_failed || n > _data.size() - _readPos)
+		{
+			_failed = true;
+			return false;
+		}
+		if (n == 0) return true;
+		memcpy(p, &_data[_readPos], n);
+		_readPos += n;
+		return true;
+	}
+
+	std::vector<uint8_t> _data;
+	size_t _readPos;
+	bool _failed;
+};
+
+} // namespace SLR
@@ -0,0 +1,125 @@
+#include "Common.h"
+#include "TelemetryBus.h"
+#include <chrono>
+
+namespace SLR{
+
+TelemetryBus::TelemetryBus(int capacity)
+{
+	size_t n = 1;
+	while (n < (size_t)MAX(capacity, 1))
+	{
+		n *= 2;
+	}
+	std::vector<Slot>(n).swap(_slots);
+	_mask = n - 1;
+
+	for (size_t i = 0; i < n; i++)
+	{
+		_slots[i].seq.store(0, std::memory_order_relaxed);
+	}
+	_head.store(0, std::memory_order_release);
+}
+
+void TelemetryBus::Publish(const TelemetryFrame& frame)
+{
+	uint64_t n = _head.load(std::memory_order_relaxed);
+	Slot& slot = _slots[n & _mask];
+
+	slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.frame = frame;
+	slot.seq.store(2 * n + 2, std::memory_order_release);
+
+	_head.store(n + 1, std::memory_order_release);
+}
+
+TelemetryBus::Reader::Reader(const TelemetryBus& bus)
+	: _bus(bus)
+{
+	_next = bus.NumPublished();
+	_numDropped = 0;
+}
+
+bool TelemetryBus::Reader::Next(TelemetryFrame& frame)
+{
+	const uint64_t capacity = _bus._slots.size();
+	for (;;)
+	{
+		uint64_t head = _bus._head.load(std::memory_order_acquire);
+		if (_next >= head)
+		{
+			return false;
+		}
+
+		// lapped: the frames before head - capacity are gone
+		if (head - _next > capacity)
+		{
+			_numDropped += head - capacity - _next;
+			_next = head - capacity;
+		}
+
+		const Slot& slot = _bus._slots[_next & _bus._mask];
+		uint64_t seq = slot.seq.load(std::memory_order_acquire);
+		if (seq != 2 * _next + 2)
+		{
+			// already being overwritten. the producer is about to move head past us
+			continue;
+		}
+
+		frame = slot.frame;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) != seq)
+		{
+			// overwritten while we copied it
+			continue;
+		}
+
+		_next++;
+		return true;
+	}
+}
+
+TelemetryConsumer::TelemetryConsumer(shared_ptr<TelemetryBus> bus)
+	: _bus(bus), _reader(*bus)
+{
+	_quit = false;
+}
+
+TelemetryConsumer::~TelemetryConsumer()
+{
+	Stop();
+}
+
+void TelemetryConsumer::Start()
+{
+	_thread = std::thread(&TelemetryConsumer::ConsumerThread, this);
+}
+
+void TelemetryConsumer::Stop()
+{
+	_quit = true;
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+}
+
+void TelemetryConsumer::ConsumerThread()
+{
+	TelemetryFrame frame;
+	for (;;)
+	{
+		// check before draining, so that everything published before Stop() gets consumed
+		bool quit = _quit;
+		while (_reader.Next(frame))
+		{
+			OnFrame(frame);
+		}
+		OnIdle();
+		if (quit) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+}
+
+} // namespace SLR
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../Common.h"
+#include <vector>
+#include <atomic>
+#include <thread>
+
+namespace SLR{
+
+// Fixed-layout snapshot of one vehicle. Plain numbers only, so frames can be
+// copied between threads byte-wise and written out as they are
+struct TelemetryFrame
+{
+	double time;
+	int vehicle;
+
+	// true state. attitude as quaternion w,x,y,z
+	float pos[3], vel[3], att[4], omega[3];
+
+	// estimate, and the diagonal of the estimator's covariance
+	// (x,y,z,vx,vy,vz,yaw; zero if the estimator doesn't have one)
+	float estPos[3], estVel[3], estAtt[4];
+	float estVar[7];
+
+	// motor thrust commands [N], A..D
+	float thrust[4];
+};
+
+// Single-producer/multi-consumer ring of TelemetryFrames.
+// The simulation thread publishes without ever blocking or waiting for consumers:
+// when the ring is full the oldest frames are overwritten. Every consumer reads
+// at its own pace through its own Reader, and a consumer that falls more than a
+// ring behind skips the frames it lost (and counts them).
+// Each slot carries a sequence number, odd while it is being written, so a reader
+// detects a frame that was overwritten while it was copying it and reads again.
+class TelemetryBus{
+public:
+	// capacity is rounded up to a power of two
+	TelemetryBus(int capacity = 4096);
+
+	// producer only
+	void Publish(const TelemetryFrame& frame);
+
+	uint64_t NumPublished() const { return _head.load(std::memory_order_acquire); }
+	int Capacity() const { return (int)_slots.size(); }
+
+	// a consumer's position in the bus. one per consumer thread
+	class Reader{
+	public:
+		// starts with the next frame published
+		Reader(const TelemetryBus& bus);
+
+		// copies the next frame out, false if there is none yet
+		bool Next(TelemetryFrame& frame);
+
+		// frames this reader missed because the producer overwrote them first
+		uint64_t NumDropped() const { return _numDropped; }
+
+	protected:
+		const TelemetryBus& _bus;
+		uint64_t _next, _numDropped;
+	};
+
+protected:
+	// copy constructor and assignment are disallowed
+	TelemetryBus(const TelemetryBus&);
+	TelemetryBus& operator=(const TelemetryBus&);
+
+	struct Slot{
+		// 2n+1 while frame n is being written, 2n+2 once it's complete
+		std::atomic<uint64_t> seq;
+		TelemetryFrame frame;
+	};
+
+	std::vector<Slot> _slots;
+	uint64_t _mask;
+	std::atomic<uint64_t> _head; // frames published so far
+};
+
+// A consumer running on its own thread: OnFrame() is called for every frame
+// published on the bus, OnIdle() whenever it has caught up, after which it
+// sleeps for a few milliseconds. Derived classes call Start() at the end of
+// their constructor and Stop() in their destructor.
+class TelemetryConsumer{
+public:
+	TelemetryConsumer(shared_ptr<TelemetryBus> bus);
+	virtual ~TelemetryConsumer();
+
+	// stops the thread once it has consumed everything published so far
+	void Stop();
+
+protected:
+	void Start();
+
+	virtual void OnFrame(const TelemetryFrame& frame) = 0;
+	virtual void OnIdle() {}
+
+	void ConsumerThread();
+
+	shared_ptr<TelemetryBus> _bus;
+	TelemetryBus::Reader _reader;
+	std::thread _thread;
+	std::atomic<bool> _quit;
+};
+
+} // namespace SLR
@@ -0,0 +1,59 @@
+#include "Common.h"
+#include "TelemetryLogger.h"
+
+namespace SLR{
+
+TelemetryLogger::TelemetryLogger(shared_ptr<TelemetryBus> bus, const string& filename)
+	: TelemetryConsumer(bus)
+{
+	_numDroppedReported = 0;
+	_file = fopen(filename.c_str(), "w");
+	if (!_file)
+	{
+		SLR_WARNING1("Could not open telemetry log %s", filename.c_str());
+		return;
+	}
+
+	fprintf(_file, "time,vehicle,"
+		"pos.x,pos.y,pos.z,vel.x,vel.y,vel.z,att.w,att.x,att.y,att.z,omega.x,omega.y,omega.z,"
+		"est.x,est.y,est.z,est.vx,est.vy,est.vz,est.att.w,est.att.x,est.att.y,est.att.z,"
+		"var.x,var.y,var.z,var.vx,var.vy,var.vz,var.yaw,"
+		"thrust.A,thrust.B,thrust.C,thrust.D\n");
+	Start();
+}
+
+TelemetryLogger::~TelemetryLogger()
+{
+	Stop();
+	if (_file)
+	{
+		fclose(_file);
+	}
+}
+
+void TelemetryLogger::OnFrame(const TelemetryFrame& f)
+{
+	fprintf(_file, "%lf,%d", f.time, f.vehicle);
+	const float* groups[] = { f.pos, f.vel, f.att, f.omega, f.estPos, f.estVel, f.estAtt, f.estVar, f.thrust };
+	const int sizes[] = { 3, 3, 4, 3, 3, 3, 4, 7, 4 };
+	for (int g = 0; g < 9; g++)
+	{
+		for (int i = 0; i < sizes[g]; i++)
+		{
+			fprintf(_file, ",%f", groups[g][i]);
+		}
+	}
+	fprintf(_file, "\n");
+}
+
+void TelemetryLogger::OnIdle()
+{
+	fflush(_file);
+	if (_reader.NumDropped() > _numDroppedReported)
+	{
+		SLR_WARNING1("Telemetry log fell behind, %d frames lost", (int)(_reader.NumDropped() - _numDroppedReported));
+		_numDroppedReported = _reader.NumDropped();
+	}
+}
+
+} // namespace SLR
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "TelemetryBus.h"
+
+namespace SLR{
+
+// Writes every frame published on a TelemetryBus to a CSV file, one line per
+// vehicle and frame, from its own thread
+class TelemetryLogger : public TelemetryConsumer{
+public:
+	TelemetryLogger(shared_ptr<TelemetryBus> bus, const string& filename);
+	~TelemetryLogger();
+
+	bool IsOpen() const { return _file != NULL; }
+
+protected:
+	virtual void OnFrame(const TelemetryFrame& frame);
+	virtual void OnIdle();
+
+	FILE* _file;
+	uint64_t _numDroppedReported;
+};
+
+} // namespace SLR
@@ -0,0 +1,100 @@
+#include "Common.h"
+#include "WorkerPool.h"
+
+namespace SLR{
+
+WorkerPool::WorkerPool(int numThreads)
+{
+	if (numThreads <= 0)
+	{
+		numThreads = (int)std::thread::hardware_concurrency();
+	}
+	_numThreads = MAX(numThreads, 1);
+
+	_fn = NULL;
+	_numTasks = 0;
+	_generation = 0;
+	_numBusy = 0;
+	_quit = false;
+
+	for (int i = 1; i < _numThreads; i++)
+	{
+		_threads.push_back(std::thread(&WorkerPool::WorkerThread, this, i));
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_workReady.notify_all();
+	for (unsigned int i = 0; i < _threads.size(); i++)
+	{
+		_threads[i].join();
+	}
+}
+
+void WorkerPool::Run(int numTasks, const std::function<void(int)>& fn)
+{
+	if (_numThreads == 1 || numTasks <= 1)
+	{
+		for (int i = 0; i < numTasks; i++)
+		{
+			fn(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_fn = &fn;
+		_numTasks = numTasks;
+		_numBusy = _numThreads - 1;
+		_generation++;
+	}
+	_workReady.notify_all();
+
+	RunShare(0);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_workDone.wait(lock, [this] { return _numBusy == 0; });
+	_fn = NULL;
+}
+
+void WorkerPool::RunShare(int threadIndex)
+{
+	for (int i = threadIndex; i < _numTasks; i += _numThreads)
+	{
+		(*_fn)(i);
+	}
+}
+
+void WorkerPool::WorkerThread(int threadIndex)
+{
+	int lastGeneration = 0;
+	while (1)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_workReady.wait(lock, [&] { return _quit || _generation != lastGeneration; });
+			if (_quit) return;
+			lastGeneration = _generation;
+		}
+
+		RunShare(threadIndex);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			last = (--_numBusy == 0);
+		}
+		if (last)
+		{
+			_workDone.notify_one();
+		}
+	}
+}
+
+} // namespace SLR
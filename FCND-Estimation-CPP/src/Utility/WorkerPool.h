@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../Common.h"
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace SLR{
+
+// Small fixed pool of persistent worker threads for fork/join style work.
+// Run() hands out task indices statically (task i goes to thread i % numThreads,
+// with the calling thread acting as thread 0) and blocks until all are done,
+// so a given task always runs on the same thread and no per-call threads are created.
+class WorkerPool{
+public:
+	// numThreads counts the calling thread; 0 means one per hardware thread
+	WorkerPool(int numThreads = 0);
+	~WorkerPool();
+
+	int NumThreads() const { return _numThreads; }
+
+	// calls fn(0)..fn(numTasks-1) spread over the pool and waits for them to finish
+	void Run(int numTasks, const std::function<void(int)>& fn);
+
+protected:
+	// copy constructor and assignment are disallowed
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+
+	void WorkerThread(int threadIndex);
+	void RunShare(int threadIndex);
+
+	int _numThreads;
+	std::vector<std::thread> _threads;
+
+	std::mutex _mutex;
+	std::condition_variable _workReady, _workDone;
+	const std::function<void(int)>* _fn;
+	int _numTasks;
+	int _generation;   // bumped for every Run() so workers can tell new work from spurious wakeups
+	int _numBusy;
+	bool _quit;
+};
+
+} // namespace SLR
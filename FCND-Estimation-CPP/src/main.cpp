@@ -8,7 +8,6 @@
 #include "Utility/SimpleConfig.h"
 #include "Utility/StringUtils.h"
 #include "Drawing/GraphManager.h"
-#include "MavlinkNode/MavlinkTranslation.h"
 #include "Simulation/SimulatedGPS.h"
 
 using SLR::Quaternion;
@@ -26,23 +25,26 @@ vector<QuadcopterHandle> quads;
 
 shared_ptr<Visualizer_GLUT> visualizer;
 shared_ptr<GraphManager> grapher;
+shared_ptr<Simulator> simulator;
 
-float dtSim = 0.001f;
 const int NUM_SIM_STEPS_PER_TIMER = 5;
 Timer lastDraw;
 V3F force, moment;
 
-float simulationTime=0;
-int randomNumCarry=-1;
-
 void OnTimer(int v);
 
-vector<QuadcopterHandle> CreateVehicles();
 string _scenarioFile="../config/01_Intro.txt";
 
 #include "MavlinkNode/MavlinkNode.h"
+#include "MavlinkNode/MavlinkTelemetry.h"
+#include "Utility/TelemetryLogger.h"
 shared_ptr<MavlinkNode> mlNode;
 
+// the simulator publishes every vehicle's state here, MAVLink and the log consume it on their own threads
+shared_ptr<SLR::TelemetryBus> telemetry;
+shared_ptr<MavlinkTelemetry> mlTelemetry;
+shared_ptr<SLR::TelemetryLogger> telemetryLogger;
+
 int main(int argcp, char **argv)
 {
   PrintHelpText();
@@ -53,6 +55,9 @@ int main(int argcp, char **argv)
   // initialize visualizer
   visualizer.reset(new Visualizer_GLUT(&argcp, argv));
   grapher.reset(new GraphManager(false));
+  simulator.reset(new Simulator());
+  telemetry.reset(new SLR::TelemetryBus());
+  simulator->_telemetry = telemetry;
 
   // re-load last opened scenario
   FILE *f = fopen("../config/LastScenario.txt", "r");
@@ -84,13 +89,16 @@ void LoadScenario(string scenarioFile)
 
   ParamsHandle config = SimpleConfig::GetInstance();
   _scenarioFile = scenarioFile;
-  config->Reset(scenarioFile);
 
   grapher->graph1->RemoveAllElements();
   grapher->graph2->RemoveAllElements();
 
-  // create a quadcopter to simulate
-  quads = CreateVehicles();
+  // create the quadcopters to simulate
+  simulator->LoadScenario(scenarioFile);
+  quads = simulator->_vehicles;
+
+  string sensorRecordFile = config->Get("Sim.SensorRecordFile", "");
+  simulator->_sensorRecordFile = sensorRecordFile != "" ? "../config/" + sensorRecordFile : "";
 
   ResetSimulation();
 
@@ -101,35 +109,29 @@ void LoadScenario(string scenarioFile)
 
   ProcessConfigCommands(visualizer);
 
+  mlTelemetry.reset();
   mlNode.reset();
   if(config->Get("Mavlink.Enable",0)!=0)
   { 
     mlNode.reset(new MavlinkNode());
+    mlTelemetry.reset(new MavlinkTelemetry(telemetry, mlNode));
+  }
+
+  telemetryLogger.reset();
+  string telemetryFile = config->Get("Sim.TelemetryLogFile", "");
+  if (telemetryFile != "")
+  {
+    telemetryLogger.reset(new SLR::TelemetryLogger(telemetry, "../config/" + telemetryFile));
   }
 
   
 }
 
-int _simCount = 0;
-
 void ResetSimulation()
 {
-  _simCount++;
-  ParamsHandle config = SimpleConfig::GetInstance();
-
-  printf("Simulation #%d (%s)\n", _simCount, _scenarioFile.c_str());
-
-  randomNumCarry = -1;
-
   receivedResetRequest = false;
-  simulationTime = 0;
-  config->Reset(_scenarioFile);
-  dtSim = config->Get("Sim.Timestep", 0.005f);
+  simulator->Reset();
 
-  for (unsigned i = 0; i < quads.size(); i++)
-  {
-    quads[i]->Reset();
-  }
   grapher->Clear();
 
   // reset data sources
@@ -142,16 +144,25 @@ void ResetSimulation()
     grapher->RegisterDataSource((*i)->estimator);
 		grapher->RegisterDataSource((*i)->controller);
   }
+
+  // restarted with every run, like the graph logs
+  ParamsHandle config = SimpleConfig::GetInstance();
+  string dataLogFile = config->Get("Sim.DataLogFile", "");
+  if (dataLogFile != "")
+  {
+    grapher->BeginDataLog("../config/" + dataLogFile, config->Get("Sim.DataLogDecimation", 1));
+  }
+  else
+  {
+    grapher->EndDataLog();
+  }
 }
 
 void OnTimer(int)
 {
-  ParamsHandle config = SimpleConfig::GetInstance();
-  
   // logic to reset the simulation based on key input or reset conditions
-  float endTime = config->Get("Sim.EndTime",-1.f);
   if(receivedResetRequest ==true ||
-     (ToUpper(config->Get("Sim.RunMode", "Continuous"))=="REPEAT" && endTime>0 && simulationTime >= endTime))
+     (simulator->_repeat && simulator->EndTimeReached()))
   {
     ResetSimulation();
   }
@@ -161,15 +172,8 @@ void OnTimer(int)
   // main loop
   if (!paused)
   {
-    for (int i = 0; i < NUM_SIM_STEPS_PER_TIMER; i++)
-    {
-      for (unsigned i = 0; i < quads.size(); i++)
-      {
-        quads[i]->Run(dtSim, simulationTime, randomNumCarry, force, moment);
-      }
-      simulationTime += dtSim;
-    }
-    grapher->UpdateData(simulationTime);
+    simulator->RunSteps(NUM_SIM_STEPS_PER_TIMER, force, moment);
+    grapher->UpdateData(simulator->_simTime);
   }
   
   KeyboardInteraction(force, visualizer);
@@ -180,49 +184,14 @@ void OnTimer(int)
     {
       visualizer->SetArrow(quads[0]->Position() - force, quads[0]->Position());
     }
-    visualizer->Update(simulationTime);
+    visualizer->Update(simulator->_simTime);
     grapher->DrawUpdate();
     lastDraw.Reset();
-
-    // temporarily here
-    if (mlNode)
-    {
-      mlNode->Send(MakeMavlinkPacket_Heartbeat());
-      mlNode->Send(MakeMavlinkPacket_Status());
-      mlNode->Send(MakeMavlinkPacket_LocalPose(simulationTime, quads[0]->Position(), quads[0]->Velocity()));
-      mlNode->Send(MakeMavlinkPacket_Attitude(simulationTime, quads[0]->Attitude(), quads[0]->Omega()));
-    }
-    
   }
   
   glutTimerFunc(5,&OnTimer,0);
 }
 
-vector<QuadcopterHandle> CreateVehicles()
-{
-  vector<QuadcopterHandle> ret;
-
-  ParamsHandle config = SimpleConfig::GetInstance();
-  int i = 1;
-  while (1)
-  {
-    char buf[100];
-    sprintf_s(buf, 100, "Sim.Vehicle%d", i);
-    if (config->Exists(buf))
-    {
-      QuadcopterHandle q = QuadDynamics::Create(config->Get(buf, "Quad"), (int)ret.size());
-      ret.push_back(q);
-    }
-    else
-    {		
-      break;
-    }
-    i++;
-  }
-  return ret;
-
-}
-
 void KeyboardInteraction(V3F& force, shared_ptr<Visualizer_GLUT> visualizer)
 {
   bool keyPressed = false;